@@ -3,10 +3,29 @@
 
 layout(binding = 1) uniform sampler2D tex_sampler;
 
+// mip streaming feedback, see wn_texture_stream_update
+layout(std430, binding = 2) buffer _feedback {
+    uvec2 extent; // of mip 0 of the whole chain, the view may start further down
+    uint min_mip; // finest mip any sampled pixel asked for, reset by the cpu after reading
+} feedback;
+
 layout(location = 0) in vec2 in_tex_coord0;
 
 layout(location = 0) out vec4 out_color;
 
 void main() {
     out_color = texture(tex_sampler, in_tex_coord0);
+
+    // derivatives in uniform control flow, only every 8x8th pixel writes though
+    vec2 texels = in_tex_coord0 * vec2(feedback.extent);
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float major = max(dot(dx, dx), dot(dy, dy));
+    float minor = min(dot(dx, dx), dot(dy, dy));
+    // anisotropic filtering samples along the minor axis, up to 16x finer than the major one
+    float lod = 0.5 * max(log2(minor), log2(major) - 8.0);
+
+    if (((uint(gl_FragCoord.x) | uint(gl_FragCoord.y)) & 7u) == 0u) {
+        atomicMin(feedback.min_mip, uint(max(lod, 0.0)));
+    }
 }
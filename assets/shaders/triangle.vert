@@ -7,12 +7,21 @@ layout(binding = 0) uniform _mvp {
     mat4 proj;
 } mvp;
 
+// per submesh draw
+layout(push_constant) uniform _draw {
+    mat4 transform; // submesh to model space
+    // positions may be stored as unorm16 over the mesh bounds, identity for fp32 vertices
+    vec4 pos_scale;
+    vec4 pos_bias;
+} draw;
+
 layout(location = 0) in vec3 in_pos;
 layout(location = 1) in vec2 in_tex_coord0;
 
 layout(location = 0) out vec2 out_tex_coord0;
 
 void main() {
-    gl_Position = mvp.proj * mvp.view * mvp.model * vec4(in_pos, 1.0);
+    vec3 pos = in_pos * draw.pos_scale.xyz + draw.pos_bias.xyz;
+    gl_Position = mvp.proj * mvp.view * mvp.model * draw.transform * vec4(pos, 1.0);
     out_tex_coord0 = in_tex_coord0;
 }
@@ -0,0 +1,247 @@
+/*
+===========================================================================
+
+whynot::asset::bc_encode.c: BC1/BC3 block compression for baked textures
+
+===========================================================================
+*/
+
+#include "bc_encode.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint16_t wn_rgb565(const float c[3])
+{
+    uint32_t r = (uint32_t)(fminf(fmaxf(c[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    uint32_t g = (uint32_t)(fminf(fmaxf(c[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    uint32_t b = (uint32_t)(fminf(fmaxf(c[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static inline void wn_rgb565_expand(uint16_t c, int32_t out[3])
+{
+    uint32_t r = (c >> 11) & 31;
+    uint32_t g = (c >> 5) & 63;
+    uint32_t b = c & 31;
+    out[0] = (int32_t)((r << 3) | (r >> 2));
+    out[1] = (int32_t)((g << 2) | (g >> 4));
+    out[2] = (int32_t)((b << 3) | (b >> 2));
+}
+
+void wn_bc1_encode_block(const uint8_t rgba[64], uint8_t out[8])
+{
+    float mean[3] = { 0 };
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            mean[c] += rgba[i * 4 + c];
+        }
+    }
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        mean[c] /= 16.0f;
+    }
+
+    // covariance, then a few power iterations for the principal axis
+    float cov[6] = { 0 };
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        float d[3] = {
+            rgba[i * 4 + 0] - mean[0],
+            rgba[i * 4 + 1] - mean[1],
+            rgba[i * 4 + 2] - mean[2],
+        };
+        cov[0] += d[0] * d[0];
+        cov[1] += d[0] * d[1];
+        cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1];
+        cov[4] += d[1] * d[2];
+        cov[5] += d[2] * d[2];
+    }
+
+    float axis[3] = { 0.9f, 1.0f, 0.7f };
+    for (uint32_t iter = 0; iter < 8; iter++)
+    {
+        float next[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+        };
+        float len = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (len < 1e-6f)
+        {
+            break;
+        }
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            axis[c] = next[c] / len;
+        }
+    }
+
+    float min_t = 0.0f;
+    float max_t = 0.0f;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        float t = (rgba[i * 4 + 0] - mean[0]) * axis[0] + (rgba[i * 4 + 1] - mean[1]) * axis[1]
+                + (rgba[i * 4 + 2] - mean[2]) * axis[2];
+        min_t = t < min_t ? t : min_t;
+        max_t = t > max_t ? t : max_t;
+    }
+
+    // pull the endpoints in a bit, the extremes are usually outliers after quantization
+    float inset = (max_t - min_t) / 32.0f;
+    min_t += inset;
+    max_t -= inset;
+
+    float hi[3], lo[3];
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        hi[c] = mean[c] + axis[c] * max_t;
+        lo[c] = mean[c] + axis[c] * min_t;
+    }
+
+    uint16_t c0 = wn_rgb565(hi);
+    uint16_t c1 = wn_rgb565(lo);
+    if (c0 < c1)
+    {
+        uint16_t tmp = c0;
+        c0 = c1;
+        c1 = tmp;
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1)
+    {
+        // c0 > c1 selects the 4 color mode, palette order is c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 +
+        // 2/3 c1
+        int32_t palette[4][3];
+        wn_rgb565_expand(c0, palette[0]);
+        wn_rgb565_expand(c1, palette[1]);
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+        }
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint32_t best = 0;
+            int32_t best_dist = INT32_MAX;
+            for (uint32_t p = 0; p < 4; p++)
+            {
+                int32_t dr = rgba[i * 4 + 0] - palette[p][0];
+                int32_t dg = rgba[i * 4 + 1] - palette[p][1];
+                int32_t db = rgba[i * 4 + 2] - palette[p][2];
+                int32_t dist = dr * dr + dg * dg + db * db;
+                if (dist < best_dist)
+                {
+                    best_dist = dist;
+                    best = p;
+                }
+            }
+            indices |= best << (2 * i);
+        }
+    }
+
+    out[0] = (uint8_t)(c0 & 0xff);
+    out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)(c1 & 0xff);
+    out[3] = (uint8_t)(c1 >> 8);
+    memcpy(&out[4], &indices, sizeof(indices)); // NOTE: little endian
+}
+
+void wn_bc3_encode_block(const uint8_t rgba[64], uint8_t out[16])
+{
+    uint8_t a0 = 0;
+    uint8_t a1 = 255;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        uint8_t a = rgba[i * 4 + 3];
+        a0 = a > a0 ? a : a0;
+        a1 = a < a1 ? a : a1;
+    }
+
+    // a0 > a1 selects 8 interpolated alphas: a0, a1, then (7 - k) / 7 a0 + k / 7 a1 for k = 1..6
+    uint64_t indices = 0;
+    if (a0 > a1)
+    {
+        int32_t palette[8] = { a0, a1 };
+        for (int32_t k = 1; k < 7; k++)
+        {
+            palette[k + 1] = ((7 - k) * a0 + k * a1 + 3) / 7;
+        }
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint64_t best = 0;
+            int32_t best_dist = INT32_MAX;
+            for (uint32_t p = 0; p < 8; p++)
+            {
+                int32_t dist = abs(rgba[i * 4 + 3] - palette[p]);
+                if (dist < best_dist)
+                {
+                    best_dist = dist;
+                    best = p;
+                }
+            }
+            indices |= best << (3 * i);
+        }
+    }
+    else
+    {
+        // flat alpha, index 0 everywhere. a0 == a1 would pick the 6 alpha mode which still has
+        // a0 at index 0
+        a1 = a0;
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        out[2 + i] = (uint8_t)(indices >> (8 * i));
+    }
+
+    wn_bc1_encode_block(rgba, &out[8]);
+}
+
+void wn_bc_encode_image(
+    const uint8_t* rgba,
+    uint32_t width,
+    uint32_t height,
+    bool alpha,
+    uint8_t* out)
+{
+    uint32_t block_size = alpha ? 16 : 8;
+    uint32_t blocks_x = (width + 3) / 4;
+    uint32_t blocks_y = (height + 3) / 4;
+
+    uint8_t block[64];
+    for (uint32_t by = 0; by < blocks_y; by++)
+    {
+        for (uint32_t bx = 0; bx < blocks_x; bx++)
+        {
+            for (uint32_t y = 0; y < 4; y++)
+            {
+                uint32_t src_y = by * 4 + y < height ? by * 4 + y : height - 1;
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    uint32_t src_x = bx * 4 + x < width ? bx * 4 + x : width - 1;
+                    memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)src_y * width + src_x) * 4], 4);
+                }
+            }
+
+            uint8_t* dst = &out[((size_t)by * blocks_x + bx) * block_size];
+            if (alpha)
+            {
+                wn_bc3_encode_block(block, dst);
+            }
+            else
+            {
+                wn_bc1_encode_block(block, dst);
+            }
+        }
+    }
+}
@@ -0,0 +1,31 @@
+/*
+===========================================================================
+
+whynot::asset::bc_encode.h: BC1/BC3 block compression for baked textures
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+
+/*
+ * Principal axis endpoint fit, good enough for albedo-ish content and fast enough to bake every
+ * texture at startup size. Endpoints are fitted to the stored values as is, srgb data stays srgb.
+ */
+
+// 4x4 rgba8 block (row major, 64 bytes) -> 8 byte BC1 block, always in 4 color mode
+void wn_bc1_encode_block(const uint8_t rgba[64], uint8_t out[8]);
+
+// 4x4 rgba8 block -> 16 byte BC3 block (BC4 style alpha + BC1 color)
+void wn_bc3_encode_block(const uint8_t rgba[64], uint8_t out[16]);
+
+// encodes a whole rgba8 image, edge blocks of extents that aren't a multiple of 4 repeat the last
+// row/column. out holds wn_texture_level_size(width, height, block_size) bytes
+void wn_bc_encode_image(
+    const uint8_t* rgba,
+    uint32_t width,
+    uint32_t height,
+    bool alpha,
+    uint8_t* out);
@@ -0,0 +1,102 @@
+/*
+===========================================================================
+
+whynot::asset::image.c: cpu side rgba8 image helpers (mip chains)
+
+===========================================================================
+*/
+
+#include "image.h"
+
+#include <math.h>
+
+uint32_t wn_image_mip_count(uint32_t width, uint32_t height)
+{
+    uint32_t extent = width > height ? width : height;
+    uint32_t n_mips = 1;
+    while (extent > 1)
+    {
+        extent >>= 1;
+        n_mips++;
+    }
+    return n_mips;
+}
+
+size_t wn_image_mip_chain_size(uint32_t width, uint32_t height, uint32_t n_mips)
+{
+    size_t size = 0;
+    for (uint32_t mip = 0; mip < n_mips; mip++)
+    {
+        size += (size_t)wn_image_mip_extent(width, mip) * wn_image_mip_extent(height, mip) * 4;
+    }
+    return size;
+}
+
+static inline uint8_t wn_linear_to_srgb8(float linear)
+{
+    float srgb
+        = linear <= 0.0031308f ? linear * 12.92f : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+    return (uint8_t)(srgb * 255.0f + 0.5f);
+}
+
+// 2x2 box, the last row/column of odd extents gets dropped
+static void wn_image_downsample_srgb(
+    const float* to_linear,
+    const uint8_t* src,
+    uint32_t src_width,
+    uint32_t src_height,
+    uint8_t* dst)
+{
+    uint32_t width = src_width > 1 ? src_width / 2 : 1;
+    uint32_t height = src_height > 1 ? src_height / 2 : 1;
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        uint32_t y0 = 2 * y < src_height ? 2 * y : src_height - 1;
+        uint32_t y1 = 2 * y + 1 < src_height ? 2 * y + 1 : src_height - 1;
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint32_t x0 = 2 * x < src_width ? 2 * x : src_width - 1;
+            uint32_t x1 = 2 * x + 1 < src_width ? 2 * x + 1 : src_width - 1;
+
+            const uint8_t* taps[4] = {
+                &src[((size_t)y0 * src_width + x0) * 4],
+                &src[((size_t)y0 * src_width + x1) * 4],
+                &src[((size_t)y1 * src_width + x0) * 4],
+                &src[((size_t)y1 * src_width + x1) * 4],
+            };
+
+            uint8_t* out = &dst[((size_t)y * width + x) * 4];
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                float sum = to_linear[taps[0][c]] + to_linear[taps[1][c]]
+                          + to_linear[taps[2][c]] + to_linear[taps[3][c]];
+                out[c] = wn_linear_to_srgb8(0.25f * sum);
+            }
+            uint32_t alpha = taps[0][3] + taps[1][3] + taps[2][3] + taps[3][3];
+            out[3] = (uint8_t)((alpha + 2) / 4);
+        }
+    }
+}
+
+void wn_image_build_mips_srgb(uint8_t* chain, uint32_t width, uint32_t height, uint32_t n_mips)
+{
+    float to_linear[256];
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        float srgb = (float)i / 255.0f;
+        to_linear[i] = srgb <= 0.04045f ? srgb / 12.92f : powf((srgb + 0.055f) / 1.055f, 2.4f);
+    }
+
+    uint8_t* level = chain;
+    for (uint32_t mip = 1; mip < n_mips; mip++)
+    {
+        uint32_t src_width = wn_image_mip_extent(width, mip - 1);
+        uint32_t src_height = wn_image_mip_extent(height, mip - 1);
+        uint8_t* next = level + (size_t)src_width * src_height * 4;
+
+        wn_image_downsample_srgb(to_linear, level, src_width, src_height, next);
+        level = next;
+    }
+}
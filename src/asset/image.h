@@ -0,0 +1,28 @@
+/*
+===========================================================================
+
+whynot::asset::image.h: cpu side rgba8 image helpers (mip chains)
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+
+// full chain down to 1x1
+uint32_t wn_image_mip_count(uint32_t width, uint32_t height);
+
+static inline uint32_t wn_image_mip_extent(uint32_t extent, uint32_t mip)
+{
+    uint32_t mip_extent = extent >> mip;
+    return mip_extent > 0 ? mip_extent : 1;
+}
+
+// bytes of n_mips rgba8 levels stored back to back, largest first
+size_t wn_image_mip_chain_size(uint32_t width, uint32_t height, uint32_t n_mips);
+
+// chain holds level 0 followed by room for the other n_mips - 1 levels (see
+// wn_image_mip_chain_size), which get box filtered from the one above. Color is treated as srgb
+// and filtered in linear space, alpha as linear
+void wn_image_build_mips_srgb(uint8_t* chain, uint32_t width, uint32_t height, uint32_t n_mips);
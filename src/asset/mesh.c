@@ -0,0 +1,164 @@
+/*
+===========================================================================
+
+whynot::asset::mesh.c: cpu side mesh data
+
+===========================================================================
+*/
+
+#include "mesh.h"
+
+#include "mesh_arena.h"
+
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+typedef struct wn_vertex_map_t
+{
+    wn_vertex_t key;
+    uint32_t value;
+} wn_vertex_map_t;
+
+wn_mesh_t wn_mesh_new(size_t n_vertices, size_t n_indices)
+{
+    wn_vertex_t* vertices = malloc(sizeof(wn_vertex_t) * n_vertices);
+    assert(vertices);
+    uint32_t* indices = malloc(sizeof(uint32_t) * n_indices);
+    assert(indices);
+    wn_submesh_t* submesh = malloc(sizeof(wn_submesh_t));
+    assert(submesh);
+
+    // clang-format off
+    *submesh = (wn_submesh_t) { .transform = { .v4f = {
+                                    (wn_v4f_t) {1.0f, 0.0f, 0.0f, 0.0f},
+                                    (wn_v4f_t) {0.0f, 1.0f, 0.0f, 0.0f},
+                                    (wn_v4f_t) {0.0f, 0.0f, 1.0f, 0.0f},
+                                    (wn_v4f_t) {0.0f, 0.0f, 0.0f, 1.0f},
+                                } },
+                                .n_vertices = (uint32_t)n_vertices,
+                                .lods = { { .n_indices = (uint32_t)n_indices } } };
+
+    return (wn_mesh_t) { .n_vertices = n_vertices,
+                         .vertices = vertices,
+                         .n_indices = n_indices,
+                         .indices = indices,
+                         .n_submeshes = 1,
+                         .submeshes = submesh,
+                         .n_lods = 1,
+                         .lods = { { .n_indices = (uint32_t)n_indices } } };
+    // clang-format on
+}
+
+uint32_t wn_mesh_max_submesh_vertices(const wn_mesh_t* mesh)
+{
+    uint32_t max = 0;
+    for (size_t i = 0; i < mesh->n_submeshes; i++)
+    {
+        max = mesh->submeshes[i].n_vertices > max ? mesh->submeshes[i].n_vertices : max;
+    }
+    return max;
+}
+
+void wn_mesh_destroy(wn_mesh_t* mesh)
+{
+    if (mesh->arena)
+    {
+        wn_range_free(
+            &mesh->arena->vertex_ranges,
+            mesh->arena_vertex_offset,
+            (uint32_t)mesh->n_vertices);
+        wn_range_free(
+            &mesh->arena->index_ranges,
+            mesh->arena_index_offset,
+            (uint32_t)mesh->n_indices);
+    }
+
+    if (mesh->mapping)
+    {
+        munmap(mesh->mapping, mesh->mapping_size);
+    }
+    else
+    {
+        if (!mesh->arena)
+        {
+            free(mesh->vertices);
+            free(mesh->indices);
+        }
+        free(mesh->submeshes);
+        free(mesh->meshlets);
+        free(mesh->meshlet_vertices);
+        free(mesh->meshlet_triangles);
+    }
+    mesh = NULL;
+}
+
+void wn_mesh_weld(wn_mesh_t* mesh)
+{
+    assert(mesh->n_indices == mesh->n_vertices && mesh->n_submeshes == 1 && !mesh->arena);
+
+    wn_vertex_map_t* vertex_map = NULL;
+    uint32_t n_unique = 0;
+
+    for (size_t i = 0; i < mesh->n_vertices; i++)
+    {
+        // NOTE: n_unique <= i, so compacting into the front never clobbers an unread vertex
+        wn_vertex_t vertex = mesh->vertices[i];
+
+        ptrdiff_t found = stbds_hmgeti(vertex_map, vertex);
+        if (found < 0)
+        {
+            mesh->vertices[n_unique] = vertex;
+            stbds_hmput(vertex_map, vertex, n_unique);
+            mesh->indices[i] = n_unique++;
+        }
+        else
+        {
+            mesh->indices[i] = vertex_map[found].value;
+        }
+    }
+
+    stbds_hmfree(vertex_map);
+
+    mesh->n_lods = 1;
+    mesh->lods[0] = (wn_mesh_lod_t) { .n_indices = (uint32_t)mesh->n_indices };
+    mesh->submeshes[0].n_vertices = n_unique;
+    mesh->submeshes[0].lods[0] = mesh->lods[0];
+
+    if (n_unique > 0 && n_unique < mesh->n_vertices)
+    {
+        wn_vertex_t* vertices = realloc(mesh->vertices, sizeof(wn_vertex_t) * n_unique);
+        assert(vertices);
+        mesh->vertices = vertices;
+    }
+    mesh->n_vertices = n_unique;
+}
+
+void wn_mesh_compute_bounds(wn_mesh_t* mesh)
+{
+    if (mesh->n_vertices == 0)
+    {
+        mesh->bounds_min = (wn_v3f_t) { 0 };
+        mesh->bounds_max = (wn_v3f_t) { 0 };
+        return;
+    }
+
+    wn_v3f_t min = mesh->vertices[0].pos;
+    wn_v3f_t max = mesh->vertices[0].pos;
+
+    for (size_t i = 1; i < mesh->n_vertices; i++)
+    {
+        const wn_v3f_t* p = &mesh->vertices[i].pos;
+        for (int j = 0; j < 3; j++)
+        {
+            min.v3f[j] = p->v3f[j] < min.v3f[j] ? p->v3f[j] : min.v3f[j];
+            max.v3f[j] = p->v3f[j] > max.v3f[j] ? p->v3f[j] : max.v3f[j];
+        }
+    }
+
+    mesh->bounds_min = min;
+    mesh->bounds_max = max;
+}
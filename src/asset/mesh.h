@@ -0,0 +1,98 @@
+/*
+===========================================================================
+
+whynot::asset::mesh.h: cpu side mesh data
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+
+typedef struct wn_meshlet_t wn_meshlet_t;
+typedef struct wn_mesh_arena_t wn_mesh_arena_t;
+
+#define WN_MESH_MAX_LODS 8
+
+typedef struct wn_vertex_t
+{
+    wn_v3f_t pos;
+    wn_v2f_t tex_coord0;
+} wn_vertex_t;
+
+// one level of detail, all levels index the same vertices, see mesh_lod.h
+typedef struct wn_mesh_lod_t
+{
+    uint32_t first_index;
+    uint32_t n_indices;
+    uint32_t first_meshlet;
+    uint32_t n_meshlets;
+    float error; // object space deviation from lod 0
+} wn_mesh_lod_t;
+
+// one mesh instance of a flattened scene. Its vertices are a contiguous range of the shared vertex
+// array and its indices are relative to first_vertex, so it is drawn with a base vertex
+typedef struct wn_submesh_t
+{
+    wn_mat4f_t transform; // node to model space
+    uint32_t first_vertex;
+    uint32_t n_vertices;
+    // same levels as wn_mesh_t::lods, ranges of this submesh only
+    wn_mesh_lod_t lods[WN_MESH_MAX_LODS];
+} wn_submesh_t;
+
+// vertices/indices start out as their own allocations so processing can resize them, finished
+// meshes are moved into a wn_mesh_arena_t (see mesh_arena.h)
+typedef struct wn_mesh_t
+{
+    size_t n_vertices;
+    wn_vertex_t* vertices;
+    size_t n_indices;
+    uint32_t* indices;
+    // bounds of the vertices as stored, submesh transforms not applied
+    wn_v3f_t bounds_min;
+    wn_v3f_t bounds_max;
+
+    // always at least one, wn_mesh_new starts out with a single identity submesh
+    size_t n_submeshes;
+    wn_submesh_t* submeshes;
+
+    // lod 0 is the full mesh, coarser levels follow it in indices. Indices are stored level major,
+    // so every level spans the ranges of all submeshes in submesh order. error is the largest of
+    // the submeshes
+    uint32_t n_lods;
+    wn_mesh_lod_t lods[WN_MESH_MAX_LODS];
+
+    // optional cluster decomposition, see meshlet.h
+    size_t n_meshlets;
+    wn_meshlet_t* meshlets;
+    size_t n_meshlet_vertices;
+    uint32_t* meshlet_vertices;
+    size_t n_meshlet_triangles;
+    uint32_t* meshlet_triangles;
+
+    // set when vertices/indices point into a mapped baked file instead of owning allocations
+    void* mapping;
+    size_t mapping_size;
+
+    // set once vertices/indices have ranges in an arena, the offsets address them there (unless
+    // mapped, those stay in the mapping) and in the gpu buffers mirroring it
+    wn_mesh_arena_t* arena;
+    uint32_t arena_vertex_offset;
+    uint32_t arena_index_offset;
+} wn_mesh_t;
+
+wn_mesh_t wn_mesh_new(size_t n_vertices, size_t n_indices);
+
+// largest submesh vertex count, the range base vertex relative indices have to cover
+uint32_t wn_mesh_max_submesh_vertices(const wn_mesh_t* mesh);
+
+void wn_mesh_destroy(wn_mesh_t* mesh);
+
+// welds an unindexed triangle list in place: identical vertices are collapsed into one and the
+// index list is rebuilt to reference them, n_vertices shrinks to the number of unique vertices.
+// Only for meshes with a single submesh
+void wn_mesh_weld(wn_mesh_t* mesh);
+
+void wn_mesh_compute_bounds(wn_mesh_t* mesh);
@@ -0,0 +1,176 @@
+/*
+===========================================================================
+
+whynot::asset::mesh_arena.c: one block for the vertices/indices of every loaded mesh
+
+===========================================================================
+*/
+
+#include "mesh_arena.h"
+
+#include "log.h"
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+void wn_range_allocator_init(wn_range_allocator_t* allocator, uint32_t capacity)
+{
+    *allocator = (wn_range_allocator_t) { .capacity = capacity };
+    if (capacity > 0)
+    {
+        stbds_arrput(allocator->free, ((wn_range_t) { .offset = 0, .size = capacity }));
+    }
+}
+
+void wn_range_allocator_destroy(wn_range_allocator_t* allocator)
+{
+    stbds_arrfree(allocator->free);
+    *allocator = (wn_range_allocator_t) { 0 };
+}
+
+bool wn_range_alloc(wn_range_allocator_t* allocator, uint32_t size, uint32_t* offset)
+{
+    if (size == 0)
+    {
+        *offset = 0;
+        return true;
+    }
+
+    for (ptrdiff_t i = 0; i < stbds_arrlen(allocator->free); i++)
+    {
+        wn_range_t* range = &allocator->free[i];
+        if (range->size < size)
+        {
+            continue;
+        }
+
+        *offset = range->offset;
+        range->offset += size;
+        range->size -= size;
+        if (range->size == 0)
+        {
+            stbds_arrdel(allocator->free, i);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+void wn_range_free(wn_range_allocator_t* allocator, uint32_t offset, uint32_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    assert((uint64_t)offset + size <= allocator->capacity);
+
+    // first free range past the released one
+    ptrdiff_t n_free = stbds_arrlen(allocator->free);
+    ptrdiff_t next = 0;
+    while (next < n_free && allocator->free[next].offset < offset)
+    {
+        next++;
+    }
+
+    wn_range_t* prev_range = next > 0 ? &allocator->free[next - 1] : NULL;
+    wn_range_t* next_range = next < n_free ? &allocator->free[next] : NULL;
+    assert(!prev_range || prev_range->offset + prev_range->size <= offset);
+    assert(!next_range || offset + size <= next_range->offset);
+
+    bool merge_prev = prev_range && prev_range->offset + prev_range->size == offset;
+    bool merge_next = next_range && offset + size == next_range->offset;
+
+    if (merge_prev && merge_next)
+    {
+        prev_range->size += size + next_range->size;
+        stbds_arrdel(allocator->free, next);
+    }
+    else if (merge_prev)
+    {
+        prev_range->size += size;
+    }
+    else if (merge_next)
+    {
+        next_range->offset = offset;
+        next_range->size += size;
+    }
+    else
+    {
+        stbds_arrins(allocator->free, next, ((wn_range_t) { .offset = offset, .size = size }));
+    }
+}
+
+wn_mesh_arena_t wn_mesh_arena_new(uint32_t vertex_capacity, uint32_t index_capacity)
+{
+    wn_mesh_arena_t arena = { 0 };
+
+    size_t vertex_bytes = sizeof(wn_vertex_t) * vertex_capacity;
+    size_t block_size = vertex_bytes + sizeof(uint32_t) * index_capacity;
+
+    // NOTE: anonymous mapping so untouched capacity never gets backed by actual pages
+    arena.block = mmap(NULL, block_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(arena.block != MAP_FAILED);
+    arena.vertices = arena.block;
+    arena.indices = (uint32_t*)((uint8_t*)arena.block + vertex_bytes);
+
+    wn_range_allocator_init(&arena.vertex_ranges, vertex_capacity);
+    wn_range_allocator_init(&arena.index_ranges, index_capacity);
+
+    return arena;
+}
+
+void wn_mesh_arena_destroy(wn_mesh_arena_t* arena)
+{
+    munmap(
+        arena->block,
+        sizeof(wn_vertex_t) * arena->vertex_ranges.capacity
+            + sizeof(uint32_t) * arena->index_ranges.capacity);
+    wn_range_allocator_destroy(&arena->vertex_ranges);
+    wn_range_allocator_destroy(&arena->index_ranges);
+    *arena = (wn_mesh_arena_t) { 0 };
+}
+
+wn_result wn_mesh_arena_add(wn_mesh_arena_t* arena, wn_mesh_t* mesh)
+{
+    assert(!mesh->arena);
+
+    uint32_t vertex_offset = 0;
+    uint32_t index_offset = 0;
+    if (mesh->n_vertices > UINT32_MAX || mesh->n_indices > UINT32_MAX
+        || !wn_range_alloc(&arena->vertex_ranges, (uint32_t)mesh->n_vertices, &vertex_offset))
+    {
+        log_error("Mesh arena is out of vertex space (%zu vertices)", mesh->n_vertices);
+        return WN_ERR;
+    }
+    if (!wn_range_alloc(&arena->index_ranges, (uint32_t)mesh->n_indices, &index_offset))
+    {
+        wn_range_free(&arena->vertex_ranges, vertex_offset, (uint32_t)mesh->n_vertices);
+        log_error("Mesh arena is out of index space (%zu indices)", mesh->n_indices);
+        return WN_ERR;
+    }
+
+    // mapped meshes are used in place, their ranges of the block are never touched (so never backed
+    // by pages) and only reserve the offsets
+    if (!mesh->mapping)
+    {
+        wn_vertex_t* vertices = &arena->vertices[vertex_offset];
+        uint32_t* indices = &arena->indices[index_offset];
+        memcpy(vertices, mesh->vertices, sizeof(wn_vertex_t) * mesh->n_vertices);
+        memcpy(indices, mesh->indices, sizeof(uint32_t) * mesh->n_indices);
+        free(mesh->vertices);
+        free(mesh->indices);
+        mesh->vertices = vertices;
+        mesh->indices = indices;
+    }
+
+    mesh->arena = arena;
+    mesh->arena_vertex_offset = vertex_offset;
+    mesh->arena_index_offset = index_offset;
+
+    return WN_OK;
+}
@@ -0,0 +1,54 @@
+/*
+===========================================================================
+
+whynot::asset::mesh_arena.h: one block for the vertices/indices of every loaded mesh
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+#include "mesh.h"
+
+typedef struct wn_range_t
+{
+    uint32_t offset;
+    uint32_t size;
+} wn_range_t;
+
+// first fit free list over [0, capacity), free ranges are kept sorted and coalesced
+typedef struct wn_range_allocator_t
+{
+    uint32_t capacity;
+    wn_range_t* free; // stbds array
+} wn_range_allocator_t;
+
+void wn_range_allocator_init(wn_range_allocator_t* allocator, uint32_t capacity);
+void wn_range_allocator_destroy(wn_range_allocator_t* allocator);
+bool wn_range_alloc(wn_range_allocator_t* allocator, uint32_t size, uint32_t* offset);
+void wn_range_free(wn_range_allocator_t* allocator, uint32_t offset, uint32_t size);
+
+/*
+ * Meshes are built in their own growable arrays (welding and lod generation resize them) and
+ * moved in here once they're done. Arena meshes are addressed by their vertex/index offset, the
+ * renderer mirrors the same offsets in one device local vertex/index buffer pair so every mesh is
+ * drawn from the same bound buffers with a base vertex/first index.
+ */
+typedef struct wn_mesh_arena_t
+{
+    void* block;
+    wn_vertex_t* vertices; // vertex_ranges.capacity vertices at the start of block
+    uint32_t* indices;     // index_ranges.capacity indices right after them
+
+    wn_range_allocator_t vertex_ranges;
+    wn_range_allocator_t index_ranges;
+} wn_mesh_arena_t;
+
+wn_mesh_arena_t wn_mesh_arena_new(uint32_t vertex_capacity, uint32_t index_capacity);
+void wn_mesh_arena_destroy(wn_mesh_arena_t* arena);
+
+// moves the vertices + indices of mesh into the arena and releases its own copies, a mapped mesh
+// keeps pointing into its mapping and only takes the offsets. wn_mesh_destroy hands the ranges
+// back. Fails if the arena is out of space
+wn_result wn_mesh_arena_add(wn_mesh_arena_t* arena, wn_mesh_t* mesh);
@@ -0,0 +1,361 @@
+/*
+===========================================================================
+
+whynot::asset::mesh_file.c: baked binary mesh format (.wnmesh)
+
+===========================================================================
+*/
+
+#include "mesh_file.h"
+
+#include "meshlet.h"
+
+#include "log.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static inline uint64_t wn_mesh_file_align(uint64_t offset)
+{
+    return (offset + WN_MESH_FILE_ALIGN - 1) & ~(uint64_t)(WN_MESH_FILE_ALIGN - 1);
+}
+
+static bool wn_mesh_file_stat_source(const char* source, uint64_t* size, uint64_t* mtime_ns)
+{
+    struct stat st;
+    if (stat(source, &st) != 0)
+    {
+        return false;
+    }
+    *size = (uint64_t)st.st_size;
+    *mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ull + (uint64_t)st.st_mtim.tv_nsec;
+    return true;
+}
+
+// offset + n * stride <= file_size without overflowing on a crafted header
+static inline bool wn_mesh_file_section_fits(
+    uint64_t offset,
+    uint64_t n,
+    uint64_t stride,
+    uint64_t file_size)
+{
+    return offset % WN_MESH_FILE_ALIGN == 0 && offset <= file_size
+        && n <= (file_size - offset) / stride;
+}
+
+// every index and meshlet entry is checked, they reach the gpu without any further bounds
+static bool wn_mesh_file_check_contents(const wn_mesh_t* mesh)
+{
+    for (size_t i = 0; i < mesh->n_indices; i++)
+    {
+        if (mesh->indices[i] >= mesh->n_vertices)
+        {
+            return false;
+        }
+    }
+
+    for (size_t s = 0; s < mesh->n_submeshes; s++)
+    {
+        const wn_submesh_t* submesh = &mesh->submeshes[s];
+        for (uint32_t l = 0; l < mesh->n_lods; l++)
+        {
+            const wn_mesh_lod_t* lod = &submesh->lods[l];
+            for (uint32_t i = 0; i < lod->n_indices; i++)
+            {
+                if (mesh->indices[lod->first_index + i] >= submesh->n_vertices)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    for (size_t m = 0; m < mesh->n_meshlets; m++)
+    {
+        const wn_meshlet_t* meshlet = &mesh->meshlets[m];
+        if (meshlet->submesh >= mesh->n_submeshes || meshlet->n_vertices > WN_MESHLET_MAX_VERTICES
+            || meshlet->n_triangles > WN_MESHLET_MAX_TRIANGLES
+            || (uint64_t)meshlet->vertex_offset + meshlet->n_vertices > mesh->n_meshlet_vertices
+            || (uint64_t)meshlet->triangle_offset + meshlet->n_triangles
+                > mesh->n_meshlet_triangles)
+        {
+            return false;
+        }
+
+        uint32_t n_submesh_vertices = mesh->submeshes[meshlet->submesh].n_vertices;
+        for (uint32_t i = 0; i < meshlet->n_vertices; i++)
+        {
+            if (mesh->meshlet_vertices[meshlet->vertex_offset + i] >= n_submesh_vertices)
+            {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < meshlet->n_triangles; i++)
+        {
+            uint32_t packed = mesh->meshlet_triangles[meshlet->triangle_offset + i];
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                if (((packed >> (c * 8)) & 0xffu) >= meshlet->n_vertices)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool wn_mesh_file_write_section(FILE* file, uint64_t offset, const void* data, size_t size)
+{
+    static const uint8_t zeros[WN_MESH_FILE_ALIGN] = { 0 };
+
+    long pos = ftell(file);
+    if (pos < 0 || (uint64_t)pos > offset)
+    {
+        return false;
+    }
+    if (fwrite(zeros, 1, (size_t)(offset - (uint64_t)pos), file) != offset - (uint64_t)pos)
+    {
+        return false;
+    }
+    return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+wn_result wn_mesh_file_write(const char* filename, const char* source, const wn_mesh_t* mesh)
+{
+    wn_mesh_file_header_t header = {
+        .magic = WN_MESH_FILE_MAGIC,
+        .version = WN_MESH_FILE_VERSION,
+        .header_size = sizeof(wn_mesh_file_header_t),
+        .vertex_stride = sizeof(wn_vertex_t),
+        .index_size = sizeof(uint32_t),
+        .n_vertices = mesh->n_vertices,
+        .n_indices = mesh->n_indices,
+        .n_meshlets = mesh->n_meshlets,
+        .n_meshlet_vertices = mesh->n_meshlet_vertices,
+        .n_meshlet_triangles = mesh->n_meshlet_triangles,
+        .bounds_min = mesh->bounds_min,
+        .n_submeshes = mesh->n_submeshes,
+        .bounds_max = mesh->bounds_max,
+        .n_lods = mesh->n_lods,
+    };
+    memcpy(header.lods, mesh->lods, sizeof(header.lods));
+
+    if (!wn_mesh_file_stat_source(source, &header.source_size, &header.source_mtime_ns))
+    {
+        log_error("Could not stat %s", source);
+        return WN_ERR;
+    }
+
+    header.vertex_offset = wn_mesh_file_align(sizeof(wn_mesh_file_header_t));
+    header.index_offset
+        = wn_mesh_file_align(header.vertex_offset + header.n_vertices * header.vertex_stride);
+    header.meshlet_offset
+        = wn_mesh_file_align(header.index_offset + header.n_indices * header.index_size);
+    header.meshlet_vertex_offset
+        = wn_mesh_file_align(header.meshlet_offset + header.n_meshlets * sizeof(wn_meshlet_t));
+    header.meshlet_triangle_offset = wn_mesh_file_align(
+        header.meshlet_vertex_offset + header.n_meshlet_vertices * sizeof(uint32_t));
+    header.submesh_offset = wn_mesh_file_align(
+        header.meshlet_triangle_offset + header.n_meshlet_triangles * sizeof(uint32_t));
+    header.file_size = wn_mesh_file_align(
+        header.submesh_offset + header.n_submeshes * sizeof(wn_submesh_t));
+
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+    {
+        log_error("Could not open %s for writing", filename);
+        return WN_ERR;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && wn_mesh_file_write_section(
+               file,
+               header.vertex_offset,
+               mesh->vertices,
+               header.n_vertices * header.vertex_stride)
+        && wn_mesh_file_write_section(
+               file,
+               header.index_offset,
+               mesh->indices,
+               header.n_indices * header.index_size)
+        && wn_mesh_file_write_section(
+               file,
+               header.meshlet_offset,
+               mesh->meshlets,
+               header.n_meshlets * sizeof(wn_meshlet_t))
+        && wn_mesh_file_write_section(
+               file,
+               header.meshlet_vertex_offset,
+               mesh->meshlet_vertices,
+               header.n_meshlet_vertices * sizeof(uint32_t))
+        && wn_mesh_file_write_section(
+               file,
+               header.meshlet_triangle_offset,
+               mesh->meshlet_triangles,
+               header.n_meshlet_triangles * sizeof(uint32_t))
+        && wn_mesh_file_write_section(
+               file,
+               header.submesh_offset,
+               mesh->submeshes,
+               header.n_submeshes * sizeof(wn_submesh_t))
+        && wn_mesh_file_write_section(file, header.file_size, NULL, 0);
+
+    if (fclose(file) != 0 || !ok)
+    {
+        log_error("Could not write baked mesh %s", filename);
+        return WN_ERR;
+    }
+
+    return WN_OK;
+}
+
+wn_result wn_mesh_file_map(const char* filename, const char* source, wn_mesh_t* mesh)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return WN_ERR;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(wn_mesh_file_header_t))
+    {
+        log_error("Baked mesh %s is truncated", filename);
+        close(fd);
+        return WN_ERR;
+    }
+
+    size_t size = (size_t)st.st_size;
+    // NOTE: private + writable so in place processing gets copy on write pages instead of a fault,
+    // nothing is ever written back
+    uint8_t* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        log_error("Could not map baked mesh %s", filename);
+        return WN_ERR;
+    }
+
+    const wn_mesh_file_header_t* header = (const wn_mesh_file_header_t*)data;
+
+    bool valid = header->magic == WN_MESH_FILE_MAGIC && header->version == WN_MESH_FILE_VERSION
+        && header->header_size == sizeof(wn_mesh_file_header_t)
+        && header->vertex_stride == sizeof(wn_vertex_t) && header->index_size == sizeof(uint32_t)
+        && header->file_size <= size
+        && wn_mesh_file_section_fits(
+            header->vertex_offset,
+            header->n_vertices,
+            header->vertex_stride,
+            header->file_size)
+        && wn_mesh_file_section_fits(
+            header->index_offset,
+            header->n_indices,
+            header->index_size,
+            header->file_size)
+        && wn_mesh_file_section_fits(
+            header->meshlet_offset,
+            header->n_meshlets,
+            sizeof(wn_meshlet_t),
+            header->file_size)
+        && wn_mesh_file_section_fits(
+            header->meshlet_vertex_offset,
+            header->n_meshlet_vertices,
+            sizeof(uint32_t),
+            header->file_size)
+        && wn_mesh_file_section_fits(
+            header->meshlet_triangle_offset,
+            header->n_meshlet_triangles,
+            sizeof(uint32_t),
+            header->file_size)
+        && wn_mesh_file_section_fits(
+            header->submesh_offset,
+            header->n_submeshes,
+            sizeof(wn_submesh_t),
+            header->file_size)
+        && header->n_submeshes >= 1 && header->n_lods >= 1 && header->n_lods <= WN_MESH_MAX_LODS;
+
+    for (uint32_t i = 0; valid && i < header->n_lods; i++)
+    {
+        const wn_mesh_lod_t* lod = &header->lods[i];
+        valid = (uint64_t)lod->first_index + lod->n_indices <= header->n_indices
+            && (uint64_t)lod->first_meshlet + lod->n_meshlets <= header->n_meshlets;
+    }
+
+    const wn_submesh_t* submeshes = (const wn_submesh_t*)(data + header->submesh_offset);
+    for (uint64_t i = 0; valid && i < header->n_submeshes; i++)
+    {
+        valid = (uint64_t)submeshes[i].first_vertex + submeshes[i].n_vertices <= header->n_vertices;
+        for (uint32_t j = 0; valid && j < header->n_lods; j++)
+        {
+            const wn_mesh_lod_t* lod = &submeshes[i].lods[j];
+            valid = (uint64_t)lod->first_index + lod->n_indices <= header->n_indices
+                && (uint64_t)lod->first_meshlet + lod->n_meshlets <= header->n_meshlets;
+        }
+    }
+
+    if (!valid)
+    {
+        log_error("Baked mesh %s is invalid or was baked with an older version", filename);
+        munmap(data, size);
+        return WN_ERR;
+    }
+
+    uint64_t source_size, source_mtime_ns;
+    if (source && wn_mesh_file_stat_source(source, &source_size, &source_mtime_ns)
+        && (source_size != header->source_size || source_mtime_ns != header->source_mtime_ns))
+    {
+        log_warn("Baked mesh %s is older than %s, ignoring it", filename, source);
+        munmap(data, size);
+        return WN_ERR;
+    }
+
+    madvise(data, size, MADV_WILLNEED);
+
+    *mesh = (wn_mesh_t) {
+        .n_vertices = header->n_vertices,
+        .vertices = (wn_vertex_t*)(data + header->vertex_offset),
+        .n_indices = header->n_indices,
+        .indices = (uint32_t*)(data + header->index_offset),
+        .bounds_min = header->bounds_min,
+        .bounds_max = header->bounds_max,
+        .n_submeshes = header->n_submeshes,
+        .submeshes = (wn_submesh_t*)(data + header->submesh_offset),
+        .n_lods = header->n_lods,
+        .n_meshlets = header->n_meshlets,
+        .meshlets = (wn_meshlet_t*)(data + header->meshlet_offset),
+        .n_meshlet_vertices = header->n_meshlet_vertices,
+        .meshlet_vertices = (uint32_t*)(data + header->meshlet_vertex_offset),
+        .n_meshlet_triangles = header->n_meshlet_triangles,
+        .meshlet_triangles = (uint32_t*)(data + header->meshlet_triangle_offset),
+        .mapping = data,
+        .mapping_size = size,
+    };
+
+    memcpy(mesh->lods, header->lods, sizeof(mesh->lods));
+
+    if (!wn_mesh_file_check_contents(mesh))
+    {
+        log_error("Baked mesh %s has indices or meshlets out of range", filename);
+        munmap(data, size);
+        *mesh = (wn_mesh_t) { 0 };
+        return WN_ERR;
+    }
+
+    return WN_OK;
+}
+
+bool wn_mesh_file_baked_path(const char* source, char* out, size_t out_size)
+{
+    const char* ext = strrchr(source, '.');
+    const char* sep = strrchr(source, '/');
+    size_t stem = (ext && (!sep || ext > sep)) ? (size_t)(ext - source) : strlen(source);
+
+    int written = snprintf(out, out_size, "%.*s.wnmesh", (int)stem, source);
+    return written > 0 && (size_t)written < out_size;
+}
@@ -0,0 +1,74 @@
+/*
+===========================================================================
+
+whynot::asset::mesh_file.h: baked binary mesh format (.wnmesh)
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+#include "mesh.h"
+#include "meshlet.h"
+
+#define WN_MESH_FILE_MAGIC 0x48534d57u // "WMSH"
+#define WN_MESH_FILE_VERSION 5u
+// every section starts on this boundary so streams can be used in place from the mapping
+#define WN_MESH_FILE_ALIGN 64u
+
+/*
+ * layout (little endian):
+ *   wn_mesh_file_header_t
+ *   vertex stream: n_vertices * vertex_stride bytes at vertex_offset
+ *   index stream: n_indices * index_size bytes at index_offset
+ *   meshlets: n_meshlets * sizeof(wn_meshlet_t) at meshlet_offset
+ *   meshlet vertices: n_meshlet_vertices * uint32_t at meshlet_vertex_offset
+ *   meshlet triangles: n_meshlet_triangles * uint32_t at meshlet_triangle_offset
+ *   submeshes: n_submeshes * sizeof(wn_submesh_t) at submesh_offset
+ */
+typedef struct wn_mesh_file_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t vertex_stride;
+    uint32_t index_size;
+    uint32_t _pad0;
+
+    uint64_t file_size;
+
+    // stat of the model it was baked from, a mismatch means the bake is stale
+    uint64_t source_size;
+    uint64_t source_mtime_ns;
+
+    uint64_t n_vertices;
+    uint64_t vertex_offset;
+    uint64_t n_indices;
+    uint64_t index_offset;
+    uint64_t n_meshlets;
+    uint64_t meshlet_offset;
+    uint64_t n_meshlet_vertices;
+    uint64_t meshlet_vertex_offset;
+    uint64_t n_meshlet_triangles;
+    uint64_t meshlet_triangle_offset;
+    uint64_t n_submeshes;
+    uint64_t submesh_offset;
+
+    wn_v3f_t bounds_min;
+    wn_v3f_t bounds_max;
+
+    uint32_t n_lods;
+    wn_mesh_lod_t lods[WN_MESH_MAX_LODS]; // ranges into the index/meshlet sections
+} wn_mesh_file_header_t;
+
+// source is the model mesh was baked from, its size and modification time go into the header
+wn_result wn_mesh_file_write(const char* filename, const char* source, const wn_mesh_t* mesh);
+
+// maps a baked mesh read-only, the returned mesh points into the mapping and is released by
+// wn_mesh_destroy as usual. Fails if source (unless NULL) changed since the bake, or if any
+// range, index or meshlet entry in the file is out of bounds
+wn_result wn_mesh_file_map(const char* filename, const char* source, wn_mesh_t* mesh);
+
+// source model path with its extension swapped for .wnmesh, false if it doesn't fit in out
+bool wn_mesh_file_baked_path(const char* source, char* out, size_t out_size);
@@ -0,0 +1,866 @@
+/*
+===========================================================================
+
+whynot::asset::mesh_lod.c: quadric error simplification + LOD chain selection
+
+===========================================================================
+*/
+
+#include "mesh_lod.h"
+#include "mesh_opt.h"
+
+#include "log.h"
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// how far past the error of the collapse that would meet the target a pass may go
+#define WN_SIMPLIFY_PASS_ERROR_BOUND 1.5f
+
+// uv charts meeting at a position beyond this lock it, real seams rarely have more than 4
+#define WN_SIMPLIFY_MAX_WEDGES 8
+
+typedef enum wn_simplify_kind
+{
+    WN_SIMPLIFY_FREE,   // may collapse anywhere, crossing uv seams only costs error
+    WN_SIMPLIFY_LOCKED, // border or too many charts, never moves
+} wn_simplify_kind;
+
+// symmetric 4x4 plane quadric, w is the accumulated triangle area
+typedef struct wn_quadric_t
+{
+    float a00, a11, a22, a01, a02, a12;
+    float b0, b1, b2;
+    float c;
+    float w;
+} wn_quadric_t;
+
+// every wedge (vertex) of from_pos is remapped to one of to_pos
+typedef struct wn_collapse_t
+{
+    uint32_t from_pos; // position that disappears
+    uint32_t to_pos;
+    uint32_t n_wedges;
+    uint32_t from_wedge[WN_SIMPLIFY_MAX_WEDGES];
+    uint32_t to_wedge[WN_SIMPLIFY_MAX_WEDGES];
+    float error;
+} wn_collapse_t;
+
+typedef struct wn_position_map_t
+{
+    wn_v3f_t key;
+    uint32_t value;
+} wn_position_map_t;
+
+typedef struct wn_simplifier_t
+{
+    size_t n_vertices;
+    const wn_vertex_t* vertices;
+    wn_v3f_t* positions; // normalized into the unit cube
+    uint32_t* pos_id;    // vertex -> first vertex with the same position
+
+    wn_quadric_t* quadrics; // per pos_id
+
+    // pos_id -> triangles referencing it, rebuilt every pass
+    uint32_t* adj_offsets;
+    uint32_t* adj_triangles;
+
+    uint8_t* kind;
+    uint8_t* n_wedges;
+    uint32_t* wedge_seen;
+    uint8_t* collapse_locked;
+    uint32_t* remap;
+} wn_simplifier_t;
+
+static void wn_quadric_add(wn_quadric_t* q, const wn_quadric_t* r)
+{
+    q->a00 += r->a00;
+    q->a11 += r->a11;
+    q->a22 += r->a22;
+    q->a01 += r->a01;
+    q->a02 += r->a02;
+    q->a12 += r->a12;
+    q->b0 += r->b0;
+    q->b1 += r->b1;
+    q->b2 += r->b2;
+    q->c += r->c;
+    q->w += r->w;
+}
+
+// mean squared distance of p to the planes in q
+static float wn_quadric_error(const wn_quadric_t* q, wn_v3f_t p)
+{
+    float rx = q->a00 * p.x + q->a01 * p.y + q->a02 * p.z + 2.0f * q->b0;
+    float ry = q->a01 * p.x + q->a11 * p.y + q->a12 * p.z + 2.0f * q->b1;
+    float rz = q->a02 * p.x + q->a12 * p.y + q->a22 * p.z + 2.0f * q->b2;
+    float e = rx * p.x + ry * p.y + rz * p.z + q->c;
+
+    return q->w > 0.0f ? fabsf(e) / q->w : 0.0f;
+}
+
+static wn_v3f_t wn_simplify_normal(wn_v3f_t p0, wn_v3f_t p1, wn_v3f_t p2)
+{
+    wn_v3f_t e1 = { .x = p1.x - p0.x, .y = p1.y - p0.y, .z = p1.z - p0.z };
+    wn_v3f_t e2 = { .x = p2.x - p0.x, .y = p2.y - p0.y, .z = p2.z - p0.z };
+    return (wn_v3f_t) {
+        .x = e1.y * e2.z - e1.z * e2.y,
+        .y = e1.z * e2.x - e1.x * e2.z,
+        .z = e1.x * e2.y - e1.y * e2.x,
+    };
+}
+
+static void wn_simplify_init(
+    wn_simplifier_t* s,
+    const uint32_t* indices,
+    size_t n_indices,
+    const wn_vertex_t* vertices,
+    size_t n_vertices,
+    float* scale)
+{
+    s->n_vertices = n_vertices;
+    s->vertices = vertices;
+    s->positions = malloc(sizeof(wn_v3f_t) * n_vertices);
+    s->pos_id = malloc(sizeof(uint32_t) * n_vertices);
+    s->quadrics = calloc(n_vertices, sizeof(wn_quadric_t));
+    s->adj_offsets = malloc(sizeof(uint32_t) * (n_vertices + 1));
+    s->adj_triangles = malloc(sizeof(uint32_t) * (n_indices ? n_indices : 1));
+    s->kind = malloc(n_vertices);
+    s->n_wedges = malloc(n_vertices);
+    s->wedge_seen = malloc(sizeof(uint32_t) * n_vertices);
+    s->collapse_locked = malloc(n_vertices);
+    s->remap = malloc(sizeof(uint32_t) * n_vertices);
+    assert(
+        s->positions && s->pos_id && s->quadrics && s->adj_offsets && s->adj_triangles && s->kind
+        && s->n_wedges && s->wedge_seen && s->collapse_locked && s->remap);
+
+    // unit cube keeps the float quadrics well conditioned regardless of model scale
+    wn_v3f_t min = vertices[0].pos;
+    wn_v3f_t max = vertices[0].pos;
+    for (size_t i = 1; i < n_vertices; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            float v = vertices[i].pos.v3f[j];
+            min.v3f[j] = v < min.v3f[j] ? v : min.v3f[j];
+            max.v3f[j] = v > max.v3f[j] ? v : max.v3f[j];
+        }
+    }
+    float extent = fmaxf(max.x - min.x, fmaxf(max.y - min.y, max.z - min.z));
+    *scale = extent > 0.0f ? extent : 1.0f;
+
+    wn_position_map_t* position_map = NULL;
+    for (size_t i = 0; i < n_vertices; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            s->positions[i].v3f[j] = (vertices[i].pos.v3f[j] - min.v3f[j]) / *scale;
+        }
+
+        ptrdiff_t found = stbds_hmgeti(position_map, vertices[i].pos);
+        if (found < 0)
+        {
+            stbds_hmput(position_map, vertices[i].pos, (uint32_t)i);
+            s->pos_id[i] = (uint32_t)i;
+        }
+        else
+        {
+            s->pos_id[i] = position_map[found].value;
+        }
+    }
+    stbds_hmfree(position_map);
+
+    for (size_t i = 0; i + 2 < n_indices; i += 3)
+    {
+        wn_v3f_t p0 = s->positions[indices[i + 0]];
+        wn_v3f_t p1 = s->positions[indices[i + 1]];
+        wn_v3f_t p2 = s->positions[indices[i + 2]];
+
+        wn_v3f_t n = wn_simplify_normal(p0, p1, p2);
+        float len = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+        if (len <= 0.0f)
+        {
+            continue;
+        }
+        float area = len * 0.5f;
+        n.x /= len;
+        n.y /= len;
+        n.z /= len;
+        float d = -(n.x * p0.x + n.y * p0.y + n.z * p0.z);
+
+        wn_quadric_t q = {
+            .a00 = n.x * n.x * area,
+            .a11 = n.y * n.y * area,
+            .a22 = n.z * n.z * area,
+            .a01 = n.x * n.y * area,
+            .a02 = n.x * n.z * area,
+            .a12 = n.y * n.z * area,
+            .b0 = n.x * d * area,
+            .b1 = n.y * d * area,
+            .b2 = n.z * d * area,
+            .c = d * d * area,
+            .w = area,
+        };
+
+        for (int c = 0; c < 3; c++)
+        {
+            wn_quadric_add(&s->quadrics[s->pos_id[indices[i + c]]], &q);
+        }
+    }
+}
+
+static void wn_simplify_free(wn_simplifier_t* s)
+{
+    free(s->positions);
+    free(s->pos_id);
+    free(s->quadrics);
+    free(s->adj_offsets);
+    free(s->adj_triangles);
+    free(s->kind);
+    free(s->n_wedges);
+    free(s->wedge_seen);
+    free(s->collapse_locked);
+    free(s->remap);
+}
+
+// finds the triangle on the other side of the directed edge a -> b (by position), returns
+// UINT32_MAX on a border, corner_a/corner_b receive the index slots of a and b in it
+static uint32_t wn_simplify_opposite(
+    const wn_simplifier_t* s,
+    const uint32_t* indices,
+    uint32_t pos_a,
+    uint32_t pos_b,
+    uint32_t* corner_a,
+    uint32_t* corner_b)
+{
+    for (uint32_t i = s->adj_offsets[pos_a]; i < s->adj_offsets[pos_a + 1]; i++)
+    {
+        uint32_t t = s->adj_triangles[i];
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            uint32_t next = (c + 1) % 3;
+            if (s->pos_id[indices[t * 3 + c]] == pos_b
+                && s->pos_id[indices[t * 3 + next]] == pos_a)
+            {
+                *corner_a = t * 3 + next;
+                *corner_b = t * 3 + c;
+                return t;
+            }
+        }
+    }
+    return UINT32_MAX;
+}
+
+static void wn_simplify_classify(wn_simplifier_t* s, const uint32_t* indices, size_t n_indices)
+{
+    size_t n_triangles = n_indices / 3;
+
+    memset(s->adj_offsets, 0, sizeof(uint32_t) * (s->n_vertices + 1));
+    for (size_t i = 0; i < n_indices; i++)
+    {
+        s->adj_offsets[s->pos_id[indices[i]] + 1]++;
+    }
+    for (size_t i = 0; i < s->n_vertices; i++)
+    {
+        s->adj_offsets[i + 1] += s->adj_offsets[i];
+    }
+    // reuse remap as the fill cursor, it's reset before use anyway
+    memcpy(s->remap, s->adj_offsets, sizeof(uint32_t) * s->n_vertices);
+    for (size_t t = 0; t < n_triangles; t++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            s->adj_triangles[s->remap[s->pos_id[indices[t * 3 + c]]]++] = (uint32_t)t;
+        }
+    }
+
+    // live wedges per position
+    memset(s->n_wedges, 0, s->n_vertices);
+    memset(s->wedge_seen, 0, sizeof(uint32_t) * s->n_vertices);
+    for (size_t i = 0; i < n_indices; i++)
+    {
+        uint32_t v = indices[i];
+        if (!s->wedge_seen[v])
+        {
+            s->wedge_seen[v] = 1;
+            uint32_t p = s->pos_id[v];
+            s->n_wedges[p] = s->n_wedges[p] < 255 ? s->n_wedges[p] + 1 : 255;
+        }
+    }
+
+    for (size_t i = 0; i < s->n_vertices; i++)
+    {
+        s->kind[i]
+            = s->n_wedges[i] <= WN_SIMPLIFY_MAX_WEDGES ? WN_SIMPLIFY_FREE : WN_SIMPLIFY_LOCKED;
+    }
+
+    // open edges lock both ends
+    for (size_t t = 0; t < n_triangles; t++)
+    {
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            uint32_t a = s->pos_id[indices[t * 3 + c]];
+            uint32_t b = s->pos_id[indices[t * 3 + (c + 1) % 3]];
+            uint32_t corner_a, corner_b;
+            if (wn_simplify_opposite(s, indices, a, b, &corner_a, &corner_b) == UINT32_MAX)
+            {
+                s->kind[a] = WN_SIMPLIFY_LOCKED;
+                s->kind[b] = WN_SIMPLIFY_LOCKED;
+            }
+        }
+    }
+}
+
+static float wn_simplify_area(const wn_simplifier_t* s, const uint32_t* tri)
+{
+    wn_v3f_t n
+        = wn_simplify_normal(s->positions[tri[0]], s->positions[tri[1]], s->positions[tri[2]]);
+    return 0.5f * sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+}
+
+/*
+ * Squared distance the texture of tri slides across the surface when its corner at position u
+ * moves onto v and takes over the uv of wedge: the uv tri's own mapping would have at v against
+ * the one it gets, brought back into object space through that mapping. 0 if tri has no usable
+ * mapping, so meshes without uvs simplify on geometry alone.
+ */
+static float wn_simplify_uv_slide(
+    const wn_simplifier_t* s,
+    const uint32_t* tri,
+    uint32_t u,
+    uint32_t v,
+    uint32_t wedge)
+{
+    uint32_t k = s->pos_id[tri[0]] == u ? 0 : s->pos_id[tri[1]] == u ? 1 : 2;
+    uint32_t w0 = tri[k];
+    uint32_t w1 = tri[(k + 1) % 3];
+    uint32_t w2 = tri[(k + 2) % 3];
+
+    wn_v3f_t p0 = s->positions[w0];
+    wn_v3f_t p1 = s->positions[w1];
+    wn_v3f_t p2 = s->positions[w2];
+    wn_v3f_t pv = s->positions[v];
+    wn_v3f_t e1 = { .x = p1.x - p0.x, .y = p1.y - p0.y, .z = p1.z - p0.z };
+    wn_v3f_t e2 = { .x = p2.x - p0.x, .y = p2.y - p0.y, .z = p2.z - p0.z };
+    wn_v3f_t q = { .x = pv.x - p0.x, .y = pv.y - p0.y, .z = pv.z - p0.z };
+
+    wn_v2f_t t0 = s->vertices[w0].tex_coord0;
+    wn_v2f_t d1 = { .u = s->vertices[w1].tex_coord0.u - t0.u,
+                    .v = s->vertices[w1].tex_coord0.v - t0.v };
+    wn_v2f_t d2 = { .u = s->vertices[w2].tex_coord0.u - t0.u,
+                    .v = s->vertices[w2].tex_coord0.v - t0.v };
+
+    // v in the frame of the edges, projected onto the plane of tri
+    float g11 = e1.x * e1.x + e1.y * e1.y + e1.z * e1.z;
+    float g12 = e1.x * e2.x + e1.y * e2.y + e1.z * e2.z;
+    float g22 = e2.x * e2.x + e2.y * e2.y + e2.z * e2.z;
+    float det = g11 * g22 - g12 * g12;
+    float uv_det = d1.u * d2.v - d1.v * d2.u;
+    if (det <= FLT_MIN || fabsf(uv_det) <= FLT_MIN)
+    {
+        return 0.0f;
+    }
+    float qe1 = q.x * e1.x + q.y * e1.y + q.z * e1.z;
+    float qe2 = q.x * e2.x + q.y * e2.y + q.z * e2.z;
+    float a = (g22 * qe1 - g12 * qe2) / det;
+    float b = (g11 * qe2 - g12 * qe1) / det;
+
+    wn_v2f_t target = s->vertices[wedge].tex_coord0;
+    wn_v2f_t duv = {
+        .u = target.u - (t0.u + a * d1.u + b * d2.u),
+        .v = target.v - (t0.v + a * d1.v + b * d2.v),
+    };
+
+    // the same uv difference as an offset along the edges
+    float da = (duv.u * d2.v - duv.v * d2.u) / uv_det;
+    float db = (d1.u * duv.v - d1.v * duv.u) / uv_det;
+    wn_v3f_t slide = {
+        .x = da * e1.x + db * e2.x,
+        .y = da * e1.y + db * e2.y,
+        .z = da * e1.z + db * e2.z,
+    };
+    return slide.x * slide.x + slide.y * slide.y + slide.z * slide.z;
+}
+
+/*
+ * Moves position u onto v, every wedge of u takes over the wedge of v its triangles' uv mapping
+ * fits best. Within a chart that is the wedge of v in the same chart at no cost, across a seam
+ * the texture slides, which adds to the quadric error. False if u or v can't be collapsed.
+ */
+static bool wn_simplify_collapse_new(
+    const wn_simplifier_t* s,
+    const uint32_t* indices,
+    uint32_t u,
+    uint32_t v,
+    wn_collapse_t* collapse)
+{
+    if (s->kind[u] == WN_SIMPLIFY_LOCKED)
+    {
+        return false;
+    }
+
+    uint32_t v_wedges[WN_SIMPLIFY_MAX_WEDGES];
+    uint32_t n_v_wedges = 0;
+    for (uint32_t i = s->adj_offsets[v]; i < s->adj_offsets[v + 1]; i++)
+    {
+        const uint32_t* tri = &indices[s->adj_triangles[i] * 3];
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            if (s->pos_id[tri[c]] != v)
+            {
+                continue;
+            }
+            uint32_t w = 0;
+            while (w < n_v_wedges && v_wedges[w] != tri[c])
+            {
+                w++;
+            }
+            if (w == n_v_wedges)
+            {
+                if (n_v_wedges == WN_SIMPLIFY_MAX_WEDGES)
+                {
+                    return false;
+                }
+                v_wedges[n_v_wedges++] = tri[c];
+            }
+        }
+    }
+
+    collapse->from_pos = u;
+    collapse->to_pos = v;
+    collapse->n_wedges = 0;
+
+    float slide_error = 0.0f;
+    float slide_area = 0.0f;
+    for (uint32_t i = s->adj_offsets[u]; i < s->adj_offsets[u + 1]; i++)
+    {
+        const uint32_t* tri = &indices[s->adj_triangles[i] * 3];
+        uint32_t from = s->pos_id[tri[0]] == u ? tri[0] : s->pos_id[tri[1]] == u ? tri[1] : tri[2];
+
+        bool seen = false;
+        for (uint32_t w = 0; w < collapse->n_wedges; w++)
+        {
+            seen |= collapse->from_wedge[w] == from;
+        }
+        if (seen)
+        {
+            continue;
+        }
+
+        // only the triangles of the wedge that survive the collapse see the new uv
+        float best_error = FLT_MAX;
+        float area = 0.0f;
+        uint32_t best = v_wedges[0];
+        for (uint32_t w = 0; w < n_v_wedges; w++)
+        {
+            float error = 0.0f;
+            area = 0.0f;
+            for (uint32_t j = s->adj_offsets[u]; j < s->adj_offsets[u + 1]; j++)
+            {
+                const uint32_t* other = &indices[s->adj_triangles[j] * 3];
+                if ((other[0] != from && other[1] != from && other[2] != from)
+                    || s->pos_id[other[0]] == v || s->pos_id[other[1]] == v
+                    || s->pos_id[other[2]] == v)
+                {
+                    continue;
+                }
+                float other_area = wn_simplify_area(s, other);
+                error += other_area * wn_simplify_uv_slide(s, other, u, v, v_wedges[w]);
+                area += other_area;
+            }
+            if (error < best_error)
+            {
+                best_error = error;
+                best = v_wedges[w];
+            }
+        }
+
+        assert(collapse->n_wedges < WN_SIMPLIFY_MAX_WEDGES);
+        collapse->from_wedge[collapse->n_wedges] = from;
+        collapse->to_wedge[collapse->n_wedges] = best;
+        collapse->n_wedges++;
+        slide_error += best_error;
+        slide_area += area;
+    }
+
+    wn_quadric_t q = s->quadrics[u];
+    wn_quadric_add(&q, &s->quadrics[v]);
+    collapse->error = wn_quadric_error(&q, s->positions[v]);
+    if (slide_area > 0.0f)
+    {
+        collapse->error += slide_error / slide_area;
+    }
+
+    return true;
+}
+
+// moving u onto v must not flip any triangle that survives the collapse
+static bool wn_simplify_flips(
+    const wn_simplifier_t* s,
+    const uint32_t* indices,
+    uint32_t u,
+    uint32_t v)
+{
+    wn_v3f_t target = s->positions[v];
+
+    for (uint32_t i = s->adj_offsets[u]; i < s->adj_offsets[u + 1]; i++)
+    {
+        const uint32_t* tri = &indices[s->adj_triangles[i] * 3];
+        uint32_t p[3] = { s->pos_id[tri[0]], s->pos_id[tri[1]], s->pos_id[tri[2]] };
+        if (p[0] == v || p[1] == v || p[2] == v)
+        {
+            continue;
+        }
+
+        wn_v3f_t before[3] = { s->positions[p[0]], s->positions[p[1]], s->positions[p[2]] };
+        wn_v3f_t after[3] = { before[0], before[1], before[2] };
+        for (int c = 0; c < 3; c++)
+        {
+            if (p[c] == u)
+            {
+                after[c] = target;
+            }
+        }
+
+        wn_v3f_t n0 = wn_simplify_normal(before[0], before[1], before[2]);
+        wn_v3f_t n1 = wn_simplify_normal(after[0], after[1], after[2]);
+        float len0 = sqrtf(n0.x * n0.x + n0.y * n0.y + n0.z * n0.z);
+        float len1 = sqrtf(n1.x * n1.x + n1.y * n1.y + n1.z * n1.z);
+
+        // NOTE: also rejects collapses that leave slivers, ~ 75 degree turn
+        if (n0.x * n1.x + n0.y * n1.y + n0.z * n1.z <= 0.25f * len0 * len1)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int wn_collapse_compare(const void* a, const void* b)
+{
+    float ea = ((const wn_collapse_t*)a)->error;
+    float eb = ((const wn_collapse_t*)b)->error;
+    return ea < eb ? -1 : ea > eb ? 1 : 0;
+}
+
+size_t wn_mesh_simplify(
+    const uint32_t* indices,
+    size_t n_indices,
+    const wn_vertex_t* vertices,
+    size_t n_vertices,
+    size_t target_n_indices,
+    float target_error,
+    uint32_t* out_indices,
+    float* out_error)
+{
+    *out_error = 0.0f;
+    n_indices -= n_indices % 3;
+    memcpy(out_indices, indices, sizeof(uint32_t) * n_indices);
+    if (n_indices == 0 || n_vertices == 0)
+    {
+        return n_indices;
+    }
+
+    float scale;
+    wn_simplifier_t s = { 0 };
+    wn_simplify_init(&s, indices, n_indices, vertices, n_vertices, &scale);
+
+    float error_limit = (target_error / scale) * (target_error / scale);
+    float max_error = 0.0f;
+
+    while (n_indices > target_n_indices)
+    {
+        wn_simplify_classify(&s, out_indices, n_indices);
+
+        // every interior edge shows up twice, only look at it from the side where a < b
+        wn_collapse_t* collapses = NULL;
+        for (size_t t = 0; t < n_indices / 3; t++)
+        {
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                uint32_t a_corner = (uint32_t)t * 3 + c;
+                uint32_t b_corner = (uint32_t)t * 3 + (c + 1) % 3;
+                uint32_t a = s.pos_id[out_indices[a_corner]];
+                uint32_t b = s.pos_id[out_indices[b_corner]];
+                if (a >= b)
+                {
+                    continue;
+                }
+
+                uint32_t a_opposite, b_opposite;
+                if (wn_simplify_opposite(&s, out_indices, a, b, &a_opposite, &b_opposite)
+                    == UINT32_MAX)
+                {
+                    continue;
+                }
+
+                wn_collapse_t ab, ba;
+                bool ab_ok = wn_simplify_collapse_new(&s, out_indices, a, b, &ab);
+                bool ba_ok = wn_simplify_collapse_new(&s, out_indices, b, a, &ba);
+
+                if (ab_ok && (!ba_ok || ab.error <= ba.error))
+                {
+                    stbds_arrput(collapses, ab);
+                }
+                else if (ba_ok)
+                {
+                    stbds_arrput(collapses, ba);
+                }
+            }
+        }
+
+        size_t n_collapses = stbds_arrlen(collapses);
+        if (n_collapses == 0)
+        {
+            stbds_arrfree(collapses);
+            break;
+        }
+        qsort(collapses, n_collapses, sizeof(wn_collapse_t), wn_collapse_compare);
+
+        for (size_t i = 0; i < n_vertices; i++)
+        {
+            s.remap[i] = (uint32_t)i;
+        }
+        memset(s.collapse_locked, 0, n_vertices);
+
+        // an interior collapse removes two triangles
+        size_t budget = (n_indices - target_n_indices) / 3;
+        size_t removed = 0;
+        size_t applied = 0;
+
+        // ring locking rejects many, but going all the way to error_limit in the first pass would
+        // spend the whole budget on one level, so stay near the cheapest collapses that could do
+        size_t goal = budget / 2 < n_collapses ? budget / 2 : n_collapses - 1;
+        float pass_limit = fminf(error_limit, collapses[goal].error * WN_SIMPLIFY_PASS_ERROR_BOUND);
+
+        for (size_t i = 0; i < n_collapses && removed < budget; i++)
+        {
+            const wn_collapse_t* collapse = &collapses[i];
+            if (collapse->error > pass_limit)
+            {
+                break;
+            }
+            if (s.collapse_locked[collapse->from_pos] || s.collapse_locked[collapse->to_pos])
+            {
+                continue;
+            }
+            if (wn_simplify_flips(&s, out_indices, collapse->from_pos, collapse->to_pos))
+            {
+                continue;
+            }
+
+            for (uint32_t w = 0; w < collapse->n_wedges; w++)
+            {
+                s.remap[collapse->from_wedge[w]] = collapse->to_wedge[w];
+            }
+            wn_quadric_add(&s.quadrics[collapse->to_pos], &s.quadrics[collapse->from_pos]);
+
+            // lock the whole ring so later flip checks this pass still see the real geometry
+            uint32_t u = collapse->from_pos;
+            for (uint32_t j = s.adj_offsets[u]; j < s.adj_offsets[u + 1]; j++)
+            {
+                const uint32_t* tri = &out_indices[s.adj_triangles[j] * 3];
+                s.collapse_locked[s.pos_id[tri[0]]] = 1;
+                s.collapse_locked[s.pos_id[tri[1]]] = 1;
+                s.collapse_locked[s.pos_id[tri[2]]] = 1;
+            }
+
+            max_error = collapse->error > max_error ? collapse->error : max_error;
+            removed += 2;
+            applied++;
+        }
+
+        stbds_arrfree(collapses);
+        if (applied == 0)
+        {
+            break;
+        }
+
+        // remap and drop the triangles that degenerated
+        size_t n_kept = 0;
+        for (size_t t = 0; t < n_indices; t += 3)
+        {
+            uint32_t v0 = s.remap[out_indices[t + 0]];
+            uint32_t v1 = s.remap[out_indices[t + 1]];
+            uint32_t v2 = s.remap[out_indices[t + 2]];
+            uint32_t p0 = s.pos_id[v0];
+            uint32_t p1 = s.pos_id[v1];
+            uint32_t p2 = s.pos_id[v2];
+            if (p0 == p1 || p1 == p2 || p0 == p2)
+            {
+                continue;
+            }
+            out_indices[n_kept++] = v0;
+            out_indices[n_kept++] = v1;
+            out_indices[n_kept++] = v2;
+        }
+        n_indices = n_kept;
+    }
+
+    wn_simplify_free(&s);
+
+    *out_error = sqrtf(max_error) * scale;
+    return n_indices;
+}
+
+// appends n indices from src, or copies mesh->indices[first, first + n) if src is NULL (the realloc
+// would invalidate a pointer into the old list)
+static void wn_mesh_append_indices(wn_mesh_t* mesh, const uint32_t* src, size_t first, size_t n)
+{
+    uint32_t* indices = realloc(mesh->indices, sizeof(uint32_t) * (mesh->n_indices + n));
+    assert(indices);
+    mesh->indices = indices;
+
+    const uint32_t* from = src ? src : &mesh->indices[first];
+    memcpy(&mesh->indices[mesh->n_indices], from, sizeof(uint32_t) * n);
+    mesh->n_indices += n;
+}
+
+void wn_mesh_build_lods(wn_mesh_t* mesh)
+{
+    assert(!mesh->mapping && !mesh->arena && mesh->n_lods == 1);
+
+    wn_v3f_t extent = {
+        .x = mesh->bounds_max.x - mesh->bounds_min.x,
+        .y = mesh->bounds_max.y - mesh->bounds_min.y,
+        .z = mesh->bounds_max.z - mesh->bounds_min.z,
+    };
+    float radius = 0.5f * sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+    float max_error = radius * WN_MESH_LOD_MAX_ERROR;
+
+    size_t max_indices = 1;
+    for (size_t s = 0; s < mesh->n_submeshes; s++)
+    {
+        size_t n = mesh->submeshes[s].lods[0].n_indices;
+        max_indices = n > max_indices ? n : max_indices;
+    }
+    uint32_t* scratch = malloc(sizeof(uint32_t) * max_indices);
+    // submeshes that can't be simplified any further just repeat their last level
+    bool* stalled = calloc(mesh->n_submeshes, sizeof(bool));
+    assert(scratch && stalled);
+
+    while (mesh->n_lods < WN_MESH_MAX_LODS)
+    {
+        uint32_t level = mesh->n_lods;
+        size_t level_start = mesh->n_indices;
+        bool progressed = false;
+        float level_error = 0.0f;
+
+        for (size_t s = 0; s < mesh->n_submeshes; s++)
+        {
+            wn_submesh_t* submesh = &mesh->submeshes[s];
+            const wn_mesh_lod_t* source = &submesh->lods[level - 1];
+            size_t target = (size_t)((float)(source->n_indices / 3) * WN_MESH_LOD_RATIO) * 3;
+
+            // chained off the previous level, so its error adds on top
+            float error = 0.0f;
+            size_t n_indices = 0;
+            if (!stalled[s] && target >= WN_MESH_LOD_MIN_TRIANGLES * 3)
+            {
+                n_indices = wn_mesh_simplify(
+                    &mesh->indices[source->first_index],
+                    source->n_indices,
+                    &mesh->vertices[submesh->first_vertex],
+                    submesh->n_vertices,
+                    target,
+                    max_error - source->error,
+                    scratch,
+                    &error);
+            }
+
+            // stalled on locked borders or ran out of error budget
+            if (n_indices == 0 || (float)n_indices > (float)source->n_indices * 0.9f)
+            {
+                stalled[s] = true;
+                submesh->lods[level] = (wn_mesh_lod_t) {
+                    .first_index = (uint32_t)mesh->n_indices,
+                    .n_indices = source->n_indices,
+                    .error = source->error,
+                };
+                wn_mesh_append_indices(mesh, NULL, source->first_index, source->n_indices);
+            }
+            else
+            {
+                wn_mesh_optimize_vertex_cache(
+                    scratch,
+                    n_indices,
+                    submesh->n_vertices,
+                    WN_MESH_VERTEX_CACHE_SIZE,
+                    NULL);
+
+                submesh->lods[level] = (wn_mesh_lod_t) {
+                    .first_index = (uint32_t)mesh->n_indices,
+                    .n_indices = (uint32_t)n_indices,
+                    .error = source->error + error,
+                };
+                wn_mesh_append_indices(mesh, scratch, 0, n_indices);
+                progressed = true;
+            }
+
+            level_error = fmaxf(level_error, submesh->lods[level].error);
+        }
+
+        if (!progressed)
+        {
+            // NOTE: the copies stay allocated but out of range, the next realloc reuses them
+            mesh->n_indices = level_start;
+            break;
+        }
+
+        mesh->lods[level] = (wn_mesh_lod_t) {
+            .first_index = (uint32_t)level_start,
+            .n_indices = (uint32_t)(mesh->n_indices - level_start),
+            .error = level_error,
+        };
+
+        log_debug(
+            "LOD %u: %u triangles, error %f",
+            level,
+            mesh->lods[level].n_indices / 3,
+            mesh->lods[level].error);
+
+        mesh->n_lods++;
+    }
+
+    free(stalled);
+    free(scratch);
+
+    log_info(
+        "Built %u LODs (%u -> %u triangles)",
+        mesh->n_lods,
+        mesh->lods[0].n_indices / 3,
+        mesh->lods[mesh->n_lods - 1].n_indices / 3);
+}
+
+uint32_t wn_mesh_select_lod(
+    const wn_mesh_t* mesh,
+    uint32_t current,
+    float distance,
+    float proj_scale,
+    float threshold)
+{
+    if (mesh->n_lods <= 1)
+    {
+        return 0;
+    }
+
+    // pixels per object space unit at that distance
+    float scale = proj_scale / fmaxf(distance, 1e-4f);
+    uint32_t lod = current < mesh->n_lods ? current : mesh->n_lods - 1;
+
+    while (lod > 0 && mesh->lods[lod].error * scale > threshold)
+    {
+        lod--;
+    }
+    while (lod + 1 < mesh->n_lods
+           && mesh->lods[lod + 1].error * scale < threshold * WN_MESH_LOD_HYSTERESIS)
+    {
+        lod++;
+    }
+
+    return lod;
+}
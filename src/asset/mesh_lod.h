@@ -0,0 +1,56 @@
+/*
+===========================================================================
+
+whynot::asset::mesh_lod.h: quadric error simplification + LOD chain selection
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+#include "mesh.h"
+
+// every level aims for this fraction of the triangles of the previous one
+#define WN_MESH_LOD_RATIO 0.5f
+// levels below this many triangles aren't worth a draw of their own
+#define WN_MESH_LOD_MIN_TRIANGLES 64
+// simplification error budget for the whole chain, relative to the bounding radius
+#define WN_MESH_LOD_MAX_ERROR 0.1f
+// a coarser level is only picked once its error is this far below the threshold, avoids popping
+// back and forth around the switch distance
+#define WN_MESH_LOD_HYSTERESIS 0.75f
+
+/*
+ * Garland-Heckbert quadric edge collapse. Collapses only ever move a vertex onto one of its
+ * neighbours, so the result indexes the same vertex array as the input. Collapses may cross UV
+ * seams, how far that slides the texture over the surface adds to the quadric error. Mesh borders
+ * are locked. Writes at most n_indices indices to out_indices, returns the number written and the
+ * largest collapse error in object space units in out_error.
+ */
+size_t wn_mesh_simplify(
+    const uint32_t* indices,
+    size_t n_indices,
+    const wn_vertex_t* vertices,
+    size_t n_vertices,
+    size_t target_n_indices,
+    float target_error,
+    uint32_t* out_indices,
+    float* out_error);
+
+// appends up to WN_MESH_MAX_LODS - 1 simplified levels behind the index list of lod 0 and fills
+// the lods of the mesh and its submeshes, run after wn_mesh_optimize (and before
+// wn_mesh_build_meshlets). Every submesh is simplified on its own
+void wn_mesh_build_lods(wn_mesh_t* mesh);
+
+/*
+ * Picks the coarsest level whose error projects to less than threshold pixels. distance is from
+ * the eye to the closest point of the mesh bounds, proj_scale is viewport height / (2 tan(fov/2)).
+ * current is the level picked last frame, see WN_MESH_LOD_HYSTERESIS.
+ */
+uint32_t wn_mesh_select_lod(
+    const wn_mesh_t* mesh,
+    uint32_t current,
+    float distance,
+    float proj_scale,
+    float threshold);
@@ -0,0 +1,497 @@
+/*
+===========================================================================
+
+whynot::asset::mesh_opt.c: index/vertex reordering for post-transform cache + overdraw
+
+===========================================================================
+*/
+
+#include "mesh_opt.h"
+
+#include "log.h"
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct wn_mesh_cluster_key_t
+{
+    float key;
+    uint32_t cluster;
+} wn_mesh_cluster_key_t;
+
+// FIFO cache modeled with timestamps: a vertex is resident if it was inserted less than cache_size
+// insertions ago, returns the number of misses for the triangle
+static inline uint32_t wn_mesh_cache_triangle(
+    const uint32_t* tri,
+    uint32_t* cache_time,
+    uint32_t* timestamp,
+    uint32_t cache_size)
+{
+    uint32_t misses = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        uint32_t v = tri[i];
+        if (*timestamp - cache_time[v] > cache_size)
+        {
+            cache_time[v] = (*timestamp)++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+wn_mesh_cache_stats_t wn_mesh_analyze_vertex_cache(
+    const uint32_t* indices,
+    size_t n_indices,
+    size_t n_vertices,
+    uint32_t cache_size)
+{
+    wn_mesh_cache_stats_t stats = { 0 };
+    size_t n_triangles = n_indices / 3;
+    if (n_triangles == 0 || n_vertices == 0)
+    {
+        return stats;
+    }
+
+    uint32_t* cache_time = calloc(n_vertices, sizeof(uint32_t));
+    assert(cache_time);
+
+    uint32_t timestamp = cache_size + 1;
+    size_t misses = 0;
+    for (size_t i = 0; i < n_triangles; i++)
+    {
+        misses += wn_mesh_cache_triangle(&indices[i * 3], cache_time, &timestamp, cache_size);
+    }
+
+    size_t n_referenced = 0;
+    for (size_t i = 0; i < n_vertices; i++)
+    {
+        n_referenced += cache_time[i] != 0;
+    }
+
+    free(cache_time);
+
+    stats.acmr = (float)misses / (float)n_triangles;
+    stats.atvr = n_referenced ? (float)misses / (float)n_referenced : 0.0f;
+
+    return stats;
+}
+
+void wn_mesh_optimize_vertex_cache(
+    uint32_t* indices,
+    size_t n_indices,
+    size_t n_vertices,
+    uint32_t cache_size,
+    size_t** clusters)
+{
+    size_t n_triangles = n_indices / 3;
+    if (n_triangles == 0)
+    {
+        return;
+    }
+
+    // vertex -> triangle adjacency, packed
+    uint32_t* live = calloc(n_vertices, sizeof(uint32_t));
+    uint32_t* offsets = calloc(n_vertices + 1, sizeof(uint32_t));
+    uint32_t* adjacency = malloc(sizeof(uint32_t) * n_indices);
+    uint32_t* cache_time = calloc(n_vertices, sizeof(uint32_t));
+    uint32_t* dead_end = malloc(sizeof(uint32_t) * n_indices);
+    uint32_t* candidates = malloc(sizeof(uint32_t) * n_indices);
+    uint32_t* result = malloc(sizeof(uint32_t) * n_indices);
+    bool* emitted = calloc(n_triangles, sizeof(bool));
+    assert(live && offsets && adjacency && cache_time && dead_end && candidates && result && emitted);
+
+    for (size_t i = 0; i < n_indices; i++)
+    {
+        live[indices[i]]++;
+    }
+    for (size_t v = 0; v < n_vertices; v++)
+    {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    // cache_time doubles as the fill cursor here, it's cleared again below
+    for (size_t t = 0; t < n_triangles; t++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            uint32_t v = indices[t * 3 + c];
+            adjacency[offsets[v] + cache_time[v]++] = (uint32_t)t;
+        }
+    }
+    memset(cache_time, 0, sizeof(uint32_t) * n_vertices);
+
+    uint32_t timestamp = cache_size + 1;
+    size_t n_out = 0;
+    size_t n_dead_end = 0;
+    size_t input_cursor = 0;
+    int64_t fan = indices[0];
+
+    if (clusters)
+    {
+        stbds_arrput(*clusters, 0);
+    }
+
+    while (fan >= 0)
+    {
+        size_t n_candidates = 0;
+
+        // emit every live triangle around the fanning vertex
+        for (uint32_t k = offsets[fan]; k < offsets[fan + 1]; k++)
+        {
+            uint32_t t = adjacency[k];
+            if (emitted[t])
+            {
+                continue;
+            }
+
+            for (int c = 0; c < 3; c++)
+            {
+                uint32_t v = indices[t * 3 + c];
+                result[n_out++] = v;
+                dead_end[n_dead_end++] = v;
+                candidates[n_candidates++] = v;
+                live[v]--;
+                if (timestamp - cache_time[v] > cache_size)
+                {
+                    cache_time[v] = timestamp++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        // next fanning vertex: the oldest candidate that will still be in cache after its
+        // remaining triangles are emitted
+        int64_t next = -1;
+        int64_t best_priority = -1;
+        for (size_t i = 0; i < n_candidates; i++)
+        {
+            uint32_t v = candidates[i];
+            if (live[v] == 0)
+            {
+                continue;
+            }
+            int64_t priority = 0;
+            if (timestamp - cache_time[v] + 2 * live[v] <= cache_size)
+            {
+                priority = timestamp - cache_time[v];
+            }
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                next = v;
+            }
+        }
+
+        // dead end: most recently referenced vertex that still has work, then input order
+        if (next < 0)
+        {
+            while (n_dead_end > 0 && next < 0)
+            {
+                uint32_t v = dead_end[--n_dead_end];
+                next = live[v] > 0 ? (int64_t)v : -1;
+            }
+            while (input_cursor < n_indices && next < 0)
+            {
+                uint32_t v = indices[input_cursor++];
+                next = live[v] > 0 ? (int64_t)v : -1;
+            }
+            if (next >= 0 && clusters)
+            {
+                stbds_arrput(*clusters, n_out / 3);
+            }
+        }
+
+        fan = next;
+    }
+
+    assert(n_out == n_triangles * 3);
+    memcpy(indices, result, sizeof(uint32_t) * n_out);
+
+    free(live);
+    free(offsets);
+    free(adjacency);
+    free(cache_time);
+    free(dead_end);
+    free(candidates);
+    free(result);
+    free(emitted);
+}
+
+static int wn_mesh_cluster_key_compare(const void* a, const void* b)
+{
+    const wn_mesh_cluster_key_t* ka = a;
+    const wn_mesh_cluster_key_t* kb = b;
+    if (ka->key != kb->key)
+    {
+        return ka->key > kb->key ? -1 : 1;
+    }
+    return ka->cluster < kb->cluster ? -1 : (ka->cluster > kb->cluster);
+}
+
+void wn_mesh_optimize_overdraw(
+    uint32_t* indices,
+    size_t n_indices,
+    const wn_vertex_t* vertices,
+    size_t n_vertices,
+    const size_t* clusters,
+    size_t n_clusters,
+    uint32_t cache_size,
+    float threshold)
+{
+    size_t n_triangles = n_indices / 3;
+    if (n_triangles == 0 || n_clusters == 0)
+    {
+        return;
+    }
+
+    uint32_t* cache_time = calloc(n_vertices, sizeof(uint32_t));
+    assert(cache_time);
+    uint32_t timestamp = cache_size + 1;
+
+    // soft boundaries: cut a cluster as soon as its running ACMR gets close enough to the ACMR of
+    // the hard cluster it's part of, smaller clusters sort better
+    size_t* soft = NULL;
+    for (size_t h = 0; h < n_clusters; h++)
+    {
+        size_t start = clusters[h];
+        size_t end = h + 1 < n_clusters ? clusters[h + 1] : n_triangles;
+        if (start >= end)
+        {
+            continue;
+        }
+
+        size_t cluster_misses = 0;
+        timestamp += cache_size + 1;
+        for (size_t t = start; t < end; t++)
+        {
+            cluster_misses
+                += wn_mesh_cache_triangle(&indices[t * 3], cache_time, &timestamp, cache_size);
+        }
+        float cluster_threshold = threshold * (float)cluster_misses / (float)(end - start);
+
+        stbds_arrput(soft, start);
+        timestamp += cache_size + 1;
+        size_t running_misses = 0;
+        size_t running_triangles = 0;
+        for (size_t t = start; t < end; t++)
+        {
+            running_misses
+                += wn_mesh_cache_triangle(&indices[t * 3], cache_time, &timestamp, cache_size);
+            running_triangles++;
+            if (t + 1 < end
+                && (float)running_misses / (float)running_triangles <= cluster_threshold)
+            {
+                stbds_arrput(soft, t + 1);
+                timestamp += cache_size + 1;
+                running_misses = 0;
+                running_triangles = 0;
+            }
+        }
+    }
+    free(cache_time);
+
+    size_t n_soft = stbds_arrlen(soft);
+
+    wn_v3f_t mesh_centroid = { 0 };
+    for (size_t i = 0; i < n_indices; i++)
+    {
+        const wn_v3f_t* p = &vertices[indices[i]].pos;
+        mesh_centroid.x += p->x;
+        mesh_centroid.y += p->y;
+        mesh_centroid.z += p->z;
+    }
+    mesh_centroid.x /= (float)n_indices;
+    mesh_centroid.y /= (float)n_indices;
+    mesh_centroid.z /= (float)n_indices;
+
+    // sort key: how far the cluster sits out along its own normal, those are likely occluders
+    wn_mesh_cluster_key_t* keys = malloc(sizeof(wn_mesh_cluster_key_t) * n_soft);
+    assert(keys);
+    for (size_t c = 0; c < n_soft; c++)
+    {
+        size_t start = soft[c];
+        size_t end = c + 1 < n_soft ? soft[c + 1] : n_triangles;
+
+        wn_v3f_t centroid = { 0 };
+        wn_v3f_t normal = { 0 };
+        float area = 0.0f;
+
+        for (size_t t = start; t < end; t++)
+        {
+            const wn_v3f_t* p0 = &vertices[indices[t * 3 + 0]].pos;
+            const wn_v3f_t* p1 = &vertices[indices[t * 3 + 1]].pos;
+            const wn_v3f_t* p2 = &vertices[indices[t * 3 + 2]].pos;
+
+            wn_v3f_t e1 = { .x = p1->x - p0->x, .y = p1->y - p0->y, .z = p1->z - p0->z };
+            wn_v3f_t e2 = { .x = p2->x - p0->x, .y = p2->y - p0->y, .z = p2->z - p0->z };
+            wn_v3f_t n = {
+                .x = e1.y * e2.z - e1.z * e2.y,
+                .y = e1.z * e2.x - e1.x * e2.z,
+                .z = e1.x * e2.y - e1.y * e2.x,
+            };
+            float a = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+            centroid.x += (p0->x + p1->x + p2->x) * a;
+            centroid.y += (p0->y + p1->y + p2->y) * a;
+            centroid.z += (p0->z + p1->z + p2->z) * a;
+            normal.x += n.x;
+            normal.y += n.y;
+            normal.z += n.z;
+            area += a;
+        }
+
+        float inv_area = area > 0.0f ? 1.0f / (3.0f * area) : 0.0f;
+        centroid.x = centroid.x * inv_area - mesh_centroid.x;
+        centroid.y = centroid.y * inv_area - mesh_centroid.y;
+        centroid.z = centroid.z * inv_area - mesh_centroid.z;
+
+        float normal_len = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        float inv_normal = normal_len > 0.0f ? 1.0f / normal_len : 0.0f;
+
+        keys[c] = (wn_mesh_cluster_key_t) {
+            .key = (centroid.x * normal.x + centroid.y * normal.y + centroid.z * normal.z)
+                * inv_normal,
+            .cluster = (uint32_t)c,
+        };
+    }
+
+    qsort(keys, n_soft, sizeof(wn_mesh_cluster_key_t), wn_mesh_cluster_key_compare);
+
+    uint32_t* result = malloc(sizeof(uint32_t) * n_triangles * 3);
+    assert(result);
+    size_t n_out = 0;
+    for (size_t i = 0; i < n_soft; i++)
+    {
+        size_t c = keys[i].cluster;
+        size_t start = soft[c];
+        size_t end = c + 1 < n_soft ? soft[c + 1] : n_triangles;
+        memcpy(&result[n_out], &indices[start * 3], sizeof(uint32_t) * (end - start) * 3);
+        n_out += (end - start) * 3;
+    }
+    assert(n_out == n_triangles * 3);
+    memcpy(indices, result, sizeof(uint32_t) * n_out);
+
+    free(result);
+    free(keys);
+    stbds_arrfree(soft);
+}
+
+void wn_mesh_optimize_vertex_fetch(wn_mesh_t* mesh)
+{
+    // NOTE: arena ranges are sized for the vertex count at the time the mesh was added
+    assert(mesh->n_lods == 1 && !mesh->arena);
+
+    if (mesh->n_vertices == 0)
+    {
+        return;
+    }
+
+    uint32_t* remap = malloc(sizeof(uint32_t) * mesh->n_vertices);
+    wn_vertex_t* vertices = malloc(sizeof(wn_vertex_t) * mesh->n_vertices);
+    assert(remap && vertices);
+
+    // submeshes are compacted towards the front one after another, a submesh never shrinks past
+    // the start of the next one so the copy back can't clobber unread vertices
+    uint32_t n_total = 0;
+    for (size_t s = 0; s < mesh->n_submeshes; s++)
+    {
+        wn_submesh_t* submesh = &mesh->submeshes[s];
+        const wn_vertex_t* src = &mesh->vertices[submesh->first_vertex];
+        uint32_t* indices = &mesh->indices[submesh->lods[0].first_index];
+        memset(remap, 0xff, sizeof(uint32_t) * submesh->n_vertices);
+
+        uint32_t n_used = 0;
+        for (size_t i = 0; i < submesh->lods[0].n_indices; i++)
+        {
+            uint32_t v = indices[i];
+            if (remap[v] == UINT32_MAX)
+            {
+                remap[v] = n_used;
+                vertices[n_used++] = src[v];
+            }
+            indices[i] = remap[v];
+        }
+
+        // NOTE: copied back in place rather than swapped so this also works on mapped meshes
+        memcpy(&mesh->vertices[n_total], vertices, sizeof(wn_vertex_t) * n_used);
+        submesh->first_vertex = n_total;
+        submesh->n_vertices = n_used;
+        n_total += n_used;
+    }
+    mesh->n_vertices = n_total;
+
+    free(vertices);
+    free(remap);
+}
+
+// lod 0 stats of all submeshes together, as if each was drawn on its own
+static wn_mesh_cache_stats_t wn_mesh_analyze_submeshes(const wn_mesh_t* mesh)
+{
+    float n_misses = 0.0f;
+    float n_triangles = 0.0f;
+    float n_referenced = 0.0f;
+    for (size_t s = 0; s < mesh->n_submeshes; s++)
+    {
+        const wn_submesh_t* submesh = &mesh->submeshes[s];
+        wn_mesh_cache_stats_t stats = wn_mesh_analyze_vertex_cache(
+            &mesh->indices[submesh->lods[0].first_index],
+            submesh->lods[0].n_indices,
+            submesh->n_vertices,
+            WN_MESH_VERTEX_CACHE_SIZE);
+
+        float misses = stats.acmr * (float)(submesh->lods[0].n_indices / 3);
+        n_misses += misses;
+        n_triangles += (float)(submesh->lods[0].n_indices / 3);
+        n_referenced += stats.atvr > 0.0f ? misses / stats.atvr : 0.0f;
+    }
+
+    return (wn_mesh_cache_stats_t) {
+        .acmr = n_triangles > 0.0f ? n_misses / n_triangles : 0.0f,
+        .atvr = n_referenced > 0.0f ? n_misses / n_referenced : 0.0f,
+    };
+}
+
+void wn_mesh_optimize(wn_mesh_t* mesh)
+{
+    wn_mesh_cache_stats_t before = wn_mesh_analyze_submeshes(mesh);
+
+    for (size_t s = 0; s < mesh->n_submeshes; s++)
+    {
+        const wn_submesh_t* submesh = &mesh->submeshes[s];
+        uint32_t* indices = &mesh->indices[submesh->lods[0].first_index];
+
+        size_t* clusters = NULL;
+        wn_mesh_optimize_vertex_cache(
+            indices,
+            submesh->lods[0].n_indices,
+            submesh->n_vertices,
+            WN_MESH_VERTEX_CACHE_SIZE,
+            &clusters);
+        wn_mesh_optimize_overdraw(
+            indices,
+            submesh->lods[0].n_indices,
+            &mesh->vertices[submesh->first_vertex],
+            submesh->n_vertices,
+            clusters,
+            stbds_arrlen(clusters),
+            WN_MESH_VERTEX_CACHE_SIZE,
+            WN_MESH_OVERDRAW_THRESHOLD);
+        stbds_arrfree(clusters);
+    }
+
+    wn_mesh_optimize_vertex_fetch(mesh);
+
+    wn_mesh_cache_stats_t after = wn_mesh_analyze_submeshes(mesh);
+
+    log_info(
+        "Vertex cache (%d entries): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+        WN_MESH_VERTEX_CACHE_SIZE,
+        before.acmr,
+        after.acmr,
+        before.atvr,
+        after.atvr);
+}
@@ -0,0 +1,60 @@
+/*
+===========================================================================
+
+whynot::asset::mesh_opt.h: index/vertex reordering for post-transform cache + overdraw
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+#include "mesh.h"
+
+// FIFO size the passes optimize for, small enough that the result holds up on most hw
+#define WN_MESH_VERTEX_CACHE_SIZE 16
+// clusters whose own ACMR is within this factor of the whole mesh get split further for overdraw
+#define WN_MESH_OVERDRAW_THRESHOLD 1.05f
+
+typedef struct wn_mesh_cache_stats_t
+{
+    float acmr; // transformed vertices per triangle, 0.5 is ideal, 3.0 is no reuse
+    float atvr; // transformed vertices per referenced vertex, 1.0 is ideal
+} wn_mesh_cache_stats_t;
+
+// simulates a FIFO post-transform cache of cache_size entries over the index list
+wn_mesh_cache_stats_t wn_mesh_analyze_vertex_cache(
+    const uint32_t* indices,
+    size_t n_indices,
+    size_t n_vertices,
+    uint32_t cache_size);
+
+/*
+ * Tipsify (Sander et al. 2007, "Fast Triangle Reordering for Vertex Locality and Reduced
+ * Overdraw"), reorders triangles in place. If clusters is non-NULL it receives a stbds array of
+ * triangle offsets where the cache had to be restarted (always starts with 0).
+ */
+void wn_mesh_optimize_vertex_cache(
+    uint32_t* indices,
+    size_t n_indices,
+    size_t n_vertices,
+    uint32_t cache_size,
+    size_t** clusters);
+
+// splits clusters further where it doesn't hurt the cache much and sorts them so outward facing
+// ones are drawn first, same paper as above
+void wn_mesh_optimize_overdraw(
+    uint32_t* indices,
+    size_t n_indices,
+    const wn_vertex_t* vertices,
+    size_t n_vertices,
+    const size_t* clusters,
+    size_t n_clusters,
+    uint32_t cache_size,
+    float threshold);
+
+// reorders vertices by first use in the index list and drops unreferenced ones
+void wn_mesh_optimize_vertex_fetch(wn_mesh_t* mesh);
+
+// runs all of the above in order and logs the cache stats before and after
+void wn_mesh_optimize(wn_mesh_t* mesh);
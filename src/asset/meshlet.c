@@ -0,0 +1,280 @@
+/*
+===========================================================================
+
+whynot::asset::meshlet.c: meshlet decomposition + per cluster culling data
+
+===========================================================================
+*/
+
+#include "meshlet.h"
+
+#include "log.h"
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct wn_meshlet_builder_t
+{
+    wn_meshlet_t* meshlets;
+    uint32_t* vertices;
+    uint32_t* triangles;
+
+    // submesh being split, meshlet vertices index its range
+    uint32_t submesh;
+    const wn_vertex_t* submesh_vertices;
+
+    // submesh vertex -> local index of the meshlet being built, 0xff if not in it
+    uint8_t* local;
+} wn_meshlet_builder_t;
+
+static inline wn_v3f_t wn_meshlet_sub(wn_v3f_t a, wn_v3f_t b)
+{
+    return (wn_v3f_t) { .x = a.x - b.x, .y = a.y - b.y, .z = a.z - b.z };
+}
+
+static inline float wn_meshlet_dot(wn_v3f_t a, wn_v3f_t b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static void wn_meshlet_compute_bounds(wn_meshlet_builder_t* builder)
+{
+    wn_meshlet_t* meshlet = &builder->meshlets[stbds_arrlen(builder->meshlets) - 1];
+    const uint32_t* vertices = &builder->vertices[meshlet->vertex_offset];
+    const uint32_t* triangles = &builder->triangles[meshlet->triangle_offset];
+    const wn_vertex_t* submesh_vertices = builder->submesh_vertices;
+
+    // bounding sphere around the box center, not minimal but cheap and stable
+    wn_v3f_t min = submesh_vertices[vertices[0]].pos;
+    wn_v3f_t max = min;
+    for (uint32_t i = 1; i < meshlet->n_vertices; i++)
+    {
+        wn_v3f_t p = submesh_vertices[vertices[i]].pos;
+        for (int j = 0; j < 3; j++)
+        {
+            min.v3f[j] = p.v3f[j] < min.v3f[j] ? p.v3f[j] : min.v3f[j];
+            max.v3f[j] = p.v3f[j] > max.v3f[j] ? p.v3f[j] : max.v3f[j];
+        }
+    }
+    wn_v3f_t center = {
+        .x = (min.x + max.x) * 0.5f,
+        .y = (min.y + max.y) * 0.5f,
+        .z = (min.z + max.z) * 0.5f,
+    };
+    float radius_sq = 0.0f;
+    for (uint32_t i = 0; i < meshlet->n_vertices; i++)
+    {
+        wn_v3f_t d = wn_meshlet_sub(submesh_vertices[vertices[i]].pos, center);
+        float dist_sq = wn_meshlet_dot(d, d);
+        radius_sq = dist_sq > radius_sq ? dist_sq : radius_sq;
+    }
+
+    // normal cone, counter clockwise triangles face out
+    wn_v3f_t normals[WN_MESHLET_MAX_TRIANGLES];
+    wn_v3f_t corners[WN_MESHLET_MAX_TRIANGLES];
+    uint32_t n_normals = 0;
+    wn_v3f_t axis = { 0 };
+    for (uint32_t i = 0; i < meshlet->n_triangles; i++)
+    {
+        uint32_t packed = triangles[i];
+        wn_v3f_t p0 = submesh_vertices[vertices[packed & 0xff]].pos;
+        wn_v3f_t p1 = submesh_vertices[vertices[(packed >> 8) & 0xff]].pos;
+        wn_v3f_t p2 = submesh_vertices[vertices[(packed >> 16) & 0xff]].pos;
+
+        wn_v3f_t e1 = wn_meshlet_sub(p1, p0);
+        wn_v3f_t e2 = wn_meshlet_sub(p2, p0);
+        wn_v3f_t n = {
+            .x = e1.y * e2.z - e1.z * e2.y,
+            .y = e1.z * e2.x - e1.x * e2.z,
+            .z = e1.x * e2.y - e1.y * e2.x,
+        };
+        float len = sqrtf(wn_meshlet_dot(n, n));
+        if (len <= 0.0f)
+        {
+            continue;
+        }
+        n.x /= len;
+        n.y /= len;
+        n.z /= len;
+
+        normals[n_normals] = n;
+        corners[n_normals] = p0;
+        n_normals++;
+
+        axis.x += n.x;
+        axis.y += n.y;
+        axis.z += n.z;
+    }
+
+    meshlet->sphere = (wn_v4f_t) { center.x, center.y, center.z, sqrtf(radius_sq) };
+    meshlet->cone_axis = (wn_v4f_t) { 0.0f, 0.0f, 0.0f, WN_MESHLET_CONE_DISABLED };
+    meshlet->cone_apex = (wn_v4f_t) { center.x, center.y, center.z, 0.0f };
+
+    float axis_len = sqrtf(wn_meshlet_dot(axis, axis));
+    if (n_normals == 0 || axis_len <= 0.0f)
+    {
+        return;
+    }
+    axis.x /= axis_len;
+    axis.y /= axis_len;
+    axis.z /= axis_len;
+
+    float min_dp = 1.0f;
+    for (uint32_t i = 0; i < n_normals; i++)
+    {
+        float dp = wn_meshlet_dot(normals[i], axis);
+        min_dp = dp < min_dp ? dp : min_dp;
+    }
+
+    // NOTE: past ~84 degrees of spread the cone test basically never passes, don't bother
+    if (min_dp <= 0.1f)
+    {
+        return;
+    }
+
+    // pull the apex back along the axis until every triangle plane is in front of it
+    float max_t = 0.0f;
+    for (uint32_t i = 0; i < n_normals; i++)
+    {
+        float t = wn_meshlet_dot(wn_meshlet_sub(center, corners[i]), normals[i])
+            / wn_meshlet_dot(axis, normals[i]);
+        max_t = t > max_t ? t : max_t;
+    }
+
+    meshlet->cone_axis = (wn_v4f_t) { axis.x, axis.y, axis.z, sqrtf(1.0f - min_dp * min_dp) };
+    meshlet->cone_apex = (wn_v4f_t) {
+        center.x - axis.x * max_t,
+        center.y - axis.y * max_t,
+        center.z - axis.z * max_t,
+        0.0f,
+    };
+}
+
+static void wn_meshlet_flush(wn_meshlet_builder_t* builder)
+{
+    wn_meshlet_t* meshlet = &builder->meshlets[stbds_arrlen(builder->meshlets) - 1];
+    if (meshlet->n_triangles == 0)
+    {
+        return;
+    }
+
+    meshlet->submesh = builder->submesh;
+    wn_meshlet_compute_bounds(builder);
+
+    for (uint32_t i = 0; i < meshlet->n_vertices; i++)
+    {
+        builder->local[builder->vertices[meshlet->vertex_offset + i]] = 0xff;
+    }
+
+    wn_meshlet_t next = {
+        .vertex_offset = (uint32_t)stbds_arrlen(builder->vertices),
+        .triangle_offset = (uint32_t)stbds_arrlen(builder->triangles),
+    };
+    stbds_arrput(builder->meshlets, next);
+}
+
+void wn_mesh_build_meshlets(wn_mesh_t* mesh)
+{
+    assert(!mesh->mapping && !mesh->arena);
+
+    uint32_t max_vertices = wn_mesh_max_submesh_vertices(mesh);
+    wn_meshlet_builder_t builder = { 0 };
+    builder.local = malloc(max_vertices ? max_vertices : 1);
+    assert(builder.local);
+    memset(builder.local, 0xff, max_vertices);
+
+    stbds_arrput(builder.meshlets, (wn_meshlet_t) { 0 });
+
+    // every lod gets its own run of meshlets so culling can pick one range
+    for (uint32_t lod = 0; lod < mesh->n_lods; lod++)
+    {
+        mesh->lods[lod].first_meshlet = (uint32_t)stbds_arrlen(builder.meshlets) - 1;
+
+        for (size_t s = 0; s < mesh->n_submeshes; s++)
+        {
+            wn_mesh_lod_t* submesh_lod = &mesh->submeshes[s].lods[lod];
+            submesh_lod->first_meshlet = (uint32_t)stbds_arrlen(builder.meshlets) - 1;
+            builder.submesh = (uint32_t)s;
+            builder.submesh_vertices = &mesh->vertices[mesh->submeshes[s].first_vertex];
+
+            // greedy scan in index order, the cache optimized order is already spatially coherent
+            const uint32_t* indices = &mesh->indices[submesh_lod->first_index];
+            for (size_t t = 0; t + 2 < submesh_lod->n_indices; t += 3)
+            {
+                const uint32_t* tri = &indices[t];
+                wn_meshlet_t* meshlet = &builder.meshlets[stbds_arrlen(builder.meshlets) - 1];
+
+                uint32_t n_new = (builder.local[tri[0]] == 0xff)
+                    + (builder.local[tri[1]] == 0xff && tri[1] != tri[0])
+                    + (builder.local[tri[2]] == 0xff && tri[2] != tri[0] && tri[2] != tri[1]);
+
+                if (meshlet->n_vertices + n_new > WN_MESHLET_MAX_VERTICES
+                    || meshlet->n_triangles + 1 > WN_MESHLET_MAX_TRIANGLES)
+                {
+                    wn_meshlet_flush(&builder);
+                    meshlet = &builder.meshlets[stbds_arrlen(builder.meshlets) - 1];
+                }
+
+                uint32_t packed = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    uint32_t v = tri[c];
+                    if (builder.local[v] == 0xff)
+                    {
+                        builder.local[v] = (uint8_t)meshlet->n_vertices++;
+                        stbds_arrput(builder.vertices, v);
+                    }
+                    packed |= (uint32_t)builder.local[v] << (c * 8);
+                }
+                stbds_arrput(builder.triangles, packed);
+                meshlet->n_triangles++;
+            }
+
+            // meshlets never span submeshes
+            wn_meshlet_flush(&builder);
+            submesh_lod->n_meshlets
+                = (uint32_t)stbds_arrlen(builder.meshlets) - 1 - submesh_lod->first_meshlet;
+        }
+
+        mesh->lods[lod].n_meshlets
+            = (uint32_t)stbds_arrlen(builder.meshlets) - 1 - mesh->lods[lod].first_meshlet;
+    }
+
+    // flush always leaves an empty meshlet behind to fill next
+    stbds_arrsetlen(builder.meshlets, stbds_arrlen(builder.meshlets) - 1);
+
+    free(builder.local);
+
+    // hand off as plain allocations so wn_mesh_destroy can free() them
+    mesh->n_meshlets = stbds_arrlen(builder.meshlets);
+    mesh->n_meshlet_vertices = stbds_arrlen(builder.vertices);
+    mesh->n_meshlet_triangles = stbds_arrlen(builder.triangles);
+
+    mesh->meshlets = malloc(sizeof(wn_meshlet_t) * (mesh->n_meshlets ? mesh->n_meshlets : 1));
+    mesh->meshlet_vertices
+        = malloc(sizeof(uint32_t) * (mesh->n_meshlet_vertices ? mesh->n_meshlet_vertices : 1));
+    mesh->meshlet_triangles
+        = malloc(sizeof(uint32_t) * (mesh->n_meshlet_triangles ? mesh->n_meshlet_triangles : 1));
+    assert(mesh->meshlets && mesh->meshlet_vertices && mesh->meshlet_triangles);
+
+    memcpy(mesh->meshlets, builder.meshlets, sizeof(wn_meshlet_t) * mesh->n_meshlets);
+    memcpy(mesh->meshlet_vertices, builder.vertices, sizeof(uint32_t) * mesh->n_meshlet_vertices);
+    memcpy(
+        mesh->meshlet_triangles,
+        builder.triangles,
+        sizeof(uint32_t) * mesh->n_meshlet_triangles);
+
+    stbds_arrfree(builder.meshlets);
+    stbds_arrfree(builder.vertices);
+    stbds_arrfree(builder.triangles);
+
+    log_info(
+        "Built %zu meshlets (%.1f vertices, %.1f triangles avg)",
+        mesh->n_meshlets,
+        mesh->n_meshlets ? (float)mesh->n_meshlet_vertices / (float)mesh->n_meshlets : 0.0f,
+        mesh->n_meshlets ? (float)mesh->n_meshlet_triangles / (float)mesh->n_meshlets : 0.0f);
+}
@@ -0,0 +1,37 @@
+/*
+===========================================================================
+
+whynot::asset::meshlet.h: meshlet decomposition + per cluster culling data
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+#include "mesh.h"
+
+#define WN_MESHLET_MAX_VERTICES 64
+#define WN_MESHLET_MAX_TRIANGLES 124
+// cone_cutoff value for clusters whose normals are spread too far to ever be backface culled
+#define WN_MESHLET_CONE_DISABLED 2.0f
+
+// NOTE: layout matches meshlet_t in assets/shaders/meshlet_cull.comp (std430)
+typedef struct wn_meshlet_t
+{
+    uint32_t vertex_offset;   // into wn_mesh_t::meshlet_vertices
+    uint32_t triangle_offset; // into wn_mesh_t::meshlet_triangles
+    uint16_t n_vertices;
+    uint16_t n_triangles;
+    uint32_t submesh; // meshlet_vertices are relative to its first_vertex, bounds are in its space
+
+    wn_v4f_t sphere;    // xyz center, w radius
+    wn_v4f_t cone_axis; // xyz average normal, w cutoff (sin of the cone spread)
+    wn_v4f_t cone_apex; // xyz apex, w unused
+} wn_meshlet_t;
+
+// splits each lod of the (already cache optimized) index list into meshlets of at most
+// WN_MESHLET_MAX_VERTICES/WN_MESHLET_MAX_TRIANGLES and fills the meshlet arrays of the mesh plus
+// the meshlet range of every lod, triangles are packed as 3x8 bit local indices per uint32_t.
+// Meshlets never span submeshes and are stored level major like the indices
+void wn_mesh_build_meshlets(wn_mesh_t* mesh);
@@ -0,0 +1,385 @@
+/*
+===========================================================================
+
+whynot::asset::obj.c: native wavefront obj reader
+
+===========================================================================
+*/
+
+#include "obj.h"
+
+#include "log.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+typedef struct wn_obj_counts_t
+{
+    size_t n_positions;
+    size_t n_tex_coords;
+    size_t n_corners;
+} wn_obj_counts_t;
+
+static const double wn_obj_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static inline bool wn_obj_is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool wn_obj_is_digit(char c)
+{
+    return (unsigned)(c - '0') < 10;
+}
+
+// NOTE: lines are the only thing that needs scanning over long runs, so that's where the vector
+// compare goes, the per-token work is short enough that scalar code wins
+static const char* wn_obj_find_eol(const char* p, const char* end)
+{
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        if (mask)
+        {
+            return p + __builtin_ctz((unsigned)mask);
+        }
+        p += 16;
+    }
+#endif
+    const char* eol = memchr(p, '\n', (size_t)(end - p));
+    return eol ? eol : end;
+}
+
+static inline const char* wn_obj_skip_space(const char* p, const char* end)
+{
+    while (p < end && wn_obj_is_space(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+static inline const char* wn_obj_skip_token(const char* p, const char* end)
+{
+    while (p < end && !wn_obj_is_space(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+// a '#' starts a comment anywhere on a line, exporters put them after face indices too
+static inline const char* wn_obj_strip_comment(const char* p, const char* eol)
+{
+    const char* hash = memchr(p, '#', (size_t)(eol - p));
+    return hash ? hash : eol;
+}
+
+// decimal float without going through strtof + locale, accurate to float precision for anything an
+// exporter writes (<= 19 significant digits)
+static float wn_obj_parse_float(const char** cursor, const char* end)
+{
+    const char* p = wn_obj_skip_space(*cursor, end);
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int n_digits = 0;
+    int exponent = 0;
+
+    for (; p < end && wn_obj_is_digit(*p); p++)
+    {
+        if (n_digits < 19)
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            n_digits += mantissa != 0;
+        }
+        else
+        {
+            exponent++;
+        }
+    }
+
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && wn_obj_is_digit(*p); p++)
+        {
+            if (n_digits < 19)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                n_digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negative_exp = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative_exp = *p == '-';
+            p++;
+        }
+        int e = 0;
+        for (; p < end && wn_obj_is_digit(*p); p++)
+        {
+            e = e < 10000 ? e * 10 + (*p - '0') : e;
+        }
+        exponent += negative_exp ? -e : e;
+    }
+
+    double value = (double)mantissa;
+    if (exponent < 0 && exponent >= -22)
+    {
+        value /= wn_obj_pow10[-exponent];
+    }
+    else if (exponent > 0 && exponent <= 22)
+    {
+        value *= wn_obj_pow10[exponent];
+    }
+    else if (exponent != 0)
+    {
+        value *= pow(10.0, exponent);
+    }
+
+    *cursor = p;
+    return (float)(negative ? -value : value);
+}
+
+// resolves a 1-based (or negative, relative) obj index into a 0-based one, -1 if out of range
+static int64_t wn_obj_parse_index(const char** cursor, const char* end, size_t n_defined)
+{
+    const char* p = *cursor;
+
+    bool negative = false;
+    if (p < end && *p == '-')
+    {
+        negative = true;
+        p++;
+    }
+
+    int64_t value = 0;
+    for (; p < end && wn_obj_is_digit(*p); p++)
+    {
+        value = value * 10 + (*p - '0');
+    }
+
+    *cursor = p;
+
+    int64_t idx = negative ? (int64_t)n_defined - value : value - 1;
+    if (value == 0 || idx < 0 || idx >= (int64_t)n_defined)
+    {
+        return -1;
+    }
+    return idx;
+}
+
+static wn_obj_counts_t wn_obj_count(const char* data, const char* end)
+{
+    wn_obj_counts_t counts = { 0 };
+
+    for (const char* line = data; line < end;)
+    {
+        const char* eol = wn_obj_find_eol(line, end);
+        const char* p = wn_obj_skip_space(line, eol);
+
+        if (eol - p >= 2 && p[0] == 'v' && wn_obj_is_space(p[1]))
+        {
+            counts.n_positions++;
+        }
+        else if (eol - p >= 3 && p[0] == 'v' && p[1] == 't' && wn_obj_is_space(p[2]))
+        {
+            counts.n_tex_coords++;
+        }
+        else if (eol - p >= 2 && p[0] == 'f' && wn_obj_is_space(p[1]))
+        {
+            const char* face_end = wn_obj_strip_comment(p, eol);
+            size_t n_face_vertices = 0;
+            for (p = wn_obj_skip_space(p + 1, face_end); p < face_end;
+                 p = wn_obj_skip_space(p, face_end))
+            {
+                p = wn_obj_skip_token(p, face_end);
+                n_face_vertices++;
+            }
+            if (n_face_vertices >= 3)
+            {
+                counts.n_corners += (n_face_vertices - 2) * 3;
+            }
+        }
+
+        line = eol + 1;
+    }
+
+    return counts;
+}
+
+wn_result wn_obj_load(const char* filename, wn_mesh_t* mesh)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        log_error("Could not open obj file: %s", filename);
+        return WN_ERR;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        log_error("Could not stat obj file or file is empty: %s", filename);
+        close(fd);
+        return WN_ERR;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        log_error("Could not map obj file: %s", filename);
+        return WN_ERR;
+    }
+    madvise((void*)data, size, MADV_SEQUENTIAL);
+
+    const char* end = data + size;
+
+    // first pass only counts, so nothing below has to grow
+    wn_obj_counts_t counts = wn_obj_count(data, end);
+
+    wn_v3f_t* positions = malloc(sizeof(wn_v3f_t) * (counts.n_positions ? counts.n_positions : 1));
+    assert(positions);
+    wn_v2f_t* tex_coords = malloc(sizeof(wn_v2f_t) * (counts.n_tex_coords ? counts.n_tex_coords : 1));
+    assert(tex_coords);
+
+    wn_mesh_t dst_mesh = wn_mesh_new(counts.n_corners, counts.n_corners);
+
+    size_t n_positions = 0;
+    size_t n_tex_coords = 0;
+    size_t n_corners = 0;
+    wn_result result = WN_OK;
+
+    for (const char* line = data; line < end && result == WN_OK;)
+    {
+        const char* eol = wn_obj_find_eol(line, end);
+        const char* p = wn_obj_skip_space(line, eol);
+
+        if (eol - p >= 2 && p[0] == 'v' && wn_obj_is_space(p[1]))
+        {
+            p++;
+            wn_v3f_t* pos = &positions[n_positions++];
+            pos->x = wn_obj_parse_float(&p, eol);
+            pos->y = wn_obj_parse_float(&p, eol);
+            pos->z = wn_obj_parse_float(&p, eol);
+        }
+        else if (eol - p >= 3 && p[0] == 'v' && p[1] == 't' && wn_obj_is_space(p[2]))
+        {
+            p += 2;
+            wn_v2f_t* uv = &tex_coords[n_tex_coords++];
+            uv->u = wn_obj_parse_float(&p, eol);
+            uv->v = wn_obj_parse_float(&p, eol);
+        }
+        else if (eol - p >= 2 && p[0] == 'f' && wn_obj_is_space(p[1]))
+        {
+            const char* face_end = wn_obj_strip_comment(p, eol);
+            wn_vertex_t first = { 0 };
+            wn_vertex_t prev = { 0 };
+            size_t n_face_vertices = 0;
+
+            for (p = wn_obj_skip_space(p + 1, face_end); p < face_end;
+                 p = wn_obj_skip_space(p, face_end))
+            {
+                wn_vertex_t vertex = { 0 };
+
+                int64_t pos_idx = wn_obj_parse_index(&p, face_end, n_positions);
+                if (pos_idx < 0)
+                {
+                    result = WN_ERR;
+                    break;
+                }
+                vertex.pos = positions[pos_idx];
+
+                if (p < face_end && *p == '/')
+                {
+                    p++;
+                    if (p < face_end && *p != '/')
+                    {
+                        int64_t uv_idx = wn_obj_parse_index(&p, face_end, n_tex_coords);
+                        if (uv_idx < 0)
+                        {
+                            result = WN_ERR;
+                            break;
+                        }
+                        vertex.tex_coord0 = tex_coords[uv_idx];
+                    }
+                }
+                // normal index (if any) is not needed
+                p = wn_obj_skip_token(p, face_end);
+
+                if (n_face_vertices == 0)
+                {
+                    first = vertex;
+                }
+                else if (n_face_vertices >= 2)
+                {
+                    dst_mesh.vertices[n_corners++] = first;
+                    dst_mesh.vertices[n_corners++] = prev;
+                    dst_mesh.vertices[n_corners++] = vertex;
+                }
+                prev = vertex;
+                n_face_vertices++;
+            }
+        }
+
+        line = eol + 1;
+    }
+
+    munmap((void*)data, size);
+    free(positions);
+    free(tex_coords);
+
+    if (result != WN_OK)
+    {
+        log_error("Bad face index in obj file: %s", filename);
+        wn_mesh_destroy(&dst_mesh);
+        return WN_ERR;
+    }
+
+    assert(n_corners == counts.n_corners);
+
+    wn_mesh_weld(&dst_mesh);
+    wn_mesh_compute_bounds(&dst_mesh);
+
+    log_info(
+        "Loaded obj %s: %zu positions, %zu uvs, %zu indices, %zu welded vertices",
+        filename,
+        counts.n_positions,
+        counts.n_tex_coords,
+        dst_mesh.n_indices,
+        dst_mesh.n_vertices);
+
+    *mesh = dst_mesh;
+
+    return WN_OK;
+}
@@ -0,0 +1,16 @@
+/*
+===========================================================================
+
+whynot::asset::obj.h: native wavefront obj reader
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+#include "mesh.h"
+
+// maps the file and parses it straight into a welded, triangulated mesh, polygons are fanned and
+// only positions + the first uv set are read (normals, groups and materials are skipped)
+wn_result wn_obj_load(const char* filename, wn_mesh_t* mesh);
@@ -0,0 +1,369 @@
+/*
+===========================================================================
+
+whynot::asset::texture_file.c: baked block compressed textures (.ktx2)
+
+===========================================================================
+*/
+
+#include "texture_file.h"
+
+#include "image.h"
+#include "log.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint8_t wn_ktx2_identifier[12] = {
+    0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n',
+};
+
+typedef struct wn_ktx2_header_t
+{
+    uint8_t identifier[12];
+    uint32_t vk_format;
+    uint32_t type_size;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t layer_count;
+    uint32_t face_count;
+    uint32_t level_count;
+    uint32_t supercompression_scheme;
+
+    uint32_t dfd_offset;
+    uint32_t dfd_size;
+    uint32_t kvd_offset;
+    uint32_t kvd_size;
+    uint64_t sgd_offset;
+    uint64_t sgd_size;
+} wn_ktx2_header_t;
+
+typedef struct wn_ktx2_level_t
+{
+    uint64_t offset;
+    uint64_t size;
+    uint64_t uncompressed_size;
+} wn_ktx2_level_t;
+
+// khronos data format descriptor values, only what the BC formats need
+enum
+{
+    WN_DF_MODEL_BC1A = 128,
+    WN_DF_MODEL_BC3 = 130,
+    WN_DF_MODEL_BC5 = 132,
+    WN_DF_MODEL_BC7 = 134,
+    WN_DF_PRIMARIES_BT709 = 1,
+    WN_DF_TRANSFER_LINEAR = 1,
+    WN_DF_TRANSFER_SRGB = 2,
+    WN_DF_CHANNEL_BC1A_ALPHAPRESENT = 1,
+    WN_DF_CHANNEL_COLOR = 0,
+    WN_DF_CHANNEL_GREEN = 1,
+    WN_DF_CHANNEL_BC3_ALPHA = 15,
+    WN_DF_SAMPLE_LINEAR = 1 << 4,
+};
+
+uint32_t wn_texture_format_block_size(uint32_t vk_format)
+{
+    switch (vk_format)
+    {
+    case WN_VK_FORMAT_BC1_RGBA_UNORM:
+    case WN_VK_FORMAT_BC1_RGBA_SRGB:
+        return 8;
+    case WN_VK_FORMAT_BC3_UNORM:
+    case WN_VK_FORMAT_BC3_SRGB:
+    case WN_VK_FORMAT_BC5_UNORM:
+    case WN_VK_FORMAT_BC7_UNORM:
+    case WN_VK_FORMAT_BC7_SRGB:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+const char* wn_texture_format_name(uint32_t vk_format)
+{
+    switch (vk_format)
+    {
+    case WN_VK_FORMAT_BC1_RGBA_UNORM:
+    case WN_VK_FORMAT_BC1_RGBA_SRGB:
+        return "BC1";
+    case WN_VK_FORMAT_BC3_UNORM:
+    case WN_VK_FORMAT_BC3_SRGB:
+        return "BC3";
+    case WN_VK_FORMAT_BC5_UNORM:
+        return "BC5";
+    case WN_VK_FORMAT_BC7_UNORM:
+    case WN_VK_FORMAT_BC7_SRGB:
+        return "BC7";
+    default:
+        return "unknown";
+    }
+}
+
+static bool wn_texture_format_srgb(uint32_t vk_format)
+{
+    return vk_format == WN_VK_FORMAT_BC1_RGBA_SRGB || vk_format == WN_VK_FORMAT_BC3_SRGB
+        || vk_format == WN_VK_FORMAT_BC7_SRGB;
+}
+
+static uint32_t wn_dfd_sample(uint32_t* out, uint32_t bit_offset, uint32_t n_bits, uint32_t channel)
+{
+    out[0] = bit_offset | ((n_bits - 1) << 16) | (channel << 24);
+    out[1] = 0;          // sample position
+    out[2] = 0;          // lower
+    out[3] = UINT32_MAX; // upper
+    return 4;
+}
+
+// basic descriptor block for vk_format, returns its size in words (total size word included)
+static uint32_t wn_dfd_build(uint32_t vk_format, uint32_t out[16])
+{
+    uint32_t model = 0;
+    uint32_t n_words = 7;
+    bool srgb = wn_texture_format_srgb(vk_format);
+
+    memset(out, 0, sizeof(uint32_t) * 16);
+    switch (vk_format)
+    {
+    case WN_VK_FORMAT_BC1_RGBA_UNORM:
+    case WN_VK_FORMAT_BC1_RGBA_SRGB:
+        model = WN_DF_MODEL_BC1A;
+        n_words += wn_dfd_sample(&out[n_words], 0, 64, WN_DF_CHANNEL_BC1A_ALPHAPRESENT);
+        break;
+    case WN_VK_FORMAT_BC3_UNORM:
+    case WN_VK_FORMAT_BC3_SRGB:
+        model = WN_DF_MODEL_BC3;
+        n_words += wn_dfd_sample(
+            &out[n_words],
+            0,
+            64,
+            WN_DF_CHANNEL_BC3_ALPHA | (srgb ? WN_DF_SAMPLE_LINEAR : 0));
+        n_words += wn_dfd_sample(&out[n_words], 64, 64, WN_DF_CHANNEL_COLOR);
+        break;
+    case WN_VK_FORMAT_BC5_UNORM:
+        model = WN_DF_MODEL_BC5;
+        n_words += wn_dfd_sample(&out[n_words], 0, 64, WN_DF_CHANNEL_COLOR);
+        n_words += wn_dfd_sample(&out[n_words], 64, 64, WN_DF_CHANNEL_GREEN);
+        break;
+    case WN_VK_FORMAT_BC7_UNORM:
+    case WN_VK_FORMAT_BC7_SRGB:
+        model = WN_DF_MODEL_BC7;
+        n_words += wn_dfd_sample(&out[n_words], 0, 128, WN_DF_CHANNEL_COLOR);
+        break;
+    }
+
+    uint32_t block_bytes = sizeof(uint32_t) * (n_words - 1);
+    out[0] = sizeof(uint32_t) * n_words;
+    out[1] = 0; // khronos vendor, basic descriptor type
+    out[2] = 2 | (block_bytes << 16);
+    out[3] = model | (WN_DF_PRIMARIES_BT709 << 8)
+           | ((srgb ? WN_DF_TRANSFER_SRGB : WN_DF_TRANSFER_LINEAR) << 16);
+    out[4] = 3 | (3 << 8); // 4x4x1x1 texel blocks
+    out[5] = wn_texture_format_block_size(vk_format);
+    out[6] = 0;
+
+    return n_words;
+}
+
+static inline uint64_t wn_texture_file_align(uint64_t offset, uint64_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static bool wn_texture_file_write_at(FILE* file, uint64_t offset, const void* data, size_t size)
+{
+    static const uint8_t zeros[16] = { 0 };
+
+    long pos = ftell(file);
+    if (pos < 0 || (uint64_t)pos > offset || offset - (uint64_t)pos > sizeof(zeros))
+    {
+        return false;
+    }
+    if (fwrite(zeros, 1, (size_t)(offset - (uint64_t)pos), file) != offset - (uint64_t)pos)
+    {
+        return false;
+    }
+    return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+wn_result wn_texture_file_write(
+    const char* filename,
+    uint32_t vk_format,
+    uint32_t width,
+    uint32_t height,
+    uint32_t n_mips,
+    const uint8_t* const* levels)
+{
+    uint32_t block_size = wn_texture_format_block_size(vk_format);
+    if (block_size == 0 || n_mips == 0 || n_mips > WN_TEXTURE_MAX_MIPS
+        || n_mips > wn_image_mip_count(width, height))
+    {
+        log_error("Can't write %s: unsupported format %u or %u mips", filename, vk_format, n_mips);
+        return WN_ERR;
+    }
+
+    uint32_t dfd[16];
+    uint32_t dfd_words = wn_dfd_build(vk_format, dfd);
+
+    wn_ktx2_header_t header = {
+        .vk_format = vk_format,
+        .type_size = 1,
+        .pixel_width = width,
+        .pixel_height = height,
+        .pixel_depth = 0,
+        .layer_count = 0,
+        .face_count = 1,
+        .level_count = n_mips,
+        .supercompression_scheme = 0,
+        .dfd_offset = (uint32_t)(sizeof(wn_ktx2_header_t) + sizeof(wn_ktx2_level_t) * n_mips),
+        .dfd_size = sizeof(uint32_t) * dfd_words,
+    };
+    memcpy(header.identifier, wn_ktx2_identifier, sizeof(wn_ktx2_identifier));
+
+    // NOTE: KTX2 stores the smallest level first, every level aligned to lcm(block size, 4)
+    wn_ktx2_level_t level_index[WN_TEXTURE_MAX_MIPS] = { 0 };
+    uint64_t offset = header.dfd_offset + header.dfd_size;
+    for (uint32_t mip = n_mips; mip-- > 0;)
+    {
+        uint64_t size = wn_texture_level_size(
+            wn_image_mip_extent(width, mip),
+            wn_image_mip_extent(height, mip),
+            block_size);
+
+        offset = wn_texture_file_align(offset, block_size);
+        level_index[mip] = (wn_ktx2_level_t) {
+            .offset = offset,
+            .size = size,
+            .uncompressed_size = size,
+        };
+        offset += size;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+    {
+        log_error("Could not open %s for writing", filename);
+        return WN_ERR;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(level_index, sizeof(wn_ktx2_level_t), n_mips, file) == n_mips
+        && fwrite(dfd, sizeof(uint32_t), dfd_words, file) == dfd_words;
+
+    for (uint32_t mip = n_mips; ok && mip-- > 0;)
+    {
+        ok = wn_texture_file_write_at(
+            file,
+            level_index[mip].offset,
+            levels[mip],
+            (size_t)level_index[mip].size);
+    }
+
+    if (fclose(file) != 0 || !ok)
+    {
+        log_error("Could not write baked texture %s", filename);
+        return WN_ERR;
+    }
+
+    return WN_OK;
+}
+
+wn_result wn_texture_file_map(const char* filename, wn_texture_file_t* texture)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return WN_ERR;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(wn_ktx2_header_t))
+    {
+        log_error("Baked texture %s is truncated", filename);
+        close(fd);
+        return WN_ERR;
+    }
+
+    size_t size = (size_t)st.st_size;
+    uint8_t* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        log_error("Could not map baked texture %s", filename);
+        return WN_ERR;
+    }
+
+    wn_ktx2_header_t header;
+    memcpy(&header, data, sizeof(header));
+
+    uint32_t block_size = wn_texture_format_block_size(header.vk_format);
+    bool valid = memcmp(header.identifier, wn_ktx2_identifier, sizeof(wn_ktx2_identifier)) == 0
+        && block_size > 0 && header.type_size == 1 && header.pixel_width > 0
+        && header.pixel_height > 0 && header.pixel_depth == 0 && header.layer_count <= 1
+        && header.face_count == 1 && header.supercompression_scheme == 0
+        && header.level_count >= 1 && header.level_count <= WN_TEXTURE_MAX_MIPS
+        && header.level_count <= wn_image_mip_count(header.pixel_width, header.pixel_height)
+        && sizeof(wn_ktx2_header_t) + sizeof(wn_ktx2_level_t) * header.level_count <= size;
+
+    *texture = (wn_texture_file_t) {
+        .vk_format = header.vk_format,
+        .width = header.pixel_width,
+        .height = header.pixel_height,
+        .n_mips = header.level_count,
+        .block_size = block_size,
+        .mapping = data,
+        .mapping_size = size,
+    };
+
+    for (uint32_t mip = 0; valid && mip < header.level_count; mip++)
+    {
+        wn_ktx2_level_t level;
+        memcpy(
+            &level,
+            data + sizeof(wn_ktx2_header_t) + sizeof(wn_ktx2_level_t) * mip,
+            sizeof(level));
+
+        uint64_t expected = wn_texture_level_size(
+            wn_image_mip_extent(header.pixel_width, mip),
+            wn_image_mip_extent(header.pixel_height, mip),
+            block_size);
+        valid = level.size == expected && level.offset <= size && level.size <= size - level.offset;
+        texture->levels[mip] = (wn_texture_level_t) { .offset = level.offset, .size = level.size };
+    }
+
+    if (!valid)
+    {
+        log_error("Baked texture %s is invalid or uses an unsupported KTX2 feature", filename);
+        munmap(data, size);
+        *texture = (wn_texture_file_t) { 0 };
+        return WN_ERR;
+    }
+
+    madvise(data, size, MADV_WILLNEED);
+
+    return WN_OK;
+}
+
+void wn_texture_file_unmap(wn_texture_file_t* texture)
+{
+    if (texture->mapping)
+    {
+        munmap(texture->mapping, texture->mapping_size);
+    }
+    *texture = (wn_texture_file_t) { 0 };
+}
+
+bool wn_texture_file_baked_path(const char* source, char* out, size_t out_size)
+{
+    const char* ext = strrchr(source, '.');
+    const char* sep = strrchr(source, '/');
+    size_t stem = (ext && (!sep || ext > sep)) ? (size_t)(ext - source) : strlen(source);
+
+    int written = snprintf(out, out_size, "%.*s.ktx2", (int)stem, source);
+    return written > 0 && (size_t)written < out_size;
+}
@@ -0,0 +1,77 @@
+/*
+===========================================================================
+
+whynot::asset::texture_file.h: baked block compressed textures (.ktx2)
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+
+// the VkFormat values KTX2 stores, spelled out so the asset code doesn't need vulkan headers
+#define WN_VK_FORMAT_R8G8B8A8_SRGB 43u
+#define WN_VK_FORMAT_BC1_RGBA_UNORM 133u
+#define WN_VK_FORMAT_BC1_RGBA_SRGB 134u
+#define WN_VK_FORMAT_BC3_UNORM 137u
+#define WN_VK_FORMAT_BC3_SRGB 138u
+#define WN_VK_FORMAT_BC5_UNORM 141u
+#define WN_VK_FORMAT_BC7_UNORM 145u
+#define WN_VK_FORMAT_BC7_SRGB 146u
+
+#define WN_TEXTURE_MAX_MIPS 16u
+
+typedef struct wn_texture_level_t
+{
+    uint64_t offset; // into the mapping
+    uint64_t size;
+} wn_texture_level_t;
+
+/*
+ * Single 2D image with a full or partial mip chain of 4x4 blocks, ready to be copied into a
+ * staging buffer as is. Only KTX2 files without supercompression, layers or faces are accepted.
+ */
+typedef struct wn_texture_file_t
+{
+    uint32_t vk_format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t n_mips;
+    uint32_t block_size; // bytes per 4x4 block
+    wn_texture_level_t levels[WN_TEXTURE_MAX_MIPS]; // largest first
+
+    uint8_t* mapping;
+    size_t mapping_size;
+} wn_texture_file_t;
+
+// bytes per 4x4 block, 0 for formats the texture files don't handle
+uint32_t wn_texture_format_block_size(uint32_t vk_format);
+
+const char* wn_texture_format_name(uint32_t vk_format);
+
+static inline uint64_t wn_texture_level_size(uint32_t width, uint32_t height, uint32_t block_size)
+{
+    return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * block_size;
+}
+
+// levels[i] points to the blocks of mip i, each wn_texture_level_size of its extent
+wn_result wn_texture_file_write(
+    const char* filename,
+    uint32_t vk_format,
+    uint32_t width,
+    uint32_t height,
+    uint32_t n_mips,
+    const uint8_t* const* levels);
+
+// maps a baked texture read-only, WN_ERR without logging if the file doesn't exist
+wn_result wn_texture_file_map(const char* filename, wn_texture_file_t* texture);
+void wn_texture_file_unmap(wn_texture_file_t* texture);
+
+static inline const uint8_t* wn_texture_file_level(const wn_texture_file_t* texture, uint32_t mip)
+{
+    return texture->mapping + texture->levels[mip].offset;
+}
+
+// source image path with its extension swapped for .ktx2, false if it doesn't fit in out
+bool wn_texture_file_baked_path(const char* source, char* out, size_t out_size);
@@ -0,0 +1,198 @@
+/*
+===========================================================================
+
+whynot::asset::vertex_pack.c: gpu vertex/index encodings picked per mesh
+
+===========================================================================
+*/
+
+#include "vertex_pack.h"
+
+#include <assert.h>
+#include <string.h>
+
+static uint32_t wn_attrib_size(wn_attrib_encoding encoding, uint32_t n_components)
+{
+    // NOTE: 3 component 16 bit formats are rarely supported for vertex input, those get padded
+    switch (encoding)
+    {
+    case WN_ATTRIB_F16:
+    case WN_ATTRIB_UNORM16:
+        return n_components == 3 ? 8 : 2 * n_components;
+    case WN_ATTRIB_F32:
+    default:
+        return 4 * n_components;
+    }
+}
+
+static inline uint16_t wn_unorm16(float value)
+{
+    value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+    return (uint16_t)(value * 65535.0f + 0.5f);
+}
+
+uint16_t wn_f32_to_f16(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff)
+    {
+        // inf stays inf, nan stays a (quiet) nan
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31)
+    {
+        return (uint16_t)(sign | 0x7c00);
+    }
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return (uint16_t)sign;
+        }
+        // subnormal, round to nearest
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        half += rest > midpoint || (rest == midpoint && (half & 1));
+        return (uint16_t)(sign | half);
+    }
+
+    // round to nearest even, a mantissa carry bumps the exponent which is what we want
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    half += rest > 0x1000 || (rest == 0x1000 && (half & 1));
+    return (uint16_t)half;
+}
+
+wn_vertex_layout_t wn_mesh_vertex_layout(const wn_mesh_t* mesh, bool quantize)
+{
+    wn_vertex_layout_t layout = {
+        .pos = WN_ATTRIB_F32,
+        .tex_coord0 = WN_ATTRIB_F32,
+        .pos_scale = { .x = 1.0f, .y = 1.0f, .z = 1.0f },
+        .pos_bias = { 0 },
+    };
+
+    if (quantize)
+    {
+        layout.pos = WN_ATTRIB_UNORM16;
+        layout.pos_bias = mesh->bounds_min;
+        layout.pos_scale = (wn_v3f_t) {
+            .x = mesh->bounds_max.x - mesh->bounds_min.x,
+            .y = mesh->bounds_max.y - mesh->bounds_min.y,
+            .z = mesh->bounds_max.z - mesh->bounds_min.z,
+        };
+
+        bool uv_unit = true;
+        for (size_t i = 0; i < mesh->n_vertices && uv_unit; i++)
+        {
+            wn_v2f_t uv = mesh->vertices[i].tex_coord0;
+            uv_unit = uv.x >= 0.0f && uv.x <= 1.0f && uv.y >= 0.0f && uv.y <= 1.0f;
+        }
+        layout.tex_coord0 = uv_unit ? WN_ATTRIB_UNORM16 : WN_ATTRIB_F16;
+    }
+
+    layout.pos_offset = 0;
+    layout.tex_coord0_offset = wn_attrib_size(layout.pos, 3);
+    layout.stride = layout.tex_coord0_offset + wn_attrib_size(layout.tex_coord0, 2);
+
+    return layout;
+}
+
+void wn_mesh_pack_vertices(
+    const wn_mesh_t* mesh,
+    const wn_vertex_layout_t* layout,
+    size_t first,
+    size_t n,
+    void* out)
+{
+    assert(first + n <= mesh->n_vertices);
+
+    if (layout->pos == WN_ATTRIB_F32 && layout->tex_coord0 == WN_ATTRIB_F32)
+    {
+        memcpy(out, &mesh->vertices[first], sizeof(wn_vertex_t) * n);
+        return;
+    }
+
+    wn_v3f_t inv_scale = {
+        .x = layout->pos_scale.x > 0.0f ? 1.0f / layout->pos_scale.x : 0.0f,
+        .y = layout->pos_scale.y > 0.0f ? 1.0f / layout->pos_scale.y : 0.0f,
+        .z = layout->pos_scale.z > 0.0f ? 1.0f / layout->pos_scale.z : 0.0f,
+    };
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const wn_vertex_t* v = &mesh->vertices[first + i];
+        uint8_t* dst = (uint8_t*)out + i * layout->stride;
+
+        if (layout->pos == WN_ATTRIB_UNORM16)
+        {
+            uint16_t pos[4] = {
+                wn_unorm16((v->pos.x - layout->pos_bias.x) * inv_scale.x),
+                wn_unorm16((v->pos.y - layout->pos_bias.y) * inv_scale.y),
+                wn_unorm16((v->pos.z - layout->pos_bias.z) * inv_scale.z),
+                0,
+            };
+            memcpy(dst + layout->pos_offset, pos, sizeof(pos));
+        }
+        else
+        {
+            memcpy(dst + layout->pos_offset, &v->pos, sizeof(v->pos));
+        }
+
+        uint16_t uv[2];
+        switch (layout->tex_coord0)
+        {
+        case WN_ATTRIB_UNORM16:
+            uv[0] = wn_unorm16(v->tex_coord0.x);
+            uv[1] = wn_unorm16(v->tex_coord0.y);
+            memcpy(dst + layout->tex_coord0_offset, uv, sizeof(uv));
+            break;
+        case WN_ATTRIB_F16:
+            uv[0] = wn_f32_to_f16(v->tex_coord0.x);
+            uv[1] = wn_f32_to_f16(v->tex_coord0.y);
+            memcpy(dst + layout->tex_coord0_offset, uv, sizeof(uv));
+            break;
+        case WN_ATTRIB_F32:
+            memcpy(dst + layout->tex_coord0_offset, &v->tex_coord0, sizeof(v->tex_coord0));
+            break;
+        }
+    }
+}
+
+uint32_t wn_mesh_index_size(const wn_mesh_t* mesh)
+{
+    // indices are relative to their submesh's first vertex
+    return wn_mesh_max_submesh_vertices(mesh) < 65536 ? 2 : 4;
+}
+
+void wn_mesh_pack_indices(
+    const wn_mesh_t* mesh,
+    uint32_t index_size,
+    size_t first,
+    size_t n,
+    void* out)
+{
+    assert(first + n <= mesh->n_indices);
+    assert(index_size == 4 || wn_mesh_index_size(mesh) == 2);
+
+    if (index_size == 4)
+    {
+        memcpy(out, &mesh->indices[first], sizeof(uint32_t) * n);
+        return;
+    }
+
+    uint16_t* indices = out;
+    for (size_t i = 0; i < n; i++)
+    {
+        indices[i] = (uint16_t)mesh->indices[first + i];
+    }
+}
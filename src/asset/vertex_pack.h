@@ -0,0 +1,60 @@
+/*
+===========================================================================
+
+whynot::asset::vertex_pack.h: gpu vertex/index encodings picked per mesh
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+#include "mesh.h"
+
+typedef enum wn_attrib_encoding
+{
+    WN_ATTRIB_F32,
+    WN_ATTRIB_F16,
+    WN_ATTRIB_UNORM16, // positions are relative to the mesh bounds, see pos_scale/pos_bias
+} wn_attrib_encoding;
+
+// how wn_vertex_t ends up in the vertex buffer, the renderer turns this into the vertex input
+// state and feeds pos_scale/pos_bias to the vertex shader
+typedef struct wn_vertex_layout_t
+{
+    wn_attrib_encoding pos;
+    wn_attrib_encoding tex_coord0;
+    uint32_t pos_offset;
+    uint32_t tex_coord0_offset;
+    uint32_t stride;
+
+    // object space position = decoded * pos_scale + pos_bias
+    wn_v3f_t pos_scale;
+    wn_v3f_t pos_bias;
+} wn_vertex_layout_t;
+
+// plain fp32 wn_vertex_t unless quantize is set, then 16 bit positions over the bounds and the
+// tightest uv encoding that holds the mesh's uvs (unorm16 inside [0, 1], half otherwise)
+wn_vertex_layout_t wn_mesh_vertex_layout(const wn_mesh_t* mesh, bool quantize);
+
+// writes vertices [first, first + n) of mesh, n * layout->stride bytes, to out
+void wn_mesh_pack_vertices(
+    const wn_mesh_t* mesh,
+    const wn_vertex_layout_t* layout,
+    size_t first,
+    size_t n,
+    void* out);
+
+// 2 if every (base vertex relative) index fits in 16 bits, 4 otherwise
+uint32_t wn_mesh_index_size(const wn_mesh_t* mesh);
+
+// writes indices [first, first + n) of mesh as index_size (2 or 4) byte indices to out, 2 only if
+// wn_mesh_index_size(mesh) is
+void wn_mesh_pack_indices(
+    const wn_mesh_t* mesh,
+    uint32_t index_size,
+    size_t first,
+    size_t n,
+    void* out);
+
+uint16_t wn_f32_to_f16(float value);
@@ -0,0 +1,165 @@
+/*
+===========================================================================
+
+whynot::core::job.c: worker thread pool for coarse cpu jobs (asset decoding etc.)
+
+===========================================================================
+*/
+
+#include "job.h"
+
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static _Thread_local uint32_t wn_job_thread = 0;
+
+// expects the lock to be held
+static bool wn_job_pop(wn_job_system_t* jobs, wn_job_t* job)
+{
+    if (jobs->queue_head >= (size_t)stbds_arrlen(jobs->queue))
+    {
+        return false;
+    }
+
+    *job = jobs->queue[jobs->queue_head++];
+
+    // drained, rewind instead of growing forever
+    if (jobs->queue_head == (size_t)stbds_arrlen(jobs->queue))
+    {
+        stbds_arrdeln(jobs->queue, 0, jobs->queue_head);
+        jobs->queue_head = 0;
+    }
+    return true;
+}
+
+static void wn_job_run(wn_job_system_t* jobs, const wn_job_t* job)
+{
+    job->fn(job->data);
+
+    if (job->counter)
+    {
+        atomic_fetch_sub(&job->counter->pending, 1);
+    }
+
+    pthread_mutex_lock(&jobs->lock);
+    pthread_cond_broadcast(&jobs->job_done);
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+static void* wn_job_worker(void* arg)
+{
+    wn_job_system_t* jobs = arg;
+    wn_job_thread = atomic_fetch_add(&jobs->n_started, 1) + 1;
+
+    pthread_mutex_lock(&jobs->lock);
+    for (;;)
+    {
+        wn_job_t job;
+        if (wn_job_pop(jobs, &job))
+        {
+            pthread_mutex_unlock(&jobs->lock);
+            wn_job_run(jobs, &job);
+            pthread_mutex_lock(&jobs->lock);
+        }
+        else if (jobs->shutdown)
+        {
+            break;
+        }
+        else
+        {
+            pthread_cond_wait(&jobs->job_ready, &jobs->lock);
+        }
+    }
+    pthread_mutex_unlock(&jobs->lock);
+
+    return NULL;
+}
+
+void wn_job_system_init(wn_job_system_t* jobs, uint32_t n_threads)
+{
+    *jobs = (wn_job_system_t) { 0 };
+
+    if (n_threads == 0)
+    {
+        long n_cores = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = n_cores > 0 ? (uint32_t)n_cores : 1;
+    }
+
+    pthread_mutex_init(&jobs->lock, NULL);
+    pthread_cond_init(&jobs->job_ready, NULL);
+    pthread_cond_init(&jobs->job_done, NULL);
+
+    jobs->threads = malloc(sizeof(pthread_t) * n_threads);
+    assert(jobs->threads);
+    jobs->n_threads = n_threads;
+    for (uint32_t i = 0; i < n_threads; i++)
+    {
+        int err = pthread_create(&jobs->threads[i], NULL, wn_job_worker, jobs);
+        assert(err == 0);
+        (void)err;
+    }
+}
+
+void wn_job_system_shutdown(wn_job_system_t* jobs)
+{
+    pthread_mutex_lock(&jobs->lock);
+    jobs->shutdown = true;
+    pthread_cond_broadcast(&jobs->job_ready);
+    pthread_mutex_unlock(&jobs->lock);
+
+    for (uint32_t i = 0; i < jobs->n_threads; i++)
+    {
+        pthread_join(jobs->threads[i], NULL);
+    }
+
+    free(jobs->threads);
+    stbds_arrfree(jobs->queue);
+    pthread_cond_destroy(&jobs->job_done);
+    pthread_cond_destroy(&jobs->job_ready);
+    pthread_mutex_destroy(&jobs->lock);
+    *jobs = (wn_job_system_t) { 0 };
+}
+
+void wn_job_submit(wn_job_system_t* jobs, wn_job_fn fn, void* data, wn_job_counter_t* counter)
+{
+    if (counter)
+    {
+        atomic_fetch_add(&counter->pending, 1);
+    }
+
+    wn_job_t job = { .fn = fn, .data = data, .counter = counter };
+
+    pthread_mutex_lock(&jobs->lock);
+    stbds_arrput(jobs->queue, job);
+    pthread_cond_signal(&jobs->job_ready);
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+void wn_job_wait(wn_job_system_t* jobs, wn_job_counter_t* counter)
+{
+    pthread_mutex_lock(&jobs->lock);
+    while (atomic_load(&counter->pending) > 0)
+    {
+        wn_job_t job;
+        if (wn_job_pop(jobs, &job))
+        {
+            pthread_mutex_unlock(&jobs->lock);
+            wn_job_run(jobs, &job);
+            pthread_mutex_lock(&jobs->lock);
+        }
+        else
+        {
+            pthread_cond_wait(&jobs->job_done, &jobs->lock);
+        }
+    }
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+uint32_t wn_job_thread_index(void)
+{
+    return wn_job_thread;
+}
@@ -0,0 +1,62 @@
+/*
+===========================================================================
+
+whynot::core::job.h: worker thread pool for coarse cpu jobs (asset decoding etc.)
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef void (*wn_job_fn)(void* data);
+
+// jobs submitted against the same counter can be waited on together
+typedef struct wn_job_counter_t
+{
+    atomic_uint pending;
+} wn_job_counter_t;
+
+typedef struct wn_job_t
+{
+    wn_job_fn fn;
+    void* data;
+    wn_job_counter_t* counter;
+} wn_job_t;
+
+typedef struct wn_job_system_t
+{
+    pthread_t* threads;
+    uint32_t n_threads;
+
+    // FIFO, jobs are coarse enough that a single lock doesn't matter
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready;
+    pthread_cond_t job_done;
+    wn_job_t* queue; // stbds array
+    size_t queue_head;
+    bool shutdown;
+
+    atomic_uint n_started; // hands out the worker indices
+} wn_job_system_t;
+
+// n_threads 0 picks one worker per online core
+void wn_job_system_init(wn_job_system_t* jobs, uint32_t n_threads);
+
+// finishes every queued job before joining the workers
+void wn_job_system_shutdown(wn_job_system_t* jobs);
+
+void wn_job_submit(wn_job_system_t* jobs, wn_job_fn fn, void* data, wn_job_counter_t* counter);
+
+// blocks until every job of counter is done, runs queued jobs on the calling thread meanwhile
+void wn_job_wait(wn_job_system_t* jobs, wn_job_counter_t* counter);
+
+/*
+ * 1 to n_threads on the workers, 0 on every other thread. Lets jobs index per thread data without
+ * locking, the thread calling wn_job_wait runs jobs too and gets its own slot that way.
+ */
+uint32_t wn_job_thread_index(void);
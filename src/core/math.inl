@@ -32,6 +32,7 @@ wn_v3f_t wn_v3f_minus(const wn_v3f_t* a, const wn_v3f_t* b);
 
 // wn_mat4f_t defs
 wn_mat4f_t wn_mat4f_transpose(const wn_mat4f_t* m);
+wn_mat4f_t wn_mat4f_mul(const wn_mat4f_t* a, const wn_mat4f_t* b);
 wn_mat4f_t wn_mat4f_look_at(const wn_v3f_t* eye, const wn_v3f_t* at, const wn_v3f_t* up);
 wn_mat4f_t wn_mat4f_perspective(float vertical_fov, float aspect_ratio, float z_near, float z_far);
 wn_mat4f_t wn_mat4f_from_rotation_z(float angle);
@@ -131,6 +132,23 @@ wn_mat4f_t wn_mat4f_transpose(const wn_mat4f_t* m)
                           } };
 }
 
+// a * b, matrices are column major (mat4f[column][row])
+wn_mat4f_t wn_mat4f_mul(const wn_mat4f_t* a, const wn_mat4f_t* b)
+{
+    wn_mat4f_t r = { 0 };
+    for (int col = 0; col < 4; col++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                r.mat4f[col][row] += a->mat4f[k][row] * b->mat4f[col][k];
+            }
+        }
+    }
+    return r;
+}
+
 wn_mat4f_t wn_mat4f_look_at(const wn_v3f_t* eye, const wn_v3f_t* at, const wn_v3f_t* up)
 {
     wn_v3f_t f = wn_v3f_minus(at, eye);
@@ -8,6 +8,22 @@ whynot::main.c
 
 #include "util.h"
 
+#include "command.h"
+#include "core_types.h"
+#include "gpu_memory.h"
+#include "image.h"
+#include "job.h"
+#include "math.inl"
+#include "mesh.h"
+#include "mesh_arena.h"
+#include "mesh_file.h"
+#include "mesh_lod.h"
+#include "mesh_opt.h"
+#include "meshlet.h"
+#include "obj.h"
+#include "texture_file.h"
+#include "vertex_pack.h"
+
 #include "log.h"
 #define STB_DS_IMPLEMENTATION
 #define STBDS_NO_SHORT_NAMES
@@ -29,345 +45,300 @@ whynot::main.c
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#ifdef WN_BENCH_OBJ
+    #include <sys/resource.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
 
 #define ENGINE_NAME "whynot"
 #define VK_API_VERSION VK_API_VERSION_1_2
 
 #define MAX_FRAMES_IN_FLIGHT 2
+// capacity of the mesh arena and the vertex/index buffers mirroring it
+#define MESH_ARENA_VERTICES (1u << 21)
+#define MESH_ARENA_INDICES (1u << 23)
+// largest on screen deviation a lower detail level may introduce
+#define LOD_THRESHOLD_PX 1.0f
+
+// every upload goes through it, a single texture level or buffer chunk has to fit
+#define STAGING_RING_SIZE (64u << 20)
+
+// how often wn_draw logs the memory statistics
+#define MEMORY_STATS_LOG_FRAMES 3600u
+
+// uniform data written by the cpu per frame in flight, the mvp plus any per-object constants
+#define UNIFORM_ARENA_SIZE (64u << 10)
+
+// streamed textures keep every mip this size and below resident
+#define TEXTURE_STREAM_TAIL_EXTENT 64u
+// a streamed mip nothing sampled for this many frames gets evicted
+#define TEXTURE_STREAM_IDLE_FRAMES 120u
+// overridden by WN_TEXTURE_BUDGET_MB
+#define TEXTURE_STREAM_BUDGET_MB 256u
+
+// fewer draws than this aren't worth recording on a thread of their own
+#define DRAWS_PER_CHUNK 256u
+
+#ifdef WN_BENCH_RECORDING
+#define RECORD_BENCH_DRAWS 100000u
+#define RECORD_BENCH_RUNS 5u
+#endif
 
-typedef union wn_v2f_t
-{
-    float v2f[2];
-    struct
-    {
-        float x, y;
-    };
-    struct
-    {
-        float u, v;
-    };
-    struct
-    {
-        float r, g;
-    };
-} wn_v2f_t;
-
-typedef union wn_v3f_t
-{
-    float v3f[3];
-    struct
-    {
-        float x, y, z;
-    };
-    struct
-    {
-        float u, v, w;
-    };
-    struct
-    {
-        float r, g, b;
-    };
-} wn_v3f_t;
-
-typedef union wn_v4f_t
-{
-    float v4f[4];
-    struct
-    {
-        float x, y, z, w;
-    };
-    struct
-    {
-        float r, g, b, a;
-    };
-} wn_v4f_t;
-
-typedef union wn_mat4f_t
-{
-    float mat4f[4][4];
-    wn_v4f_t v4f[4];
-    struct
-    {
-        float xx, xy, xz, xw;
-        float yx, yy, yz, yw;
-        float zx, zy, zz, zw;
-        float wx, wy, wz, ww;
-    };
-} wn_mat4f_t;
-
-/*
- * NOTE: source coordinates are right handed y-up, +z out, +x right
- *       dest coordinates are right handed y-down with z(depth) clip from 0.0(near) - 1.0(far)
- */
-
-float wn_v3f_sqr_magnitude(const wn_v3f_t* v)
-{
-    return ((v->x * v->x) + (v->y * v->y) + (v->z * v->z));
-}
-
-float wn_v3f_magnitude(const wn_v3f_t* v)
-{
-    float sqr_mag = wn_v3f_sqr_magnitude(v);
-    return sqrtf(sqr_mag);
-}
-
-void wn_v3f_normalize(wn_v3f_t* v)
-{
-    float inv_mag = 1.0f / wn_v3f_magnitude(v);
-    v->x *= inv_mag;
-    v->y *= inv_mag;
-    v->z *= inv_mag;
-}
-
-wn_v3f_t wn_v3f_normalized(const wn_v3f_t* v)
-{
-    wn_v3f_t r = {
-        .x = v->x,
-        .y = v->y,
-        .z = v->z,
-    };
-    wn_v3f_normalize(&r);
-    return r;
-}
-
-float wn_v3f_dot(const wn_v3f_t* a, const wn_v3f_t* b)
-{
-    return ((a->x * b->x) + (a->y * b->y) + (a->z * b->z));
-}
-
-wn_v3f_t wn_v3f_cross(const wn_v3f_t* a, const wn_v3f_t* b)
-{
-    // clang-format off
-    return (wn_v3f_t) {
-        .x = (a->y * b->z) - (a->z * b->y),
-        .y = (a->z * b->x) - (a->x * b->z),
-        .z = (a->x * b->y) - (a->y * b->x),
-    };
-    // clang-format on
-}
-
-wn_v3f_t wn_v3f_minus(const wn_v3f_t* a, const wn_v3f_t* b)
-{
-    return (wn_v3f_t) { .x = (a->x - b->x), .y = (a->y - b->y), .z = (a->z - b->z) };
-}
-
-void wn_mat4f_print(const wn_mat4f_t* m)
-{
-    // clang-format off
-    printf(
-        "%f, %f, %f, %f,\n"
-        "%f, %f, %f, %f,\n"
-        "%f, %f, %f, %f,\n"
-        "%f, %f, %f, %f,\n\n",
-        m->xx, m->xy, m->xz, m->xw,
-        m->yx, m->yy, m->yz, m->yw,
-        m->zx, m->zy, m->zz, m->zw,
-        m->wx, m->wy, m->wz, m->ww);
-    // clang-format on
-}
-
-wn_mat4f_t wn_mat4f_transpose(const wn_mat4f_t* m)
-{
-    return (wn_mat4f_t) { .mat4f = {
-                              { m->xx, m->yx, m->zx, m->wx },
-                              { m->xy, m->yy, m->zy, m->wy },
-                              { m->xz, m->yz, m->zz, m->wz },
-                              { m->xw, m->yw, m->zw, m->ww },
-                          } };
-}
-
-wn_mat4f_t wn_mat4f_look_at(const wn_v3f_t* eye, const wn_v3f_t* at, const wn_v3f_t* up)
-{
-    wn_v3f_t f = wn_v3f_minus(at, eye);
-    wn_v3f_normalize(&f);
-    wn_v3f_t r = wn_v3f_cross(&f, up);
-    wn_v3f_normalize(&r);
-    wn_v3f_t u = wn_v3f_cross(&r, &f);
-
-    wn_v3f_t w = { -wn_v3f_dot(&r, eye), -wn_v3f_dot(&u, eye), wn_v3f_dot(&f, eye) };
-
-    // clang-format off
-    return (wn_mat4f_t) {
-        .v4f = {
-            (wn_v4f_t) {r.x, u.x, -f.x, 0.0f},
-            (wn_v4f_t) {r.y, u.y, -f.y, 0.0f},
-            (wn_v4f_t) {r.z, u.z, -f.z, 0.0f},
-            (wn_v4f_t) {w.x, w.y, w.z, 1.0f},
-        }
-    };
-    // clang-format on
-}
+#ifdef WN_BENCH_OBJ
+#define OBJ_BENCH_MODEL "../assets/models/teapot.obj"
+// quads per side of the generated grid, two triangles each
+#define OBJ_BENCH_GRID 1024u
+#endif
 
-wn_mat4f_t wn_mat4f_perspective(float vertical_fov, float aspect_ratio, float z_near, float z_far)
+VkVertexInputBindingDescription wn_vertex_get_input_binding_desc(const wn_vertex_layout_t* layout)
 {
-    float t = tanf(vertical_fov / 2.0f);
-    float sy = 1.0f / t;
-    float sx = sy / aspect_ratio;
-    float nmf = z_near - z_far;
-
-    // clang-format off
-    return (wn_mat4f_t) {
-        .v4f = {
-            (wn_v4f_t) {sx, 0.0f, 0.0f, 0.0f},
-            (wn_v4f_t) {0.0f, -sy, 0.0f, 0.0f},
-            (wn_v4f_t) {0.0f, 0.0f, z_far / nmf, -1.0},
-            (wn_v4f_t) {0.0f, 0.0f, z_near * z_far / nmf, 0.0f},
-        }
+    VkVertexInputBindingDescription desc = {
+        .binding = 0,
+        .stride = layout->stride,
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
     };
-    // clang-format on
+    return desc;
 }
 
-wn_mat4f_t wn_mat4f_from_rotation_z(float angle)
+VkFormat wn_attrib_get_format(wn_attrib_encoding encoding, uint32_t n_components)
 {
-    float s = sinf(angle);
-    float c = cosf(angle);
-
-    // clang-format off
-    return (wn_mat4f_t) {
-        .v4f = {
-            (wn_v4f_t) {c, s, 0.0f, 0.0f},
-            (wn_v4f_t) {-s, c, 0.0f, 0.0f},
-            (wn_v4f_t) {0.0f, 0.0f, 1.0f, 0.0f},
-            (wn_v4f_t) {0.0f, 0.0f, 0.0f, 1.0f},
-        }
+    // 16 bit 3 component formats are padded to 4, see wn_mesh_vertex_layout
+    static const VkFormat formats[][4] = {
+        [WN_ATTRIB_F32] = { VK_FORMAT_R32_SFLOAT,
+                            VK_FORMAT_R32G32_SFLOAT,
+                            VK_FORMAT_R32G32B32_SFLOAT,
+                            VK_FORMAT_R32G32B32A32_SFLOAT },
+        [WN_ATTRIB_F16] = { VK_FORMAT_R16_SFLOAT,
+                            VK_FORMAT_R16G16_SFLOAT,
+                            VK_FORMAT_R16G16B16A16_SFLOAT,
+                            VK_FORMAT_R16G16B16A16_SFLOAT },
+        [WN_ATTRIB_UNORM16] = { VK_FORMAT_R16_UNORM,
+                                VK_FORMAT_R16G16_UNORM,
+                                VK_FORMAT_R16G16B16A16_UNORM,
+                                VK_FORMAT_R16G16B16A16_UNORM },
     };
-    // clang-format on
+    assert(n_components >= 1 && n_components <= 4);
+    return formats[encoding][n_components - 1];
 }
 
-wn_mat4f_t wn_mat4f_indentity()
+// fills the 2 attributes of wn_vertex_t as laid out in the vertex buffer
+void wn_vertex_get_attribute_desc(
+    const wn_vertex_layout_t* layout,
+    VkVertexInputAttributeDescription desc[2])
 {
-    // clang-format off
-    return (wn_mat4f_t) {
-        .v4f = {
-            (wn_v4f_t) {1.0f, 0.0f, 0.0f, 0.0f},
-            (wn_v4f_t) {0.0f, 1.0f, 0.0f, 0.0f},
-            (wn_v4f_t) {0.0f, 0.0f, 1.0f, 0.0f},
-            (wn_v4f_t) {0.0f, 0.0f, 0.0f, 1.0f},
-        }
+    desc[0] = (VkVertexInputAttributeDescription) {
+        .binding = 0,
+        .location = 0,
+        .format = wn_attrib_get_format(layout->pos, 3),
+        .offset = layout->pos_offset,
     };
-    // clang-format on
-}
-
-typedef struct wn_vertex_t
-{
-    wn_v3f_t pos;
-    wn_v2f_t tex_coord0;
-} wn_vertex_t;
-
-VkVertexInputBindingDescription wn_vertex_get_input_binding_desc()
-{
-    VkVertexInputBindingDescription desc = {
+    desc[1] = (VkVertexInputAttributeDescription) {
         .binding = 0,
-        .stride = sizeof(wn_vertex_t),
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+        .location = 1,
+        .format = wn_attrib_get_format(layout->tex_coord0, 2),
+        .offset = layout->tex_coord0_offset,
     };
-    return desc;
 }
 
-VkVertexInputAttributeDescription* wn_vertex_get_attribute_desc()
+// push constants of triangle.vert, set per submesh draw
+typedef struct wn_draw_push_t
 {
-    static VkVertexInputAttributeDescription desc[] = {
-        {
-            .binding = 0,
-            .location = 0,
-            .format = VK_FORMAT_R32G32B32_SFLOAT,
-            .offset = offsetof(wn_vertex_t, pos),
-        },
-        {
-            .binding = 0,
-            .location = 1,
-            .format = VK_FORMAT_R32G32_SFLOAT,
-            .offset = offsetof(wn_vertex_t, tex_coord0),
-        },
-    };
-
-    return desc;
-}
+    wn_mat4f_t transform; // submesh to model space
+    // undoes the position quantization
+    wn_v4f_t pos_scale;
+    wn_v4f_t pos_bias;
+} wn_draw_push_t;
+
+// a single submesh draw of the frame's draw list, see wn_record_draws
+typedef struct wn_draw_item_t
+{
+    wn_draw_push_t push;
+    uint32_t submesh; // indirect command in cull_draw when culling meshlets
+    // arena ranges of the draw without culling
+    uint32_t n_indices;
+    uint32_t first_index;
+    int32_t vertex_offset;
+} wn_draw_item_t;
 
 typedef struct wn_mvp_t
 {
     wn_mat4f_t model;
     wn_mat4f_t view;
     wn_mat4f_t proj;
+    // meshlet range of the current lod, only read by meshlet_cull.comp
+    uint32_t first_meshlet;
+    uint32_t n_meshlets;
 } wn_mvp_t;
 
-// TODO: a real mesh struct would probably suballocate from larger allocation, fewer malloc calls is
-// better
-typedef struct wn_mesh_t
+// written by triangle.frag, read back once the frame is done (see wn_texture_stream_update)
+typedef struct wn_texture_feedback_t
+{
+    uint32_t extent[2]; // of the full chain of the streamed texture
+    uint32_t min_mip;   // UINT32_MAX if nothing sampled it
+    uint32_t _pad;
+} wn_texture_feedback_t;
+
+typedef struct wn_scene_import_t
 {
-    size_t n_vertices;
+    // stbds arrays, handed off to the mesh as plain allocations at the end
     wn_vertex_t* vertices;
-    size_t n_indices;
     uint32_t* indices;
-    wn_mat4f_t transform;
-} wn_mesh_t;
-
-wn_mesh_t wn_mesh_new(size_t n_vertices, size_t n_indices)
+    wn_submesh_t* submeshes;
+} wn_scene_import_t;
+
+// appends every mesh referenced by node and its children as a submesh, instanced meshes are
+// copied once per node
+static void wn_import_node(
+    const struct aiScene* scene,
+    const struct aiNode* node,
+    const wn_mat4f_t* parent,
+    wn_scene_import_t* import)
 {
-    wn_vertex_t* vertices = malloc(sizeof(wn_vertex_t) * n_vertices);
-    assert(vertices);
-    uint32_t* indices = malloc(sizeof(uint32_t) * n_indices);
-    assert(indices);
+    // assimp matrices are row major
+    wn_mat4f_t local;
+    memcpy(&local, &node->mTransformation, sizeof(local));
+    local = wn_mat4f_transpose(&local);
+    wn_mat4f_t transform = wn_mat4f_mul(parent, &local);
 
-    return (wn_mesh_t) { .n_vertices = n_vertices,
-                         .vertices = vertices,
-                         .n_indices = n_indices,
-                         .indices = indices,
-                         .transform = wn_mat4f_indentity() };
-}
+    for (uint32_t m = 0; m < node->mNumMeshes; m++)
+    {
+        const struct aiMesh* src_mesh = scene->mMeshes[node->mMeshes[m]];
 
-void wn_mesh_destroy(wn_mesh_t* mesh)
-{
-    free(mesh->vertices);
-    free(mesh->indices);
-    mesh = NULL;
+        wn_submesh_t submesh = {
+            .transform = transform,
+            .first_vertex = (uint32_t)stbds_arrlen(import->vertices),
+            .n_vertices = src_mesh->mNumVertices,
+            .lods = { { .first_index = (uint32_t)stbds_arrlen(import->indices) } },
+        };
+
+        // points and lines can survive triangulation, only triangles are kept
+        for (uint32_t i = 0; i < src_mesh->mNumFaces; i++)
+        {
+            const struct aiFace* face = &src_mesh->mFaces[i];
+            if (face->mNumIndices == 3)
+            {
+                stbds_arrput(import->indices, face->mIndices[0]);
+                stbds_arrput(import->indices, face->mIndices[1]);
+                stbds_arrput(import->indices, face->mIndices[2]);
+            }
+        }
+        submesh.lods[0].n_indices
+            = (uint32_t)stbds_arrlen(import->indices) - submesh.lods[0].first_index;
+        if (submesh.lods[0].n_indices == 0)
+        {
+            continue;
+        }
+
+        for (uint32_t i = 0; i < src_mesh->mNumVertices; i++)
+        {
+            wn_vertex_t vertex = {
+                .pos = { .x = src_mesh->mVertices[i].x,
+                         .y = src_mesh->mVertices[i].y,
+                         .z = src_mesh->mVertices[i].z },
+            };
+            if (src_mesh->mTextureCoords[0])
+            {
+                vertex.tex_coord0.u = src_mesh->mTextureCoords[0][i].x;
+                vertex.tex_coord0.v = src_mesh->mTextureCoords[0][i].y;
+            }
+            stbds_arrput(import->vertices, vertex);
+        }
+
+        stbds_arrput(import->submeshes, submesh);
+    }
+
+    for (uint32_t i = 0; i < node->mNumChildren; i++)
+    {
+        wn_import_node(scene, node->mChildren[i], &transform, import);
+    }
 }
 
+// flattens the whole node hierarchy into one vertex/index allocation with a submesh per mesh
+// instance
 wn_mesh_t wn_load_obj(const char* file_name)
 {
     const struct aiScene* scene = aiImportFile(
         file_name,
         aiProcess_FindInvalidData | aiProcess_FindDegenerates | aiProcess_ValidateDataStructure
-            | aiProcess_Triangulate | aiProcess_OptimizeMeshes);
+            | aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_OptimizeMeshes);
     if (!scene)
     {
         log_fatal("could not load model");
         exit(EXIT_FAILURE);
     }
 
-    struct aiMesh* src_mesh = scene->mMeshes[0];
+    wn_scene_import_t import = { 0 };
+    wn_mat4f_t identity = wn_mat4f_indentity();
+    wn_import_node(scene, scene->mRootNode, &identity, &import);
+
+    size_t n_submeshes = stbds_arrlen(import.submeshes);
+    if (n_submeshes == 0)
+    {
+        log_fatal("model %s has no triangles", file_name);
+        exit(EXIT_FAILURE);
+    }
+
+    wn_mesh_t dst_mesh = wn_mesh_new(stbds_arrlen(import.vertices), stbds_arrlen(import.indices));
+    memcpy(dst_mesh.vertices, import.vertices, sizeof(wn_vertex_t) * dst_mesh.n_vertices);
+    memcpy(dst_mesh.indices, import.indices, sizeof(uint32_t) * dst_mesh.n_indices);
 
-    wn_mesh_t dst_mesh = wn_mesh_new(src_mesh->mNumFaces * src_mesh->mFaces->mNumIndices, 1);
+    wn_submesh_t* submeshes = realloc(dst_mesh.submeshes, sizeof(wn_submesh_t) * n_submeshes);
+    assert(submeshes);
+    memcpy(submeshes, import.submeshes, sizeof(wn_submesh_t) * n_submeshes);
+    dst_mesh.submeshes = submeshes;
+    dst_mesh.n_submeshes = n_submeshes;
 
-    memcpy(&dst_mesh.transform, &scene->mRootNode->mChildren[0], sizeof(wn_mat4f_t));
+    stbds_arrfree(import.vertices);
+    stbds_arrfree(import.indices);
+    stbds_arrfree(import.submeshes);
 
-    wn_mat4f_print(&dst_mesh.transform);
+    wn_mesh_compute_bounds(&dst_mesh);
 
     log_info(
-        "NUMVERTS: %d, NUM_FACE: %d, NUM_INDICES: %d",
-        src_mesh->mNumVertices,
-        src_mesh->mNumFaces,
-        src_mesh->mFaces->mNumIndices);
+        "Loaded %s: %u meshes in %zu submeshes, %zu vertices, %zu indices",
+        file_name,
+        scene->mNumMeshes,
+        dst_mesh.n_submeshes,
+        dst_mesh.n_vertices,
+        dst_mesh.n_indices);
+
+    aiReleaseImport(scene);
+
+    return dst_mesh;
+}
+
+// prefers a baked .wnmesh next to the source model (see wn_bake), only parses + optimizes the
+// source if there is none. Cpu only, safe to run on any thread
+wn_mesh_t wn_mesh_read(const char* filename)
+{
+    wn_mesh_t mesh = { 0 };
 
-    int k = 0;
-    for (size_t i = 0; i < src_mesh->mNumFaces; i++)
+    char baked_path[512];
+    if (wn_mesh_file_baked_path(filename, baked_path, sizeof(baked_path))
+        && wn_mesh_file_map(baked_path, filename, &mesh) == WN_OK)
+    {
+        log_info("Mapped baked mesh %s", baked_path);
+    }
+    else
     {
-        struct aiFace* face = &src_mesh->mFaces[i];
-        for (size_t j = 0; j < face->mNumIndices; j++)
+#ifdef WN_NATIVE_OBJ
+        if (wn_obj_load(filename, &mesh) != WN_OK)
         {
-            dst_mesh.vertices[k + j].pos.x = src_mesh->mVertices[face->mIndices[j]].x;
-            dst_mesh.vertices[k + j].pos.y = src_mesh->mVertices[face->mIndices[j]].y;
-            dst_mesh.vertices[k + j].pos.z = src_mesh->mVertices[face->mIndices[j]].z;
-
-            dst_mesh.vertices[k + j].tex_coord0.u
-                = src_mesh->mTextureCoords[0][face->mIndices[j]].x;
-            dst_mesh.vertices[k + j].tex_coord0.v
-                = src_mesh->mTextureCoords[0][face->mIndices[j]].y;
+            log_fatal("could not load model");
+            exit(EXIT_FAILURE);
         }
-        k += 3;
+#else
+        mesh = wn_load_obj(filename);
+#endif
+
+        // baked meshes already went through this in wn_bake
+        wn_mesh_optimize(&mesh);
+        wn_mesh_build_lods(&mesh);
+        wn_mesh_build_meshlets(&mesh);
     }
 
-    return dst_mesh;
+    return mesh;
 }
 
 // try and wrap GLFW dependency...
@@ -432,59 +403,6 @@ const char** wn_window_get_required_exts(uint32_t* nexts)
     return glfwGetRequiredInstanceExtensions(nexts);
 }
 
-// FIXME: very temporary convienence, single command buffer allocation + submission + full
-// vkQueueWaitIdle for the single command is incredibly inefficient
-VkCommandBuffer wn_begin_command_buffer(VkDevice device, VkCommandPool command_pool)
-{
-    VkCommandBufferAllocateInfo alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = command_pool,
-        .commandBufferCount = 1,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .pNext = NULL,
-    };
-
-    VkCommandBuffer command_buffer = NULL;
-    WN_VK_CHECK(vkAllocateCommandBuffers(device, &alloc_info, &command_buffer));
-
-    VkCommandBufferBeginInfo begin_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-        .pInheritanceInfo = NULL,
-        .pNext = NULL,
-    };
-
-    WN_VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
-
-    return command_buffer;
-}
-
-void wn_end_command_buffer(
-    VkDevice device,
-    VkCommandPool command_pool,
-    VkCommandBuffer command_buffer,
-    VkQueue queue)
-{
-    vkEndCommandBuffer(command_buffer);
-
-    VkSubmitInfo submit_info = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &command_buffer,
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = NULL,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = NULL,
-        .pWaitDstStageMask = NULL,
-        .pNext = NULL,
-    };
-
-    vkQueueSubmit(queue, 1, &submit_info, NULL);
-    vkQueueWaitIdle(queue);
-
-    vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
-}
-
 // NOTE: spec allows for separate graphics and present queues, but it does not exist in any
 // implementation afaik
 typedef struct wn_qfi_t
@@ -578,6 +496,63 @@ wn_qfi_t wn_find_queue_families(VkPhysicalDevice gpu)
     return qfi;
 }
 
+// one semaphore per queue, every submission signals the next value and other queues wait on values
+typedef struct wn_timeline_t
+{
+    VkSemaphore semaphore;
+    uint64_t value; // signaled by the latest submission
+} wn_timeline_t;
+
+// heap allocated, see wn_device_t
+wn_timeline_t* wn_timeline_new(VkDevice device)
+{
+    wn_timeline_t* timeline = malloc(sizeof(wn_timeline_t));
+    assert(timeline);
+    *timeline = (wn_timeline_t) { 0 };
+
+    VkSemaphoreTypeCreateInfo type_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_info,
+    };
+    WN_VK_CHECK(vkCreateSemaphore(device, &semaphore_info, NULL, &timeline->semaphore));
+
+    return timeline;
+}
+
+void wn_timeline_destroy(wn_timeline_t* timeline, VkDevice device)
+{
+    vkDestroySemaphore(device, timeline->semaphore, NULL);
+    free(timeline);
+}
+
+// whether the submission that signals value is done, never blocks
+bool wn_timeline_reached(const wn_timeline_t* timeline, VkDevice device, uint64_t value)
+{
+    uint64_t done = 0;
+    WN_VK_CHECK(vkGetSemaphoreCounterValue(device, timeline->semaphore, &done));
+    return done >= value;
+}
+
+// blocks until the submission that signals value is done, 0 never blocks
+void wn_timeline_wait(const wn_timeline_t* timeline, VkDevice device, uint64_t value)
+{
+    // nothing will ever signal a value past the last submission
+    assert(value <= timeline->value);
+
+    VkSemaphoreWaitInfo wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &timeline->semaphore,
+        .pValues = &value,
+    };
+    WN_VK_CHECK(vkWaitSemaphores(device, &wait_info, UINT64_MAX));
+}
+
 typedef struct wn_device_t
 {
     VkDevice device;
@@ -589,13 +564,65 @@ typedef struct wn_device_t
     VkQueue compute_queue;
     VkQueue transfer_queue;
 
+    // every distinct family a queue was created on, see wn_device_share_buffer
+    uint32_t queue_families[3];
+    uint32_t n_queue_families;
+
     VkPhysicalDevice gpu;
 
     VkPhysicalDeviceProperties gpu_properties;
     VkPhysicalDeviceFeatures gpu_features;
     VkPhysicalDeviceMemoryProperties gpu_memory_properties;
+
+    VkFormat depth_format; // best depth attachment format the gpu supports
+
+    // every buffer and image is suballocated from it
+    wn_gpu_allocator_t* allocator;
+
+    // one per queue, "done with value n" means the same thing everywhere. Heap allocated, the
+    // staging ring points at them. Queues shared between families still count separately
+    wn_timeline_t* graphics_timeline;
+    wn_timeline_t* compute_timeline;
+    wn_timeline_t* transfer_timeline;
 } wn_device_t;
 
+// depth-only formats first, stencil is never used
+VkFormat wn_find_depth_format(VkPhysicalDevice gpu)
+{
+    const VkFormat candidates[] = {
+        VK_FORMAT_D32_SFLOAT,
+        VK_FORMAT_X8_D24_UNORM_PACK32,
+        VK_FORMAT_D32_SFLOAT_S8_UINT,
+        VK_FORMAT_D24_UNORM_S8_UINT,
+        VK_FORMAT_D16_UNORM,
+    };
+
+    for (uint32_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++)
+    {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(gpu, candidates[i], &props);
+        if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        {
+            return candidates[i];
+        }
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+VkImageAspectFlags wn_depth_format_aspects(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    }
+}
+
 wn_device_t wn_device_new(VkPhysicalDevice gpu)
 {
     wn_device_t device = { 0 };
@@ -608,11 +635,18 @@ wn_device_t wn_device_new(VkPhysicalDevice gpu)
 
     device.qfi = wn_find_queue_families(gpu);
 
+    device.depth_format = wn_find_depth_format(gpu);
+    if (device.depth_format == VK_FORMAT_UNDEFINED)
+    {
+        log_fatal("no supported depth attachment format");
+        exit(EXIT_FAILURE);
+    }
+
     const float default_queue_prio = 0.0f;
 
     // FIXME: hardcoded bad, there could be any number of acual queues based on how many are
     // available in the queue family and if it is even more efficient to do so
-    VkDeviceQueueCreateInfo queue_infos[] = { {
+    VkDeviceQueueCreateInfo queue_infos[3] = { {
         .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
         .queueCount = 1,
         .queueFamilyIndex = device.qfi.graphics,
@@ -620,30 +654,36 @@ wn_device_t wn_device_new(VkPhysicalDevice gpu)
         .flags = 0,
         .pNext = NULL,
     } };
-#if 0
+    uint32_t n_queue_infos = 1;
+    // dedicated transfer family if there is one, uploads run on it next to rendering
+    if (device.qfi.transfer != device.qfi.graphics)
     {
-        VkDeviceQueueCreateInfo queue_info = {
+        queue_infos[n_queue_infos++] = (VkDeviceQueueCreateInfo) {
             .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
             .queueCount = 1,
-            .queueFamilyIndex = device.qfi.compute,
+            .queueFamilyIndex = device.qfi.transfer,
             .pQueuePriorities = &default_queue_prio,
             .flags = 0,
             .pNext = NULL,
         };
-        queue_infos[1] = queue_info;
     }
+    // same for compute, async compute work then overlaps rasterization
+    if (device.qfi.compute != device.qfi.graphics)
     {
-        VkDeviceQueueCreateInfo queue_info = {
+        queue_infos[n_queue_infos++] = (VkDeviceQueueCreateInfo) {
             .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
             .queueCount = 1,
-            .queueFamilyIndex = device.qfi.transfer,
+            .queueFamilyIndex = device.qfi.compute,
             .pQueuePriorities = &default_queue_prio,
             .flags = 0,
             .pNext = NULL,
         };
-        queue_infos[2] = queue_info;
     }
-#endif
+    for (uint32_t i = 0; i < n_queue_infos; i++)
+    {
+        device.queue_families[i] = queue_infos[i].queueFamilyIndex;
+    }
+    device.n_queue_families = n_queue_infos;
 
     // FIXME: placeholder, you just have to check if feature requests are supported somehow
     if (!device.gpu_features.samplerAnisotropy)
@@ -651,39 +691,103 @@ wn_device_t wn_device_new(VkPhysicalDevice gpu)
         log_fatal("sampler anisotropy not supported on gpu");
         exit(EXIT_FAILURE);
     }
+    // triangle.frag writes the mip streaming feedback with an atomic
+    if (!device.gpu_features.fragmentStoresAndAtomics)
+    {
+        log_fatal("fragment stores and atomics not supported on gpu");
+        exit(EXIT_FAILURE);
+    }
+    VkPhysicalDeviceVulkan12Features features_12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+    };
+    VkPhysicalDeviceFeatures2 features_2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &features_12,
+    };
+    vkGetPhysicalDeviceFeatures2(gpu, &features_2);
+    if (!features_12.timelineSemaphore)
+    {
+        log_fatal("timeline semaphores not supported on gpu");
+        exit(EXIT_FAILURE);
+    }
+
     VkPhysicalDeviceFeatures enabled_features = {
         .samplerAnisotropy = true,
+        .fragmentStoresAndAtomics = true,
+        .textureCompressionBC = device.gpu_features.textureCompressionBC,
+    };
+    // cross queue dependencies (async compute) wait on timeline values
+    VkPhysicalDeviceVulkan12Features enabled_features_12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .timelineSemaphore = true,
     };
-    const char* device_exts = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    const char* device_exts[2] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    uint32_t n_device_exts = 1;
+
+    // lets the allocator see how much vram the driver grants the process, see wn_draw
+    bool has_memory_budget = false;
+    uint32_t n_available_exts = 0;
+    vkEnumerateDeviceExtensionProperties(gpu, NULL, &n_available_exts, NULL);
+    VkExtensionProperties* available_exts
+        = malloc(sizeof(VkExtensionProperties) * n_available_exts);
+    assert(available_exts);
+    vkEnumerateDeviceExtensionProperties(gpu, NULL, &n_available_exts, available_exts);
+    for (uint32_t i = 0; i < n_available_exts; i++)
+    {
+        if (strcmp(available_exts[i].extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+        {
+            has_memory_budget = true;
+            device_exts[n_device_exts++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+        }
+    }
+    free(available_exts);
 
     VkDeviceCreateInfo device_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .pQueueCreateInfos = queue_infos,
-        .queueCreateInfoCount = 1,
+        .queueCreateInfoCount = n_queue_infos,
         .pEnabledFeatures = &enabled_features,
-        .enabledExtensionCount = 1,
-        .ppEnabledExtensionNames = &device_exts,
+        .enabledExtensionCount = n_device_exts,
+        .ppEnabledExtensionNames = device_exts,
         // NOTE: this may not be compatible with < 1.2 vulkan implementation
         .enabledLayerCount = 0,
         .ppEnabledLayerNames = NULL,
         .flags = 0,
-        .pNext = NULL,
+        .pNext = &enabled_features_12,
     };
 
     WN_VK_CHECK(vkCreateDevice(gpu, &device_info, NULL, &device.device));
 
+    device.allocator = malloc(sizeof(wn_gpu_allocator_t));
+    assert(device.allocator);
+    wn_gpu_allocator_init(device.allocator, device.device, gpu, has_memory_budget);
+
+    device.graphics_timeline = wn_timeline_new(device.device);
+    device.compute_timeline = wn_timeline_new(device.device);
+    device.transfer_timeline = wn_timeline_new(device.device);
+
     log_info("Getting graphics device queue at idx: %d", device.qfi.graphics);
     vkGetDeviceQueue(device.device, device.qfi.graphics, 0, &device.graphics_queue);
-#if 0
-    log_info("Getting compute device queue at idx: %d", device.qfi.compute);
-    vkGetDeviceQueue(device.device, device.qfi.compute, 0, &device.compute_queue);
-    log_info("Getting transfer device queue at idx: %d", device.qfi.transfer);
-    vkGetDeviceQueue(device.device, device.qfi.transfer, 0, &device.transfer_queue);
-#endif
+    if (device.qfi.transfer != device.qfi.graphics)
+    {
+        log_info("Getting transfer device queue at idx: %d", device.qfi.transfer);
+        vkGetDeviceQueue(device.device, device.qfi.transfer, 0, &device.transfer_queue);
+    }
+    else
+    {
+        device.transfer_queue = device.graphics_queue;
+    }
+    if (device.qfi.compute != device.qfi.graphics)
+    {
+        log_info("Getting compute device queue at idx: %d", device.qfi.compute);
+        vkGetDeviceQueue(device.device, device.qfi.compute, 0, &device.compute_queue);
+    }
+    else
+    {
+        device.compute_queue = device.graphics_queue;
+    }
     // FIXME: figure out queue stuff, queueIndex in above must be unique, but some devices don't
     // have multiple unique queues for any given queueFamilyIndex
-    device.compute_queue = device.graphics_queue;
-    device.transfer_queue = device.graphics_queue;
     device.present_queue = NULL;
 
     return device;
@@ -691,24 +795,31 @@ wn_device_t wn_device_new(VkPhysicalDevice gpu)
 
 void wn_device_destroy(wn_device_t* device)
 {
+    wn_timeline_destroy(device->graphics_timeline, device->device);
+    wn_timeline_destroy(device->compute_timeline, device->device);
+    wn_timeline_destroy(device->transfer_timeline, device->device);
+    wn_gpu_allocator_shutdown(device->allocator);
+    free(device->allocator);
     vkDestroyDevice(device->device, NULL);
 }
 
 typedef struct wn_buffer_t
 {
     VkBuffer handle;
-    VkDeviceMemory memory;
+    wn_gpu_allocation_t allocation;
     VkDeviceSize size;
     VkBufferUsageFlags usage;
     VkSharingMode sharing_mode;
 } wn_buffer_t;
 
+// memory gets every required and as many preferred property flags as the device offers
 wn_buffer_t wn_buffer_new(
     const wn_device_t* device,
     VkBufferCreateInfo* info,
-    VkMemoryPropertyFlags properties)
+    VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred,
+    wn_gpu_memory_category category)
 {
-
     wn_buffer_t buffer = { 0 };
 
     buffer.size = info->size;
@@ -720,61 +831,145 @@ wn_buffer_t wn_buffer_new(
     VkMemoryRequirements mem_reqs;
     vkGetBufferMemoryRequirements(device->device, buffer.handle, &mem_reqs);
 
-    uint32_t mem_idx = 0;
-    bool mem_type_found = false;
-    fflush(NULL);
-    for (uint32_t i = 0; i < device->gpu_memory_properties.memoryTypeCount; i++)
+    if (wn_gpu_alloc(
+            device->allocator,
+            &mem_reqs,
+            required,
+            preferred,
+            WN_GPU_MEMORY_LINEAR,
+            category,
+            &buffer.allocation)
+        != WN_OK)
     {
-        if (!mem_type_found)
-        {
-            if (((mem_reqs.memoryTypeBits & 1) == 1)
-                && (device->gpu_memory_properties.memoryTypes[i].propertyFlags & properties))
-            {
-                mem_idx = i;
-                mem_type_found = true;
-            }
-        }
+        log_fatal("Could not allocate %llu bytes for a buffer", (unsigned long long)mem_reqs.size);
+        exit(EXIT_FAILURE);
     }
 
-    if (!mem_type_found)
+    WN_VK_CHECK(vkBindBufferMemory(
+        device->device,
+        buffer.handle,
+        buffer.allocation.memory,
+        buffer.allocation.offset));
+
+    return buffer;
+}
+
+// makes a buffer usable from every queue family of the device without ownership transfers, for
+// small data passed between queues every frame
+void wn_device_share_buffer(const wn_device_t* device, VkBufferCreateInfo* info)
+{
+    if (device->n_queue_families > 1)
     {
-        log_fatal("No appropriate memory type could be found");
-        exit(EXIT_FAILURE);
+        info->sharingMode = VK_SHARING_MODE_CONCURRENT;
+        info->queueFamilyIndexCount = device->n_queue_families;
+        info->pQueueFamilyIndices = device->queue_families;
     }
+}
+
+void wn_buffer_destroy(wn_buffer_t* buffer, VkDevice logical_device)
+{
+    vkDestroyBuffer(logical_device, buffer->handle, NULL);
+    wn_gpu_free(&buffer->allocation);
+}
+
+/*
+ * Per-frame uniform data. One persistently mapped buffer holds a range per frame in flight, each
+ * reset once the frame's draw is done on the gpu and bump allocated after. Everything is bound
+ * through dynamic uniform buffer descriptors pointing at the whole buffer, the offset an
+ * allocation returns is the dynamic offset to bind it with.
+ */
+typedef struct wn_uniform_arena_t
+{
+    wn_buffer_t buffer;
+    uint8_t* mapped;
+    VkDeviceSize frame_size;
+    VkDeviceSize alignment; // minUniformBufferOffsetAlignment
+    uint32_t frame;
+    VkDeviceSize head; // within the current frame's range
+} wn_uniform_arena_t;
+
+wn_uniform_arena_t wn_uniform_arena_new(const wn_device_t* device, VkDeviceSize frame_size)
+{
+    wn_uniform_arena_t arena = {
+        .alignment = device->gpu_properties.limits.minUniformBufferOffsetAlignment,
+    };
+    arena.frame_size = (frame_size + arena.alignment - 1) / arena.alignment * arena.alignment;
 
-    VkMemoryAllocateInfo alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = mem_reqs.size,
-        .memoryTypeIndex = mem_idx,
+    // read by the graphics and the compute queue
+    VkBufferCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = arena.frame_size * MAX_FRAMES_IN_FLIGHT,
+        .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .flags = 0,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
         .pNext = NULL,
     };
+    wn_device_share_buffer(device, &info);
+    // written by the cpu every frame, straight into vram where the BAR allows it
+    arena.buffer = wn_buffer_new(
+        device,
+        &info,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        WN_GPU_MEMORY_CATEGORY_UNIFORM);
+    arena.mapped = arena.buffer.allocation.mapped;
 
-    WN_VK_CHECK(vkAllocateMemory(device->device, &alloc_info, NULL, &buffer.memory));
+    return arena;
+}
 
-    WN_VK_CHECK(vkBindBufferMemory(device->device, buffer.handle, buffer.memory, 0));
+// dynamic offset of the first allocation of frame
+static inline uint32_t wn_uniform_arena_base(const wn_uniform_arena_t* arena, uint32_t frame)
+{
+    return (uint32_t)(arena->frame_size * frame);
+}
 
-    return buffer;
+// only once the gpu is done with whatever frame last used this range
+void wn_uniform_arena_begin(wn_uniform_arena_t* arena, uint32_t frame)
+{
+    arena->frame = frame;
+    arena->head = 0;
 }
 
-void wn_buffer_destroy(wn_buffer_t* buffer, VkDevice logical_device)
+void* wn_uniform_arena_alloc(wn_uniform_arena_t* arena, VkDeviceSize size, uint32_t* offset)
 {
-    vkDestroyBuffer(logical_device, buffer->handle, NULL);
-    vkFreeMemory(logical_device, buffer->memory, NULL);
+    VkDeviceSize start = (arena->head + arena->alignment - 1) / arena->alignment * arena->alignment;
+    if (start + size > arena->frame_size)
+    {
+        log_fatal(
+            "%zu bytes of uniforms do not fit the %zu KiB left this frame",
+            (size_t)size,
+            (size_t)(arena->frame_size - start) / 1024);
+        exit(EXIT_FAILURE);
+    }
+    arena->head = start + size;
+
+    *offset = wn_uniform_arena_base(arena, arena->frame) + (uint32_t)start;
+    return arena->mapped + *offset;
+}
+
+void wn_uniform_arena_destroy(wn_uniform_arena_t* arena, VkDevice device)
+{
+    wn_buffer_destroy(&arena->buffer, device);
 }
 
 typedef struct wn_image_t
 {
     VkImage handle;
-    VkDeviceMemory memory;
+    wn_gpu_allocation_t allocation;
     VkDeviceSize size;
     VkFormat format;
     VkImageLayout layout;
+    uint32_t n_mips;
 } wn_image_t;
 
 wn_image_t wn_image_new(
     const wn_device_t* device,
     VkImageCreateInfo* info,
-    VkMemoryPropertyFlags properties)
+    VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred,
+    wn_gpu_memory_category category)
 {
     wn_image_t image = { 0 };
 
@@ -783,31 +978,32 @@ wn_image_t wn_image_new(
     VkMemoryRequirements mem_reqs = { 0 };
     vkGetImageMemoryRequirements(device->device, image.handle, &mem_reqs);
 
-    // NOTE: duplicated x2
-    uint32_t mem_idx = 0;
-    for (uint32_t i = 0; i < device->gpu_memory_properties.memoryTypeCount; i++)
+    wn_gpu_memory_kind kind = info->tiling == VK_IMAGE_TILING_LINEAR ? WN_GPU_MEMORY_LINEAR
+                                                                      : WN_GPU_MEMORY_OPTIMAL;
+    if (wn_gpu_alloc(
+            device->allocator,
+            &mem_reqs,
+            required,
+            preferred,
+            kind,
+            category,
+            &image.allocation)
+        != WN_OK)
     {
-        if ((mem_reqs.memoryTypeBits & (1 << i))
-            && (device->gpu_memory_properties.memoryTypes[i].propertyFlags & properties))
-        {
-            mem_idx = i;
-        }
+        log_fatal("Could not allocate %llu bytes for an image", (unsigned long long)mem_reqs.size);
+        exit(EXIT_FAILURE);
     }
 
-    VkMemoryAllocateInfo alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = mem_reqs.size,
-        .memoryTypeIndex = mem_idx,
-        .pNext = NULL,
-    };
-
-    WN_VK_CHECK(vkAllocateMemory(device->device, &alloc_info, NULL, &image.memory));
-
-    WN_VK_CHECK(vkBindImageMemory(device->device, image.handle, image.memory, 0));
+    WN_VK_CHECK(vkBindImageMemory(
+        device->device,
+        image.handle,
+        image.allocation.memory,
+        image.allocation.offset));
 
     image.size = mem_reqs.size;
     image.format = info->format;
     image.layout = info->initialLayout;
+    image.n_mips = info->mipLevels;
 
     return image;
 }
@@ -815,56 +1011,231 @@ wn_image_t wn_image_new(
 void wn_image_destroy(wn_image_t* image, VkDevice device)
 {
     vkDestroyImage(device, image->handle, NULL);
-    vkFreeMemory(device, image->memory, NULL);
+    wn_gpu_free(&image->allocation);
 }
 
-// FIXME: bad function but the general idea is fine, reliance on wn_begin/end_command_buffer
-void wn_transition_image_layout(
-    const wn_device_t* device,
-    VkCommandPool command_pool,
-    wn_image_t* image,
-    VkImageLayout layout)
+static VkAccessFlags wn_layout_access(VkImageLayout layout)
 {
-    VkCommandBuffer cmd = wn_begin_command_buffer(device->device, command_pool);
+    switch (layout)
+    {
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+        return VK_ACCESS_TRANSFER_WRITE_BIT;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+        return VK_ACCESS_TRANSFER_READ_BIT;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+        return VK_ACCESS_SHADER_READ_BIT;
+    default:
+        return 0;
+    }
+}
 
+// records the transition of mips [base_mip, base_mip + n_mips) of a color image, access masks
+// follow from the layouts
+static void wn_cmd_mip_barrier(
+    VkCommandBuffer cmd,
+    const wn_image_t* image,
+    uint32_t base_mip,
+    uint32_t n_mips,
+    VkImageLayout old_layout,
+    VkImageLayout layout,
+    VkPipelineStageFlags src_stage,
+    VkPipelineStageFlags dst_stage)
+{
     VkImageMemoryBarrier barrier = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .image = image->handle,
-        .oldLayout = image->layout,
+        .oldLayout = old_layout,
         .newLayout = layout,
         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
         .subresourceRange = {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
+            .baseMipLevel = base_mip,
+            .levelCount = n_mips,
             .baseArrayLayer = 0,
             .layerCount = 1,
         },
-        .srcAccessMask = 0,
-        .dstAccessMask = 0,
+        .srcAccessMask = wn_layout_access(old_layout),
+        .dstAccessMask = wn_layout_access(layout),
+        .pNext = NULL,
+    };
+
+    vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+/*
+ *  staging ring
+ *
+ *  One persistently mapped host buffer every upload is copied through. A batch is two command
+ *  buffers: copies go to the transfer queue, which releases what it wrote to the graphics queue,
+ *  and everything that needs the graphics queue (acquires, blits, copies out of sampled images,
+ *  final layouts) goes to the graphics one, which waits on the transfer timeline value the
+ *  transfer submission signals. With no dedicated transfer family both go to the graphics queue
+ *  and the ownership transfers are plain barriers. The graphics timeline reaching the graphics
+ *  submission's value retires the ring space the batch used. Offsets are virtual and only ever
+ *  grow, the physical offset is the virtual one modulo the ring size, so [tail, head) is
+ *  everything still in use.
+ */
+typedef struct wn_staging_batch_t
+{
+    VkCommandBuffer cmd;
+    VkCommandBuffer graphics_cmd;
+    uint64_t graphics_value; // done on both queues once the graphics timeline reaches it
+    uint64_t end; // virtual ring offset just past the batch's data
+} wn_staging_batch_t;
+
+typedef struct wn_staging_t
+{
+    wn_buffer_t buffer;
+    uint8_t* mapped;
+    uint64_t head;
+    uint64_t tail;
+
+    VkQueue transfer_queue;
+    VkQueue graphics_queue;
+    uint32_t transfer_family;
+    uint32_t graphics_family;
+    wn_timeline_t* transfer_timeline;
+    wn_timeline_t* graphics_timeline; // shared with the frames
+    VkCommandPool command_pool;
+    VkCommandPool graphics_command_pool;
+
+    // open batch, NULL until something is recorded
+    VkCommandBuffer cmd;
+    VkCommandBuffer graphics_cmd;
+
+    wn_staging_batch_t* in_flight; // stbds array, oldest first
+    uint64_t n_flushed;
+    uint64_t n_retired;
+} wn_staging_t;
+
+wn_staging_t wn_staging_new(const wn_device_t* device, VkDeviceSize size)
+{
+    wn_staging_t staging = {
+        .transfer_queue = device->transfer_queue,
+        .graphics_queue = device->graphics_queue,
+        .transfer_family = device->qfi.transfer,
+        .graphics_family = device->qfi.graphics,
+        .transfer_timeline = device->transfer_timeline,
+        .graphics_timeline = device->graphics_timeline,
+    };
+
+    staging.buffer = wn_buffer_new(
+        device,
+        &(VkBufferCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = size,
+            .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .flags = 0,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = NULL,
+            .pNext = NULL,
+        },
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        0,
+        WN_GPU_MEMORY_CATEGORY_STAGING);
+
+    staging.mapped = staging.buffer.allocation.mapped;
+
+    VkCommandPoolCreateInfo command_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = staging.transfer_family,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .pNext = NULL,
+    };
+    WN_VK_CHECK(
+        vkCreateCommandPool(device->device, &command_pool_info, NULL, &staging.command_pool));
+
+    command_pool_info.queueFamilyIndex = staging.graphics_family;
+    WN_VK_CHECK(vkCreateCommandPool(
+        device->device,
+        &command_pool_info,
+        NULL,
+        &staging.graphics_command_pool));
+
+    return staging;
+}
+
+static void wn_staging_retire_oldest(wn_staging_t* staging, VkDevice device)
+{
+    wn_staging_batch_t batch = staging->in_flight[0];
+    stbds_arrdel(staging->in_flight, 0);
+
+    // the graphics submission waited on the transfer one, its value covers both
+    wn_timeline_wait(staging->graphics_timeline, device, batch.graphics_value);
+    vkFreeCommandBuffers(device, staging->command_pool, 1, &batch.cmd);
+    vkFreeCommandBuffers(device, staging->graphics_command_pool, 1, &batch.graphics_cmd);
+    staging->tail = batch.end;
+    staging->n_retired++;
+}
+
+static VkCommandBuffer wn_staging_begin(VkDevice device, VkCommandPool command_pool)
+{
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool,
+        .commandBufferCount = 1,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         .pNext = NULL,
     };
+    VkCommandBuffer cmd = NULL;
+    WN_VK_CHECK(vkAllocateCommandBuffers(device, &alloc_info, &cmd));
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = NULL,
+        .pNext = NULL,
+    };
+    WN_VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+    return cmd;
+}
+
+// transfer queue side of the open batch, copies out of the ring go here
+VkCommandBuffer wn_staging_cmd(wn_staging_t* staging, VkDevice device)
+{
+    if (!staging->cmd)
+    {
+        staging->cmd = wn_staging_begin(device, staging->command_pool);
+    }
+    return staging->cmd;
+}
+
+// graphics queue side of the open batch, runs after the transfer side
+VkCommandBuffer wn_staging_graphics_cmd(wn_staging_t* staging, VkDevice device)
+{
+    if (!staging->graphics_cmd)
+    {
+        staging->graphics_cmd = wn_staging_begin(device, staging->graphics_command_pool);
+    }
+    return staging->graphics_cmd;
+}
 
-    VkPipelineStageFlags source_stage = 0;
-    VkPipelineStageFlags dest_stage = 0;
+// records the transition of every mip into the graphics side of the open batch, it happens when
+// the batch is flushed
+void wn_transition_image_layout(
+    wn_staging_t* staging,
+    VkDevice device,
+    wn_image_t* image,
+    VkImageLayout layout)
+{
+    VkPipelineStageFlags src_stage = 0;
+    VkPipelineStageFlags dst_stage = 0;
 
     if (image->layout == VK_IMAGE_LAYOUT_UNDEFINED
         && layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
     {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dest_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
     }
     else if (
         image->layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
         && layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
     {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        dest_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     }
     else
     {
@@ -872,131 +1243,384 @@ void wn_transition_image_layout(
         exit(EXIT_FAILURE);
     }
 
-    vkCmdPipelineBarrier(cmd, source_stage, dest_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
-
-    wn_end_command_buffer(device->device, command_pool, cmd, device->graphics_queue);
+    wn_cmd_mip_barrier(
+        wn_staging_graphics_cmd(staging, device),
+        image,
+        0,
+        image->n_mips,
+        image->layout,
+        layout,
+        src_stage,
+        dst_stage);
 
     image->layout = layout;
 }
 
-typedef struct wn_texture_t
+static bool wn_staging_transfers_ownership(const wn_staging_t* staging)
 {
-    wn_image_t image;
-    VkImageView view;
-    VkSampler sampler;
-} wn_texture_t;
+    return staging->transfer_family != staging->graphics_family;
+}
 
-wn_texture_t wn_texture_new(
-    const wn_device_t* device,
-    VkCommandPool command_pool,
-    const char* filename)
+// hands mips of an image the transfer side wrote over to the graphics side, keeping its layout
+void wn_staging_handoff_image(
+    wn_staging_t* staging,
+    VkDevice device,
+    const wn_image_t* image,
+    uint32_t base_mip,
+    uint32_t n_mips,
+    VkImageLayout layout)
 {
-    wn_texture_t texture = { 0 };
+    bool transfer = wn_staging_transfers_ownership(staging);
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image = image->handle,
+        .oldLayout = layout,
+        .newLayout = layout,
+        .srcQueueFamilyIndex = transfer ? staging->transfer_family : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = transfer ? staging->graphics_family : VK_QUEUE_FAMILY_IGNORED,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = base_mip,
+            .levelCount = n_mips,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = 0,
+        .pNext = NULL,
+    };
 
-    int width, height, channels;
-    uint8_t* image_data = stbi_load(filename, &width, &height, &channels, STBI_rgb_alpha);
+    if (transfer)
+    {
+        vkCmdPipelineBarrier(
+            wn_staging_cmd(staging, device),
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0,
+            NULL,
+            0,
+            NULL,
+            1,
+            &barrier);
+    }
 
-    VkDeviceSize size = width * height * STBI_rgb_alpha;
+    // acquire, or a plain barrier on a single queue
+    barrier.srcAccessMask = transfer ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = wn_layout_access(layout);
+    vkCmdPipelineBarrier(
+        wn_staging_graphics_cmd(staging, device),
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0,
+        NULL,
+        0,
+        NULL,
+        1,
+        &barrier);
+}
 
-    VkBufferCreateInfo bi = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+// same for a buffer range, anything on the graphics queue may read it afterwards
+void wn_staging_handoff_buffer(
+    wn_staging_t* staging,
+    VkDevice device,
+    const wn_buffer_t* buffer,
+    VkDeviceSize offset,
+    VkDeviceSize size)
+{
+    // concurrent buffers have no owner to transfer
+    bool transfer = wn_staging_transfers_ownership(staging)
+                    && buffer->sharing_mode == VK_SHARING_MODE_EXCLUSIVE;
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .buffer = buffer->handle,
+        .offset = offset,
         .size = size,
-        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        .flags = 0,
-        .queueFamilyIndexCount = 0,
-        .pQueueFamilyIndices = NULL,
+        .srcQueueFamilyIndex = transfer ? staging->transfer_family : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = transfer ? staging->graphics_family : VK_QUEUE_FAMILY_IGNORED,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = 0,
         .pNext = NULL,
     };
 
-    wn_buffer_t staging = wn_buffer_new(
-        device,
-        &bi,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (transfer)
+    {
+        vkCmdPipelineBarrier(
+            wn_staging_cmd(staging, device),
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0,
+            NULL,
+            1,
+            &barrier,
+            0,
+            NULL);
+    }
 
-    void* data = NULL;
-    WN_VK_CHECK(vkMapMemory(device->device, staging.memory, 0, size, 0, &data));
-    memcpy(data, image_data, (size_t)size);
-    vkUnmapMemory(device->device, staging.memory);
+    barrier.srcAccessMask = transfer ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(
+        wn_staging_graphics_cmd(staging, device),
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        0,
+        NULL,
+        1,
+        &barrier,
+        0,
+        NULL);
+}
 
-    stbi_image_free(image_data);
+/*
+ * Submits the open batch without waiting for it and returns its number for wn_staging_done. Later
+ * graphics queue submissions see everything it wrote.
+ */
+uint64_t wn_staging_flush(wn_staging_t* staging, VkDevice device)
+{
+    if (!staging->cmd && !staging->graphics_cmd)
+    {
+        return staging->n_flushed;
+    }
 
-    // TODO: in actual api this would obv need to be parameterized (i.e. normal map texture
-    // format would be different) the format is also not guaranteed to be supported, so caching
-    // supported formats per gpu is probably a good idea
-    VkImageCreateInfo tex_info = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-        .imageType = VK_IMAGE_TYPE_2D,
-        .format = VK_FORMAT_R8G8B8A8_SRGB,
-        .extent = {
-            .width = width,
-            .height = height,
-            .depth = 1,
+    // keeps both sides of a batch present, retiring doesn't have to special case anything
+    VkCommandBuffer cmd = wn_staging_cmd(staging, device);
+    VkCommandBuffer graphics_cmd = wn_staging_graphics_cmd(staging, device);
+
+    vkCmdPipelineBarrier(
+        graphics_cmd,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        1,
+        &(VkMemoryBarrier) {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
         },
-        .mipLevels = 1,
-        .arrayLayers = 1,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .tiling = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        .queueFamilyIndexCount = 0,
-        .pQueueFamilyIndices = NULL,
-        .flags = 0,
-        .pNext = NULL,
+        0,
+        NULL,
+        0,
+        NULL);
+    WN_VK_CHECK(vkEndCommandBuffer(cmd));
+    WN_VK_CHECK(vkEndCommandBuffer(graphics_cmd));
+
+    wn_staging_batch_t batch = {
+        .cmd = cmd,
+        .graphics_cmd = graphics_cmd,
+        .end = staging->head,
     };
 
-    texture.image = wn_image_new(device, &tex_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    uint64_t transfer_value = ++staging->transfer_timeline->value;
+    VkTimelineSemaphoreSubmitInfo transfer_timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &transfer_value,
+    };
+    VkSubmitInfo transfer_submit = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &transfer_timeline_info,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch.cmd,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &staging->transfer_timeline->semaphore,
+    };
+    WN_VK_CHECK(vkQueueSubmit(staging->transfer_queue, 1, &transfer_submit, VK_NULL_HANDLE));
+
+    batch.graphics_value = ++staging->graphics_timeline->value;
+    VkTimelineSemaphoreSubmitInfo graphics_timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = 1,
+        .pWaitSemaphoreValues = &transfer_value,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &batch.graphics_value,
+    };
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo graphics_submit = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &graphics_timeline_info,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &staging->transfer_timeline->semaphore,
+        .pWaitDstStageMask = &wait_stage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch.graphics_cmd,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &staging->graphics_timeline->semaphore,
+    };
+    WN_VK_CHECK(vkQueueSubmit(staging->graphics_queue, 1, &graphics_submit, VK_NULL_HANDLE));
 
-    wn_transition_image_layout(
-        device,
-        command_pool,
-        &texture.image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    stbds_arrput(staging->in_flight, batch);
+    staging->cmd = NULL;
+    staging->graphics_cmd = NULL;
+    return ++staging->n_flushed;
+}
 
-    VkCommandBuffer cmd = wn_begin_command_buffer(device->device, command_pool);
+// whether the batch wn_staging_flush numbered so is done, never blocks
+bool wn_staging_done(wn_staging_t* staging, VkDevice device, uint64_t batch)
+{
+    while (stbds_arrlen(staging->in_flight) > 0
+           && wn_timeline_reached(
+               staging->graphics_timeline,
+               device,
+               staging->in_flight[0].graphics_value))
+    {
+        wn_staging_retire_oldest(staging, device);
+    }
+    return staging->n_retired >= batch;
+}
 
-    VkBufferImageCopy copy_region = {
-        .bufferOffset = 0,
-        .bufferRowLength = 0,
-        .bufferImageHeight = 0,
-        .imageSubresource = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .mipLevel = 0,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
-        .imageOffset = {0},
-        .imageExtent = {
-            .width = width,
-            .height = height,
-            .depth = 1,
-        },
-    };
+// flushes and blocks until every upload so far is done
+void wn_staging_wait(wn_staging_t* staging, VkDevice device)
+{
+    wn_staging_flush(staging, device);
+    while (stbds_arrlen(staging->in_flight) > 0)
+    {
+        wn_staging_retire_oldest(staging, device);
+    }
+}
 
-    vkCmdCopyBufferToImage(
-        cmd,
-        staging.handle,
-        texture.image.handle,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &copy_region);
+/*
+ * Reserves size bytes of the ring, aligned for any buffer to image copy of the formats used here,
+ * and returns where to write them. offset is what the copy reads from staging->buffer. Only blocks
+ * when the space is still in use by a submitted batch, or by the open one which is flushed then,
+ * so get the batch's command buffers after allocating.
+ */
+void* wn_staging_alloc(
+    wn_staging_t* staging,
+    VkDevice device,
+    VkDeviceSize size,
+    VkDeviceSize* offset)
+{
+    const uint64_t capacity = staging->buffer.size;
+    if (size > capacity)
+    {
+        log_fatal(
+            "upload of %zu KiB does not fit the %zu KiB staging ring",
+            (size_t)size / 1024,
+            (size_t)capacity / 1024);
+        exit(EXIT_FAILURE);
+    }
 
-    wn_end_command_buffer(device->device, command_pool, cmd, device->transfer_queue);
+    // retire whatever already finished without blocking
+    wn_staging_done(staging, device, 0);
 
-    wn_buffer_destroy(&staging, device->device);
+    uint64_t start = (staging->head + 15) & ~(uint64_t)15;
+    if (start % capacity + size > capacity)
+    {
+        // doesn't fit before the end, skip to the start of the ring
+        start += capacity - start % capacity;
+    }
 
-    wn_transition_image_layout(
-        device,
-        command_pool,
-        &texture.image,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    while (start + size - staging->tail > capacity)
+    {
+        if (stbds_arrlen(staging->in_flight) == 0)
+        {
+            wn_staging_flush(staging, device);
+            if (stbds_arrlen(staging->in_flight) == 0)
+            {
+                // nothing in use at all, the skipped bytes included
+                staging->tail = start;
+                break;
+            }
+        }
+        wn_staging_retire_oldest(staging, device);
+    }
+
+    staging->head = start + size;
+    *offset = start % capacity;
+    return staging->mapped + *offset;
+}
+
+void wn_staging_destroy(wn_staging_t* staging, VkDevice device)
+{
+    wn_staging_wait(staging, device);
+    stbds_arrfree(staging->in_flight);
+    vkDestroyCommandPool(device, staging->command_pool, NULL);
+    vkDestroyCommandPool(device, staging->graphics_command_pool, NULL);
+    wn_buffer_destroy(&staging->buffer, device);
+}
+
+// copies data to offset in a device local buffer through the staging ring, split into chunks if it
+// is larger than the ring. Doesn't wait for the copy
+void wn_buffer_upload(
+    const wn_device_t* device,
+    wn_staging_t* staging,
+    const wn_buffer_t* buffer,
+    VkDeviceSize offset,
+    const void* data,
+    VkDeviceSize size)
+{
+    const uint8_t* bytes = data;
+    while (size > 0)
+    {
+        VkDeviceSize chunk = size < staging->buffer.size ? size : staging->buffer.size;
+
+        VkDeviceSize staging_offset;
+        memcpy(
+            wn_staging_alloc(staging, device->device, chunk, &staging_offset),
+            bytes,
+            (size_t)chunk);
+
+        vkCmdCopyBuffer(
+            wn_staging_cmd(staging, device->device),
+            staging->buffer.handle,
+            buffer->handle,
+            1,
+            &(VkBufferCopy) { .srcOffset = staging_offset, .dstOffset = offset, .size = chunk });
+        wn_staging_handoff_buffer(staging, device->device, buffer, offset, chunk);
+
+        bytes += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+}
+
+// device local buffer filled through the staging ring (see wn_buffer_upload), shared between all
+// queue families since it's read by async compute
+wn_buffer_t wn_buffer_new_with_data(
+    const wn_device_t* device,
+    wn_staging_t* staging,
+    VkBufferUsageFlags usage,
+    wn_gpu_memory_category category,
+    const void* data,
+    VkDeviceSize size)
+{
+    VkBufferCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .flags = 0,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+        .pNext = NULL,
+    };
+    wn_device_share_buffer(device, &info);
+    wn_buffer_t buffer
+        = wn_buffer_new(device, &info, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, category);
+
+    wn_buffer_upload(device, staging, &buffer, 0, data, size);
+
+    return buffer;
+}
+
+typedef struct wn_texture_t
+{
+    wn_image_t image;
+    VkImageView view;
+    VkSampler sampler;
+} wn_texture_t;
 
+// view + sampler over every mip of texture->image
+static void wn_texture_create_view(const wn_device_t* device, wn_texture_t* texture)
+{
     VkImageViewCreateInfo view_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-        .image = texture.image.handle,
+        .image = texture->image.handle,
         .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .format = texture.image.format,
+        .format = texture->image.format,
         .components = {
             .r = VK_COMPONENT_SWIZZLE_R,
             .g = VK_COMPONENT_SWIZZLE_G,
@@ -1006,13 +1630,13 @@ wn_texture_t wn_texture_new(
         .subresourceRange = {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
             .baseMipLevel = 0,
-            .levelCount = 1,
+            .levelCount = texture->image.n_mips,
             .baseArrayLayer = 0,
             .layerCount = 1,
         },
     };
 
-    WN_VK_CHECK(vkCreateImageView(device->device, &view_info, NULL, &texture.view));
+    WN_VK_CHECK(vkCreateImageView(device->device, &view_info, NULL, &texture->view));
 
     VkSamplerCreateInfo sampler_info = {
         .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
@@ -1030,10 +1654,460 @@ wn_texture_t wn_texture_new(
         .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
         .mipLodBias = 0.0f,
         .minLod = 0.0f,
-        .maxLod = 0.0f,
+        .maxLod = (float)texture->image.n_mips,
+    };
+
+    WN_VK_CHECK(vkCreateSampler(device->device, &sampler_info, NULL, &texture->sampler));
+}
+
+// pixels are rgba8, decoding them is up to the caller (see wn_asset_decode). The upload is only
+// recorded into the staging batch, pixels can be freed right away
+wn_texture_t wn_texture_new(
+    const wn_device_t* device,
+    wn_staging_t* staging,
+    const uint8_t* pixels,
+    uint32_t width,
+    uint32_t height)
+{
+    wn_texture_t texture = { 0 };
+
+    // TODO: in actual api this would obv need to be parameterized (i.e. normal map texture
+    // format would be different) the format is also not guaranteed to be supported, so caching
+    // supported formats per gpu is probably a good idea
+    const VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    uint32_t n_mips = wn_image_mip_count(width, height);
+
+    // mips are blitted down from level 0 on the gpu, formats that can't be linearly blitted get
+    // their whole chain filtered on the cpu and uploaded level by level instead
+    const VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT
+                                             | VK_FORMAT_FEATURE_BLIT_DST_BIT
+                                             | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(device->gpu, format, &format_properties);
+    bool blit_mips = (format_properties.optimalTilingFeatures & blit_features) == blit_features;
+
+    // NOTE: the cpu chain is built in host memory, the filter reads back every level it writes
+    uint8_t* chain = NULL;
+    if (!blit_mips)
+    {
+        chain = malloc(wn_image_mip_chain_size(width, height, n_mips));
+        assert(chain);
+        memcpy(chain, pixels, (size_t)width * height * 4);
+        wn_image_build_mips_srgb(chain, width, height, n_mips);
+        pixels = chain;
+    }
+
+    VkImageCreateInfo tex_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = {
+            .width = width,
+            .height = height,
+            .depth = 1,
+        },
+        .mipLevels = n_mips,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+               | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+        .flags = 0,
+        .pNext = NULL,
+    };
+
+    texture.image = wn_image_new(
+        device,
+        &tex_info,
+        0,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        WN_GPU_MEMORY_CATEGORY_TEXTURE);
+
+    // the upload goes to the transfer side of the staging batch, the mip cascade to the graphics
+    // side since blits need a graphics queue
+    wn_cmd_mip_barrier(
+        wn_staging_cmd(staging, device->device),
+        &texture.image,
+        0,
+        n_mips,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    // one level at a time so only a single level has to fit into the ring
+    uint32_t n_copies = blit_mips ? 1 : n_mips;
+    const uint8_t* level = pixels;
+    for (uint32_t mip = 0; mip < n_copies; mip++)
+    {
+        uint32_t mip_width = wn_image_mip_extent(width, mip);
+        uint32_t mip_height = wn_image_mip_extent(height, mip);
+        size_t level_size = (size_t)mip_width * mip_height * 4;
+
+        VkDeviceSize staging_offset;
+        memcpy(
+            wn_staging_alloc(staging, device->device, level_size, &staging_offset),
+            level,
+            level_size);
+        level += level_size;
+
+        vkCmdCopyBufferToImage(
+            wn_staging_cmd(staging, device->device),
+            staging->buffer.handle,
+            texture.image.handle,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1,
+            &(VkBufferImageCopy) {
+                .bufferOffset = staging_offset,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = mip,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+                .imageOffset = {0},
+                .imageExtent = {
+                    .width = mip_width,
+                    .height = mip_height,
+                    .depth = 1,
+                },
+            });
+    }
+
+    free(chain);
+
+    wn_staging_handoff_image(
+        staging,
+        device->device,
+        &texture.image,
+        0,
+        n_mips,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    VkCommandBuffer cmd = wn_staging_graphics_cmd(staging, device->device);
+
+    if (blit_mips)
+    {
+        for (uint32_t mip = 1; mip < n_mips; mip++)
+        {
+            // the level above is complete, read from it and hand it over to the shaders once
+            // this level is blitted
+            wn_cmd_mip_barrier(
+                cmd,
+                &texture.image,
+                mip - 1,
+                1,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+            vkCmdBlitImage(
+                cmd,
+                texture.image.handle,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                texture.image.handle,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1,
+                &(VkImageBlit) {
+                    .srcSubresource = {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .mipLevel = mip - 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                    },
+                    .srcOffsets = {
+                        { 0, 0, 0 },
+                        {
+                            (int32_t)wn_image_mip_extent(width, mip - 1),
+                            (int32_t)wn_image_mip_extent(height, mip - 1),
+                            1,
+                        },
+                    },
+                    .dstSubresource = {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .mipLevel = mip,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                    },
+                    .dstOffsets = {
+                        { 0, 0, 0 },
+                        {
+                            (int32_t)wn_image_mip_extent(width, mip),
+                            (int32_t)wn_image_mip_extent(height, mip),
+                            1,
+                        },
+                    },
+                },
+                VK_FILTER_LINEAR);
+
+            wn_cmd_mip_barrier(
+                cmd,
+                &texture.image,
+                mip - 1,
+                1,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+
+        // smallest level was only ever written
+        wn_cmd_mip_barrier(
+            cmd,
+            &texture.image,
+            n_mips - 1,
+            1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+    else
+    {
+        wn_cmd_mip_barrier(
+            cmd,
+            &texture.image,
+            0,
+            n_mips,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    texture.image.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    log_info(
+        "Texture %ux%u: %u mips (%s)",
+        width,
+        height,
+        n_mips,
+        blit_mips ? "blitted" : "cpu filtered");
+
+    wn_texture_create_view(device, &texture);
+
+    return texture;
+}
+
+// formats a baked texture can be uploaded as, BC needs textureCompressionBC (enabled whenever the
+// gpu has it)
+bool wn_device_texture_format_supported(const wn_device_t* device, VkFormat format)
+{
+    if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK
+        && !device->gpu_features.textureCompressionBC)
+    {
+        return false;
+    }
+
+    const VkFormatFeatureFlags required
+        = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(device->gpu, format, &format_properties);
+    return (format_properties.optimalTilingFeatures & required) == required;
+}
+
+/*
+ * Baked block compressed texture holding mips [first_mip, n_mips) of file, image mip 0 being file
+ * mip first_mip. Levels an old texture of the same file already holds are copied over on the gpu,
+ * the rest comes straight from the mapping through the staging ring. old stays usable and is left
+ * for the caller to destroy once the staging batch is done with it.
+ */
+wn_texture_t wn_texture_new_baked(
+    const wn_device_t* device,
+    wn_staging_t* staging,
+    const wn_texture_file_t* file,
+    uint32_t first_mip,
+    const wn_texture_t* old)
+{
+    assert(first_mip < file->n_mips);
+
+    wn_texture_t texture = { 0 };
+    const uint32_t n_mips = file->n_mips - first_mip;
+    const uint32_t old_first_mip = old ? file->n_mips - old->image.n_mips : file->n_mips;
+    // [first_mip, copy_mip) is uploaded, [copy_mip, n_mips) copied from old
+    const uint32_t copy_mip = first_mip > old_first_mip ? first_mip : old_first_mip;
+
+    VkImageCreateInfo tex_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = (VkFormat)file->vk_format,
+        .extent = {
+            .width = wn_image_mip_extent(file->width, first_mip),
+            .height = wn_image_mip_extent(file->height, first_mip),
+            .depth = 1,
+        },
+        .mipLevels = n_mips,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        // TRANSFER_SRC so the next residency change can copy from it
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+            | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+        .flags = 0,
+        .pNext = NULL,
     };
 
-    WN_VK_CHECK(vkCreateSampler(device->device, &sampler_info, NULL, &texture.sampler));
+    texture.image = wn_image_new(
+        device,
+        &tex_info,
+        0,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        WN_GPU_MEMORY_CATEGORY_TEXTURE);
+
+    wn_cmd_mip_barrier(
+        wn_staging_cmd(staging, device->device),
+        &texture.image,
+        0,
+        n_mips,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    for (uint32_t mip = first_mip; mip < copy_mip; mip++)
+    {
+        VkDeviceSize staging_offset;
+        memcpy(
+            wn_staging_alloc(staging, device->device, file->levels[mip].size, &staging_offset),
+            wn_texture_file_level(file, mip),
+            file->levels[mip].size);
+
+        vkCmdCopyBufferToImage(
+            wn_staging_cmd(staging, device->device),
+            staging->buffer.handle,
+            texture.image.handle,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1,
+            &(VkBufferImageCopy) {
+                .bufferOffset = staging_offset,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = mip - first_mip,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+                .imageOffset = {0},
+                .imageExtent = {
+                    .width = wn_image_mip_extent(file->width, mip),
+                    .height = wn_image_mip_extent(file->height, mip),
+                    .depth = 1,
+                },
+            });
+    }
+
+    wn_staging_handoff_image(
+        staging,
+        device->device,
+        &texture.image,
+        0,
+        n_mips,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    // old is sampled by the graphics queue, so its levels are copied over there
+    VkCommandBuffer cmd = wn_staging_graphics_cmd(staging, device->device);
+
+    if (copy_mip < file->n_mips)
+    {
+        wn_cmd_mip_barrier(
+            cmd,
+            &old->image,
+            0,
+            old->image.n_mips,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkImageCopy copy_regions[WN_TEXTURE_MAX_MIPS];
+        for (uint32_t mip = copy_mip; mip < file->n_mips; mip++)
+        {
+            copy_regions[mip - copy_mip] = (VkImageCopy) {
+                .srcSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = mip - old_first_mip,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+                .srcOffset = {0},
+                .dstSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = mip - first_mip,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+                .dstOffset = {0},
+                .extent = {
+                    .width = wn_image_mip_extent(file->width, mip),
+                    .height = wn_image_mip_extent(file->height, mip),
+                    .depth = 1,
+                },
+            };
+        }
+
+        vkCmdCopyImage(
+            cmd,
+            old->image.handle,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            texture.image.handle,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            file->n_mips - copy_mip,
+            copy_regions);
+
+        // frames submitted until the new texture is swapped in still sample old
+        wn_cmd_mip_barrier(
+            cmd,
+            &old->image,
+            0,
+            old->image.n_mips,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    wn_cmd_mip_barrier(
+        cmd,
+        &texture.image,
+        0,
+        n_mips,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    texture.image.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    if (!old)
+    {
+        VkDeviceSize size = 0;
+        for (uint32_t mip = first_mip; mip < file->n_mips; mip++)
+        {
+            size += file->levels[mip].size;
+        }
+        log_info(
+            "Texture %ux%u: %s, %u/%u mips, %zu KiB (rgba8 %zu KiB)",
+            file->width,
+            file->height,
+            wn_texture_format_name(file->vk_format),
+            n_mips,
+            file->n_mips,
+            (size_t)size / 1024,
+            wn_image_mip_chain_size(file->width, file->height, file->n_mips) / 1024);
+    }
+
+    wn_texture_create_view(device, &texture);
 
     return texture;
 }
@@ -1045,6 +2119,86 @@ void wn_texture_destroy(wn_texture_t* texture, VkDevice device)
     vkDestroySampler(device, texture->sampler, NULL);
 }
 
+/*
+ * Baked texture whose finer mips are streamed in on demand. Residency is always a contiguous
+ * [resident_mip, n_mips) range so the image view simply starts at the finest resident mip, which
+ * also keeps the sampler from ever reaching a mip that isn't there.
+ */
+// swapped out, destroyed once the graphics timeline reaches the last frame that could sample it
+typedef struct wn_retired_texture_t
+{
+    wn_texture_t texture;
+    uint64_t graphics_value;
+} wn_retired_texture_t;
+
+typedef struct wn_texture_stream_t
+{
+    wn_texture_file_t file; // stays mapped to stream from, no mapping if not streamed
+    uint32_t tail_mip;      // this and coarser never get evicted
+    uint32_t resident_mip;
+    uint64_t last_used[WN_TEXTURE_MAX_MIPS]; // frame a mip was last asked for
+    uint64_t frame;
+    VkDeviceSize budget;
+
+    // residency change in flight on the staging ring, swapped in once its batch is done
+    bool has_pending;
+    wn_texture_t pending;
+    uint32_t pending_mip;
+    uint64_t pending_batch;
+
+    // bumped by every swap, frames point their descriptor set at the new texture when they see it
+    uint32_t n_swaps;
+    wn_retired_texture_t* retired; // stbds array
+} wn_texture_stream_t;
+
+// first mip that fits in TEXTURE_STREAM_TAIL_EXTENT
+static uint32_t wn_texture_stream_tail_mip(const wn_texture_file_t* file)
+{
+    uint32_t mip = 0;
+    while (mip + 1 < file->n_mips
+           && (wn_image_mip_extent(file->width, mip) > TEXTURE_STREAM_TAIL_EXTENT
+               || wn_image_mip_extent(file->height, mip) > TEXTURE_STREAM_TAIL_EXTENT))
+    {
+        mip++;
+    }
+    return mip;
+}
+
+// takes over the mapping of file, whose texture was created with only its tail resident
+wn_texture_stream_t wn_texture_stream_new(const wn_texture_file_t* file)
+{
+    wn_texture_stream_t stream = {
+        .file = *file,
+        .tail_mip = wn_texture_stream_tail_mip(file),
+        .budget = (VkDeviceSize)TEXTURE_STREAM_BUDGET_MB << 20,
+    };
+    stream.resident_mip = stream.tail_mip;
+
+    const char* budget_mb = getenv("WN_TEXTURE_BUDGET_MB");
+    if (budget_mb)
+    {
+        stream.budget = (VkDeviceSize)strtoull(budget_mb, NULL, 10) << 20;
+    }
+
+    log_info(
+        "Texture stream: %u mips, tail from mip %u, budget %zu KiB",
+        file->n_mips,
+        stream.tail_mip,
+        (size_t)(stream.budget >> 10));
+
+    return stream;
+}
+
+static VkDeviceSize wn_texture_stream_size(const wn_texture_stream_t* stream, uint32_t first_mip)
+{
+    VkDeviceSize size = 0;
+    for (uint32_t mip = first_mip; mip < stream->file.n_mips; mip++)
+    {
+        size += stream->file.levels[mip].size;
+    }
+    return size;
+}
+
 typedef struct wn_surface_t
 {
     VkSurfaceKHR surface;
@@ -1064,13 +2218,16 @@ typedef struct wn_frame_t
 {
     VkImage image;
     VkImageView image_view;
-    wn_image_t depth_image;
-    VkImageView
-        depth_image_view; // FIXME: texture_t has hardcoded format etc. becuase its temporary
     VkFramebuffer framebuffer;
-    wn_buffer_t ubo;
     VkDescriptorSet ubo_desc_set;
-    // VkCommandBuffer draw_buffer // TODO: maybe??
+    uint32_t texture_swaps; // color_stream.n_swaps when ubo_desc_set got color_texture
+    wn_buffer_t texture_feedback;
+    wn_texture_feedback_t* texture_feedback_data; // persistently mapped
+    // meshlet culling output of the frames drawn to this image, culling waits for the last one
+    wn_buffer_t cull_indices;
+    wn_buffer_t cull_draw;
+    VkDescriptorSet cull_desc_set;
+    uint64_t graphics_value; // graphics timeline value of the last frame drawn to this image
     // VkSemaphore image_available
 } wn_frame_t;
 
@@ -1079,6 +2236,10 @@ typedef struct wn_swapchain_t
     VkSwapchainKHR swapchain;
     uint32_t n_frames;
     wn_frame_t* frames;
+    // one for every image, frames are drawn in order on the graphics queue and the render pass
+    // waits for the previous depth writes before clearing it
+    wn_image_t depth_image;
+    VkImageView depth_image_view;
     VkDescriptorSetLayout desc_set_layout;
     VkDescriptorPool descriptor_pool; // FIXME: this is getting sloppy
 } wn_swapchain_t;
@@ -1093,26 +2254,57 @@ typedef struct wn_render_t
 
     wn_swapchain_t swapchain;
 
+    // binary, acquire and present take nothing else. Everything else waits on the timelines
     VkSemaphore* image_available;
     VkSemaphore* render_finished;
-    VkFence* in_flight;
-    VkFence* image_in_flight;
+    uint64_t frame_values[MAX_FRAMES_IN_FLIGHT]; // graphics timeline value of each frame's draw
     size_t current_frame;
+    uint64_t frame_number;
 
     VkRenderPass render_pass;
 
     VkPipelineLayout graphics_pipeline_layout;
     VkPipeline graphics_pipeline;
 
-    VkCommandPool command_pool;
-    VkCommandBuffer* command_buffers;
+    VkDescriptorSetLayout cull_desc_set_layout;
+    VkPipelineLayout cull_pipeline_layout;
+    VkPipeline cull_pipeline;
+
+    // everything is recorded every frame, the draw split over the job system into secondary
+    // command buffers. The uniforms of each frame in flight live at their own dynamic offset
+    wn_job_system_t* jobs; // heap allocated, the workers point at it
+    wn_command_pools_t commands; // a pool per job thread and frame in flight
+    // meshlet culling, on the compute family which is the graphics one if the gpu has no other
+    wn_command_pools_t compute_commands;
+    wn_draw_item_t* draws; // stbds array, rebuilt every frame
+
+    wn_staging_t staging;
+    wn_uniform_arena_t uniforms;
 
     wn_texture_t color_texture;
+    wn_texture_stream_t color_stream;
 
+    wn_mesh_arena_t* mesh_arena; // heap allocated, arena meshes point at it
     wn_mesh_t mesh;
+    uint32_t mesh_lod;
 
+    wn_vertex_layout_t vertex_layout;
+    VkIndexType index_type;
+    uint32_t index_size;
+
+    // every arena mesh at its arena offsets, encoded as vertex_layout/index_type
     wn_buffer_t vertex_buffer;
     wn_buffer_t index_buffer;
+    wn_buffer_t meshlet_buffer;
+    wn_buffer_t meshlet_vertex_buffer;
+    wn_buffer_t meshlet_triangle_buffer;
+    wn_buffer_t submesh_transform_buffer;
+
+    // one indirect draw per submesh, copied over cull_draw before every culling pass. Each submesh
+    // writes its surviving triangles to its own region of cull_indices
+    wn_buffer_t cull_draw_reset;
+    size_t cull_index_capacity;
+    uint32_t cull_max_meshlets; // of any lod, sizes the dispatch
 
     // debug
     VkDebugUtilsMessengerEXT debug_messenger;
@@ -1241,21 +2433,187 @@ void wn_surface_setup_present_queue(const wn_surface_t* surface, wn_device_t* de
 }
 
 // FIXME: passing entire render state here just to access a texture for descriptor write :(
-wn_swapchain_t wn_swapchain_new(
+// per frame output buffers + descriptor set for the meshlet culling pass
+void wn_swapchain_setup_cull(
     const wn_render_t* render,
     const wn_device_t* device,
-    wn_surface_t* surface,
-    VkRenderPass render_pass)
+    wn_swapchain_t* swapchain,
+    wn_frame_t* frame)
 {
-    wn_swapchain_t swapchain = { 0 };
-
-    VkSurfaceCapabilitiesKHR surface_caps = surface->capabilities;
+    // written by the compute queue, read by the graphics queue
+    VkBufferCreateInfo indices_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = render->index_size * render->cull_index_capacity,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .flags = 0,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+        .pNext = NULL,
+    };
+    wn_device_share_buffer(device, &indices_info);
+    frame->cull_indices
+        = wn_buffer_new(
+            device,
+            &indices_info,
+            0,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            WN_GPU_MEMORY_CATEGORY_MESH);
 
-    swapchain.n_frames = surface_caps.minImageCount + 1;
-    if (surface_caps.maxImageCount > 0 && swapchain.n_frames > surface_caps.maxImageCount)
-    {
-        swapchain.n_frames = surface_caps.maxImageCount;
-    }
+    VkBufferCreateInfo draw_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = sizeof(VkDrawIndexedIndirectCommand) * render->mesh.n_submeshes,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+            | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .flags = 0,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+        .pNext = NULL,
+    };
+    wn_device_share_buffer(device, &draw_info);
+    frame->cull_draw = wn_buffer_new(
+        device,
+        &draw_info,
+        0,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        WN_GPU_MEMORY_CATEGORY_MESH);
+
+    VkDescriptorSetAllocateInfo desc_set_alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = swapchain->descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &render->cull_desc_set_layout,
+        .pNext = NULL,
+    };
+    WN_VK_CHECK(
+        vkAllocateDescriptorSets(device->device, &desc_set_alloc_info, &frame->cull_desc_set));
+
+    VkDescriptorBufferInfo buffer_infos[] = {
+        { .buffer = render->uniforms.buffer.handle, .offset = 0, .range = sizeof(wn_mvp_t) },
+        { .buffer = render->meshlet_buffer.handle, .offset = 0, .range = VK_WHOLE_SIZE },
+        { .buffer = render->meshlet_vertex_buffer.handle, .offset = 0, .range = VK_WHOLE_SIZE },
+        { .buffer = render->meshlet_triangle_buffer.handle, .offset = 0, .range = VK_WHOLE_SIZE },
+        { .buffer = frame->cull_indices.handle, .offset = 0, .range = VK_WHOLE_SIZE },
+        { .buffer = frame->cull_draw.handle, .offset = 0, .range = VK_WHOLE_SIZE },
+        { .buffer = render->submesh_transform_buffer.handle, .offset = 0, .range = VK_WHOLE_SIZE },
+    };
+
+    VkWriteDescriptorSet desc_set_writes[7];
+    for (uint32_t i = 0; i < 7; i++)
+    {
+        desc_set_writes[i] = (VkWriteDescriptorSet) {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = frame->cull_desc_set,
+            .dstBinding = i,
+            .dstArrayElement = 0,
+            .descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+                                     : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &buffer_infos[i],
+            .pImageInfo = NULL,
+            .pTexelBufferView = NULL,
+            .pNext = NULL,
+        };
+    }
+
+    vkUpdateDescriptorSets(device->device, 7, desc_set_writes, 0, NULL);
+}
+
+/*
+ * Single subpass drawing into the swapchain image and the shared depth attachment. The depth
+ * attachment is cleared and never stored, the external dependency orders its clear after the
+ * previous frame's depth writes since every frame renders to the same image.
+ */
+VkRenderPass wn_render_pass_new(const wn_device_t* device, VkFormat color_format)
+{
+    VkAttachmentDescription color_attachment = {
+        .format = color_format,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+    };
+
+    VkAttachmentDescription depth_attachment = {
+        .format = device->depth_format,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+    };
+
+    VkAttachmentReference color_attachment_ref = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    };
+
+    VkAttachmentReference depth_attachment_ref = {
+        .attachment = 1,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+    };
+
+    VkSubpassDescription subpass_desc = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_attachment_ref,
+        .pDepthStencilAttachment = &depth_attachment_ref,
+    };
+
+    // the depth image is shared by every frame, the previous frame's depth writes happen in either
+    // fragment test stage and have to land before this one clears and tests against it
+    VkSubpassDependency subpass_dependency = {
+        .srcSubpass = VK_SUBPASS_EXTERNAL,
+        .dstSubpass = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+            | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+            | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+            | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+            | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+            | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+            | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    };
+
+    VkRenderPassCreateInfo render_pass_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 2,
+        .pAttachments = (VkAttachmentDescription[]) { color_attachment, depth_attachment },
+        .subpassCount = 1,
+        .pSubpasses = &subpass_desc,
+        .dependencyCount = 1,
+        .pDependencies = &subpass_dependency,
+    };
+
+    VkRenderPass render_pass;
+    WN_VK_CHECK(vkCreateRenderPass(device->device, &render_pass_info, NULL, &render_pass));
+
+    return render_pass;
+}
+
+wn_swapchain_t wn_swapchain_new(
+    const wn_render_t* render,
+    const wn_device_t* device,
+    wn_surface_t* surface,
+    VkRenderPass render_pass)
+{
+    wn_swapchain_t swapchain = { 0 };
+
+    VkSurfaceCapabilitiesKHR surface_caps = surface->capabilities;
+
+    swapchain.n_frames = surface_caps.minImageCount + 1;
+    if (surface_caps.maxImageCount > 0 && swapchain.n_frames > surface_caps.maxImageCount)
+    {
+        swapchain.n_frames = surface_caps.maxImageCount;
+    }
 
     /*
      *  create swapchain
@@ -1293,9 +2651,72 @@ wn_swapchain_t wn_swapchain_new(
     WN_VK_CHECK(
         vkGetSwapchainImagesKHR(device->device, swapchain.swapchain, &swapchain.n_frames, images));
 
-    swapchain.frames = (wn_frame_t*)malloc(swapchain.n_frames * sizeof(wn_frame_t));
+    // zeroed, a graphics_value of 0 is reached before anything was drawn to the image. Recreating
+    // waits for the device to go idle, so the new frames start from 0 as well
+    swapchain.frames = (wn_frame_t*)calloc(swapchain.n_frames, sizeof(wn_frame_t));
     assert(swapchain.frames);
 
+    /*
+     * depth attachment
+     */
+    // cleared on load and never stored, so tilers can keep it in tile memory and lazily allocated
+    // memory never has to be backed
+    VkImageCreateInfo depth_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = device->depth_format,
+        .extent = {
+            .width = surface->extent.width,
+            .height = surface->extent.height,
+            .depth = 1,
+        },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+            | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+        .flags = 0,
+        .pNext = NULL,
+    };
+
+    swapchain.depth_image = wn_image_new(
+        device,
+        &depth_info,
+        0,
+        VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        WN_GPU_MEMORY_CATEGORY_ATTACHMENT);
+
+    VkImageViewCreateInfo depth_view_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = swapchain.depth_image.handle,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = swapchain.depth_image.format,
+        .components = {
+            .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+        },
+        .subresourceRange = {
+            .aspectMask = wn_depth_format_aspects(device->depth_format),
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+
+    WN_VK_CHECK(vkCreateImageView(
+        device->device,
+        &depth_view_info,
+        NULL,
+        &swapchain.depth_image_view));
+
     /*
      * descriptor set
      */
@@ -1310,19 +2731,28 @@ wn_swapchain_t wn_swapchain_new(
     VkDescriptorSetLayoutBinding mvp_binding = {
         .binding = 0,
         .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
         .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         .pImmutableSamplers = NULL,
     };
 
+    VkDescriptorSetLayoutBinding feedback_binding = {
+        .binding = 2,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers = NULL,
+    };
+
     VkDescriptorSetLayoutBinding desc_set_bindings[] = {
         mvp_binding,
         sampler_binding,
+        feedback_binding,
     };
 
     VkDescriptorSetLayoutCreateInfo desc_set_layout_info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .bindingCount = 2,
+        .bindingCount = 3,
         .pBindings = desc_set_bindings,
         .flags = 0,
         .pNext = NULL,
@@ -1337,21 +2767,26 @@ wn_swapchain_t wn_swapchain_new(
     /*
      * descriptor pool
      */
+    // graphics set + meshlet culling set per frame
     VkDescriptorPoolSize desc_pool_sizes[]
         = { {
-                .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .descriptorCount = swapchain.n_frames,
+                .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                .descriptorCount = swapchain.n_frames * 2,
             },
             {
                 .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 .descriptorCount = swapchain.n_frames,
+            },
+            {
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = swapchain.n_frames * 7,
             } };
 
     VkDescriptorPoolCreateInfo desc_pool_info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .poolSizeCount = 2,
+        .poolSizeCount = 3,
         .pPoolSizes = desc_pool_sizes,
-        .maxSets = swapchain.n_frames,
+        .maxSets = swapchain.n_frames * 2,
         .flags = 0,
         .pNext = NULL,
     };
@@ -1407,64 +2842,12 @@ wn_swapchain_t wn_swapchain_new(
         WN_VK_CHECK(
             vkCreateImageView(device->device, &info, NULL, &swapchain.frames[i].image_view));
 
-        // depth attachment
-        VkImageCreateInfo depth_info = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-            .imageType = VK_IMAGE_TYPE_2D,
-            .format = VK_FORMAT_D32_SFLOAT,
-            .extent = {
-                .width = surface->extent.width,
-                .height = surface->extent.height,
-                .depth = 1,
-            },
-            .mipLevels = 1,
-            .arrayLayers = 1,
-            .samples = VK_SAMPLE_COUNT_1_BIT,
-            .tiling = VK_IMAGE_TILING_OPTIMAL,
-            .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-            .queueFamilyIndexCount = 0,
-            .pQueueFamilyIndices = NULL,
-            .flags = 0,
-            .pNext = NULL,
-        };
-
-        swapchain.frames[i].depth_image
-            = wn_image_new(device, &depth_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-        VkImageViewCreateInfo depth_view_info = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-            .image = swapchain.frames[i].depth_image.handle, // FIXME: i mean just look at it
-            .viewType = VK_IMAGE_VIEW_TYPE_2D,
-            .format = swapchain.frames[i].depth_image.format,
-            .components = {
-                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
-                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-                .a = VK_COMPONENT_SWIZZLE_IDENTITY,
-            },
-            .subresourceRange = {
-                .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
-                .baseMipLevel = 0,
-                .levelCount = 1,
-                .baseArrayLayer = 0,
-                .layerCount = 1,
-            },
-        };
-
-        WN_VK_CHECK(vkCreateImageView(
-            device->device,
-            &depth_view_info,
-            NULL,
-            &swapchain.frames[i].depth_image_view));
-
         VkFramebufferCreateInfo framebuffer_info = {
             .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
             .renderPass = render_pass,
             .attachmentCount = 2,
             .pAttachments = (VkImageView[]) { swapchain.frames[i].image_view,
-                                              swapchain.frames[i].depth_image_view },
+                                              swapchain.depth_image_view },
             .width = surface->extent.width,
             .height = surface->extent.height,
             .layers = 1,
@@ -1476,29 +2859,38 @@ wn_swapchain_t wn_swapchain_new(
             NULL,
             &swapchain.frames[i].framebuffer));
 
-        VkDeviceSize buffer_size = sizeof(wn_mvp_t);
-
-        swapchain.frames[i].ubo = wn_buffer_new(
+        swapchain.frames[i].texture_feedback = wn_buffer_new(
             device,
             &(VkBufferCreateInfo) {
                 .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-                .size = buffer_size,
-                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                .size = sizeof(wn_texture_feedback_t),
+                .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                 .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
                 .flags = 0,
                 .queueFamilyIndexCount = 0,
                 .pQueueFamilyIndices = NULL,
                 .pNext = NULL,
             },
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+            WN_GPU_MEMORY_CATEGORY_TEXTURE);
+
+        swapchain.frames[i].texture_feedback_data
+            = (wn_texture_feedback_t*)swapchain.frames[i].texture_feedback.allocation.mapped;
+        // extent stays 0 if the texture isn't streamed, nobody reads the feedback then
+        *swapchain.frames[i].texture_feedback_data = (wn_texture_feedback_t) {
+            .extent = { render->color_stream.file.width, render->color_stream.file.height },
+            .min_mip = UINT32_MAX,
+        };
 
         /*
          * descriptor set
          */
         swapchain.frames[i].ubo_desc_set = desc_sets[i];
+        swapchain.frames[i].texture_swaps = render->color_stream.n_swaps;
 
         VkDescriptorBufferInfo desc_buf_info = {
-            .buffer = swapchain.frames[i].ubo.handle,
+            .buffer = render->uniforms.buffer.handle,
             .offset = 0,
             .range = sizeof(wn_mvp_t),
         };
@@ -1515,7 +2907,7 @@ wn_swapchain_t wn_swapchain_new(
                     .dstSet = swapchain.frames[i].ubo_desc_set,
                     .dstBinding = 0,
                     .dstArrayElement = 0,
-                    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                     .descriptorCount = 1,
                     .pBufferInfo = &desc_buf_info,
                     .pImageInfo = NULL,
@@ -1533,9 +2925,31 @@ wn_swapchain_t wn_swapchain_new(
                     .pImageInfo = &desc_img_info,
                     .pTexelBufferView = NULL,
                     .pNext = NULL,
+                },
+                {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = swapchain.frames[i].ubo_desc_set,
+                    .dstBinding = 2,
+                    .dstArrayElement = 0,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .descriptorCount = 1,
+                    .pBufferInfo = &(VkDescriptorBufferInfo) {
+                        .buffer = swapchain.frames[i].texture_feedback.handle,
+                        .offset = 0,
+                        .range = sizeof(wn_texture_feedback_t),
+                    },
+                    .pImageInfo = NULL,
+                    .pTexelBufferView = NULL,
+                    .pNext = NULL,
                 } };
 
-        vkUpdateDescriptorSets(device->device, 2, desc_set_writes, 0, NULL);
+        vkUpdateDescriptorSets(device->device, 3, desc_set_writes, 0, NULL);
+
+        swapchain.frames[i].cull_desc_set = NULL;
+        if (render->mesh.n_meshlets > 0)
+        {
+            wn_swapchain_setup_cull(render, device, &swapchain, &swapchain.frames[i]);
+        }
     }
 
     free(layouts);
@@ -1544,22 +2958,1010 @@ wn_swapchain_t wn_swapchain_new(
     return swapchain;
 }
 
-// TODO: destroy depth image/view
 void wn_swapchain_destroy(VkDevice device, wn_swapchain_t* swapchain)
 {
     for (uint32_t i = 0; i < swapchain->n_frames; i++)
     {
         vkDestroyImageView(device, swapchain->frames[i].image_view, NULL);
         vkDestroyFramebuffer(device, swapchain->frames[i].framebuffer, NULL);
-        wn_buffer_destroy(&swapchain->frames[i].ubo, device);
-        wn_image_destroy(&swapchain->frames[i].depth_image, device);
-        vkDestroyImageView(device, swapchain->frames[i].depth_image_view, NULL);
+        wn_buffer_destroy(&swapchain->frames[i].texture_feedback, device);
+        if (swapchain->frames[i].cull_desc_set)
+        {
+            wn_buffer_destroy(&swapchain->frames[i].cull_indices, device);
+            wn_buffer_destroy(&swapchain->frames[i].cull_draw, device);
+        }
+    }
+    free(swapchain->frames);
+    vkDestroyImageView(device, swapchain->depth_image_view, NULL);
+    wn_image_destroy(&swapchain->depth_image, device);
+    vkDestroyDescriptorSetLayout(device, swapchain->desc_set_layout, NULL);
+    vkDestroyDescriptorPool(device, swapchain->descriptor_pool, NULL);
+    vkDestroySwapchainKHR(device, swapchain->swapchain, NULL);
+}
+
+// packs an arena mesh with layout (same encodings as render->vertex_layout, its own position range)
+// and copies it to its arena offsets in the shared vertex/index buffers
+// packs mesh straight into the staging ring (from its mapping if it is baked), in chunks that fit
+// the ring, and copies it to the arena offsets of the vertex/index buffers. Doesn't wait
+void wn_mesh_upload(
+    wn_render_t* render,
+    const wn_device_t* device,
+    const wn_mesh_t* mesh,
+    const wn_vertex_layout_t* layout)
+{
+    assert(mesh->arena == render->mesh_arena);
+    assert(layout->stride == render->vertex_layout.stride);
+    assert(wn_mesh_index_size(mesh) <= render->index_size);
+
+    wn_staging_t* staging = &render->staging;
+    size_t vertex_bytes = (size_t)layout->stride * mesh->n_vertices;
+
+    size_t chunk_vertices = (size_t)(staging->buffer.size / layout->stride);
+    for (size_t first = 0; first < mesh->n_vertices; first += chunk_vertices)
+    {
+        size_t n = mesh->n_vertices - first < chunk_vertices ? mesh->n_vertices - first
+                                                             : chunk_vertices;
+        VkDeviceSize size = (VkDeviceSize)layout->stride * n;
+        VkDeviceSize offset = (VkDeviceSize)layout->stride * (mesh->arena_vertex_offset + first);
+
+        VkDeviceSize staging_offset;
+        void* dst = wn_staging_alloc(staging, device->device, size, &staging_offset);
+        wn_mesh_pack_vertices(mesh, layout, first, n, dst);
+
+        vkCmdCopyBuffer(
+            wn_staging_cmd(staging, device->device),
+            staging->buffer.handle,
+            render->vertex_buffer.handle,
+            1,
+            &(VkBufferCopy) { .srcOffset = staging_offset, .dstOffset = offset, .size = size });
+        wn_staging_handoff_buffer(staging, device->device, &render->vertex_buffer, offset, size);
+    }
+
+    size_t chunk_indices = (size_t)(staging->buffer.size / render->index_size);
+    for (size_t first = 0; first < mesh->n_indices; first += chunk_indices)
+    {
+        size_t n = mesh->n_indices - first < chunk_indices ? mesh->n_indices - first
+                                                           : chunk_indices;
+        VkDeviceSize size = (VkDeviceSize)render->index_size * n;
+        VkDeviceSize offset = (VkDeviceSize)render->index_size * (mesh->arena_index_offset + first);
+
+        VkDeviceSize staging_offset;
+        void* dst = wn_staging_alloc(staging, device->device, size, &staging_offset);
+        wn_mesh_pack_indices(mesh, render->index_size, first, n, dst);
+
+        vkCmdCopyBuffer(
+            wn_staging_cmd(staging, device->device),
+            staging->buffer.handle,
+            render->index_buffer.handle,
+            1,
+            &(VkBufferCopy) { .srcOffset = staging_offset, .dstOffset = offset, .size = size });
+        wn_staging_handoff_buffer(staging, device->device, &render->index_buffer, offset, size);
+    }
+
+    log_info(
+        "Mesh upload: %zu vertex bytes (%u byte stride, fp32 %zu), %u bit indices",
+        vertex_bytes,
+        layout->stride,
+        sizeof(wn_vertex_t) * mesh->n_vertices,
+        render->index_size * 8);
+}
+
+// makes mesh (already moved into render->mesh_arena) the rendered mesh: picks the vertex encodings,
+// creates the arena sized vertex/index buffers and uploads it along with its meshlet/culling data.
+// Takes ownership of mesh
+void wn_render_set_mesh(wn_render_t* render, const wn_device_t* device, wn_mesh_t* mesh)
+{
+    assert(mesh->arena == render->mesh_arena && render->mesh.n_vertices == 0);
+
+    render->mesh = *mesh;
+    *mesh = (wn_mesh_t) { 0 };
+
+    // NOTE: the encodings are picked for the first mesh, later meshes have to share them since
+    // they all go through the same pipeline
+#ifdef WN_QUANTIZED_VERTICES
+    render->vertex_layout = wn_mesh_vertex_layout(&render->mesh, true);
+#else
+    render->vertex_layout = wn_mesh_vertex_layout(&render->mesh, false);
+#endif
+    render->index_size = wn_mesh_index_size(&render->mesh);
+    render->index_type = render->index_size == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+    render->vertex_buffer = wn_buffer_new(
+        device,
+        &(VkBufferCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = (VkDeviceSize)render->vertex_layout.stride * MESH_ARENA_VERTICES,
+            .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .flags = 0,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = NULL,
+            .pNext = NULL,
+        },
+        0,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        WN_GPU_MEMORY_CATEGORY_MESH);
+
+    render->index_buffer = wn_buffer_new(
+        device,
+        &(VkBufferCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = (VkDeviceSize)render->index_size * MESH_ARENA_INDICES,
+            .usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .flags = 0,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = NULL,
+            .pNext = NULL,
+        },
+        0,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        WN_GPU_MEMORY_CATEGORY_MESH);
+
+    wn_mesh_upload(render, device, &render->mesh, &render->vertex_layout);
+
+    if (render->mesh.n_meshlets > 0)
+    {
+        render->meshlet_buffer = wn_buffer_new_with_data(
+            device,
+            &render->staging,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            WN_GPU_MEMORY_CATEGORY_MESH,
+            render->mesh.meshlets,
+            sizeof(render->mesh.meshlets[0]) * render->mesh.n_meshlets);
+
+        render->meshlet_vertex_buffer = wn_buffer_new_with_data(
+            device,
+            &render->staging,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            WN_GPU_MEMORY_CATEGORY_MESH,
+            render->mesh.meshlet_vertices,
+            sizeof(render->mesh.meshlet_vertices[0]) * render->mesh.n_meshlet_vertices);
+
+        render->meshlet_triangle_buffer = wn_buffer_new_with_data(
+            device,
+            &render->staging,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            WN_GPU_MEMORY_CATEGORY_MESH,
+            render->mesh.meshlet_triangles,
+            sizeof(render->mesh.meshlet_triangles[0]) * render->mesh.n_meshlet_triangles);
+
+        size_t n_submeshes = render->mesh.n_submeshes;
+        wn_mat4f_t* transforms = malloc(sizeof(wn_mat4f_t) * n_submeshes);
+        VkDrawIndexedIndirectCommand* draws
+            = malloc(sizeof(VkDrawIndexedIndirectCommand) * n_submeshes);
+        assert(transforms && draws);
+
+        // worst case every meshlet of the largest lod survives, plus one padding triangle per
+        // meshlet when the indices are 16 bit (see meshlet_cull.comp). Regions start on an even
+        // index so packed 16 bit pairs never straddle two submeshes
+        render->cull_index_capacity = 0;
+        for (size_t s = 0; s < n_submeshes; s++)
+        {
+            const wn_submesh_t* submesh = &render->mesh.submeshes[s];
+
+            size_t region = 0;
+            for (uint32_t lod = 0; lod < render->mesh.n_lods; lod++)
+            {
+                const wn_mesh_lod_t* submesh_lod = &submesh->lods[lod];
+                size_t n_indices = submesh_lod->n_indices + 3 * submesh_lod->n_meshlets;
+                region = n_indices > region ? n_indices : region;
+            }
+
+            transforms[s] = submesh->transform;
+            draws[s] = (VkDrawIndexedIndirectCommand) {
+                .indexCount = 0,
+                .instanceCount = 1,
+                .firstIndex = (uint32_t)render->cull_index_capacity,
+                .vertexOffset = (int32_t)(render->mesh.arena_vertex_offset + submesh->first_vertex),
+                .firstInstance = 0,
+            };
+            render->cull_index_capacity += (region + 1) & ~(size_t)1;
+        }
+
+        render->cull_max_meshlets = 0;
+        for (uint32_t lod = 0; lod < render->mesh.n_lods; lod++)
+        {
+            render->cull_max_meshlets
+                = wn_u32_max(render->cull_max_meshlets, render->mesh.lods[lod].n_meshlets);
+        }
+
+        render->submesh_transform_buffer = wn_buffer_new_with_data(
+            device,
+            &render->staging,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            WN_GPU_MEMORY_CATEGORY_MESH,
+            transforms,
+            sizeof(wn_mat4f_t) * n_submeshes);
+
+        render->cull_draw_reset = wn_buffer_new_with_data(
+            device,
+            &render->staging,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            WN_GPU_MEMORY_CATEGORY_MESH,
+            draws,
+            sizeof(VkDrawIndexedIndirectCommand) * n_submeshes);
+
+        free(transforms);
+        free(draws);
+    }
+}
+
+/*
+ *  asset loading
+ *
+ *  The cpu side of every asset in a manifest (image decode, model parse + optimize, shader compile)
+ *  runs as a job on the worker threads. Decoded assets are queued for one upload thread which does
+ *  all the gpu work, so nothing but that thread touches the command pool or the queues while the
+ *  manifest is loading.
+ */
+typedef enum wn_asset_kind
+{
+    WN_ASSET_TEXTURE,
+    WN_ASSET_MESH,
+    WN_ASSET_SHADER,
+} wn_asset_kind;
+
+typedef struct wn_asset_t
+{
+    wn_asset_kind kind;
+    const char* path;
+    VkShaderStageFlagBits shader_stage; // WN_ASSET_SHADER
+
+    // decoded on a worker
+    wn_texture_file_t baked; // WN_ASSET_TEXTURE, mapped .ktx2 if there is a usable one
+    uint8_t* pixels;         // rgba8 otherwise
+    uint32_t width;
+    uint32_t height;
+    wn_mesh_t mesh; // handed to wn_render_set_mesh on upload
+    wn_shader_t shader;
+
+    // uploaded on the upload thread
+    wn_texture_t texture;
+
+    double decode_ms;
+    double upload_ms;
+    struct wn_asset_loader_t* loader;
+} wn_asset_t;
+
+typedef struct wn_asset_loader_t
+{
+    wn_render_t* render;
+    const wn_device_t* device;
+    size_t n_assets;
+
+    wn_job_counter_t decoding; // decode jobs run on render->jobs
+
+    // decoded assets in completion order, drained by the upload thread
+    pthread_mutex_t lock;
+    pthread_cond_t decoded;
+    wn_asset_t** upload_queue; // stbds array
+    pthread_t upload_thread;
+} wn_asset_loader_t;
+
+static const char* wn_asset_kind_name(wn_asset_kind kind)
+{
+    switch (kind)
+    {
+    case WN_ASSET_TEXTURE:
+        return "texture";
+    case WN_ASSET_MESH:
+        return "mesh";
+    case WN_ASSET_SHADER:
+        return "shader";
+    }
+    return "?";
+}
+
+static void wn_asset_decode(void* data)
+{
+    wn_asset_t* asset = data;
+    wn_asset_loader_t* loader = asset->loader;
+    double start = glfwGetTime();
+
+    switch (asset->kind)
+    {
+    case WN_ASSET_TEXTURE:
+    {
+        // prefer a baked .ktx2 next to the source image (see wn_bake), its blocks go to the gpu
+        // without any decoding
+        char baked_path[512];
+        if (wn_texture_file_baked_path(asset->path, baked_path, sizeof(baked_path))
+            && wn_texture_file_map(baked_path, &asset->baked) == WN_OK)
+        {
+            VkFormat format = (VkFormat)asset->baked.vk_format;
+            if (wn_device_texture_format_supported(loader->device, format))
+            {
+                break;
+            }
+            log_warn(
+                "%s is %s which the gpu can't sample, decoding %s instead",
+                baked_path,
+                wn_texture_format_name(asset->baked.vk_format),
+                asset->path);
+            wn_texture_file_unmap(&asset->baked);
+        }
+
+        int width, height, channels;
+        asset->pixels = stbi_load(asset->path, &width, &height, &channels, STBI_rgb_alpha);
+        if (!asset->pixels)
+        {
+            log_fatal("could not load texture %s: %s", asset->path, stbi_failure_reason());
+            exit(EXIT_FAILURE);
+        }
+        asset->width = (uint32_t)width;
+        asset->height = (uint32_t)height;
+        break;
+    }
+    case WN_ASSET_MESH:
+        asset->mesh = wn_mesh_read(asset->path);
+        break;
+    case WN_ASSET_SHADER:
+    {
+        // NOTE: one compiler per job, they're cheap next to the compile itself
+        wn_shader_loader_t shader_loader = wn_util_create_shader_loader();
+        asset->shader = wn_util_load_shader(&shader_loader, asset->path, asset->shader_stage);
+        wn_util_destroy_shader_loader(&shader_loader);
+        break;
+    }
+    }
+
+    asset->decode_ms = (glfwGetTime() - start) * 1000.0;
+
+    pthread_mutex_lock(&loader->lock);
+    stbds_arrput(loader->upload_queue, asset);
+    pthread_cond_signal(&loader->decoded);
+    pthread_mutex_unlock(&loader->lock);
+}
+
+static void wn_asset_upload(wn_asset_loader_t* loader, wn_asset_t* asset)
+{
+    wn_render_t* render = loader->render;
+    double start = glfwGetTime();
+
+    switch (asset->kind)
+    {
+    case WN_ASSET_TEXTURE:
+        if (asset->baked.mapping)
+        {
+            // only the tail for now, the mapping is kept for wn_texture_stream_update
+            asset->texture = wn_texture_new_baked(
+                loader->device,
+                &render->staging,
+                &asset->baked,
+                wn_texture_stream_tail_mip(&asset->baked),
+                NULL);
+            break;
+        }
+        asset->texture = wn_texture_new(
+            loader->device,
+            &render->staging,
+            asset->pixels,
+            asset->width,
+            asset->height);
+        stbi_image_free(asset->pixels);
+        asset->pixels = NULL;
+        break;
+    case WN_ASSET_MESH:
+        if (wn_mesh_arena_add(render->mesh_arena, &asset->mesh) != WN_OK)
+        {
+            log_fatal("could not fit %s into the mesh arena", asset->path);
+            exit(EXIT_FAILURE);
+        }
+        wn_render_set_mesh(render, loader->device, &asset->mesh);
+        break;
+    case WN_ASSET_SHADER:
+        // spirv is all there is, modules get created along with their pipelines
+        break;
+    }
+
+    asset->upload_ms = (glfwGetTime() - start) * 1000.0;
+}
+
+static void* wn_asset_upload_thread(void* arg)
+{
+    wn_asset_loader_t* loader = arg;
+
+    for (size_t n_uploaded = 0; n_uploaded < loader->n_assets; n_uploaded++)
+    {
+        pthread_mutex_lock(&loader->lock);
+        while (stbds_arrlen(loader->upload_queue) == 0)
+        {
+            pthread_cond_wait(&loader->decoded, &loader->lock);
+        }
+        wn_asset_t* asset = loader->upload_queue[0];
+        stbds_arrdel(loader->upload_queue, 0);
+        pthread_mutex_unlock(&loader->lock);
+
+        wn_asset_upload(loader, asset);
+    }
+
+    return NULL;
+}
+
+// loads every asset of the manifest on render->jobs, returns once all of them are on the gpu
+void wn_asset_load(wn_render_t* render, const wn_device_t* device, wn_asset_t* assets, size_t n)
+{
+    double start = glfwGetTime();
+
+    wn_asset_loader_t loader = {
+        .render = render,
+        .device = device,
+        .n_assets = n,
+    };
+    pthread_mutex_init(&loader.lock, NULL);
+    pthread_cond_init(&loader.decoded, NULL);
+
+    int err = pthread_create(&loader.upload_thread, NULL, wn_asset_upload_thread, &loader);
+    if (err != 0)
+    {
+        log_fatal("could not start the asset upload thread (%d)", err);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        assets[i].loader = &loader;
+        wn_job_submit(render->jobs, wn_asset_decode, &assets[i], &loader.decoding);
+    }
+
+    // the calling thread decodes too until the queue runs dry
+    wn_job_wait(render->jobs, &loader.decoding);
+    pthread_join(loader.upload_thread, NULL);
+
+    // the upload thread only recorded into staging batches, submit the rest and wait once
+    wn_staging_wait(&render->staging, device->device);
+
+    double decode_ms = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        log_info(
+            "Loaded %s %s: decode %.3f ms, upload %.3f ms",
+            wn_asset_kind_name(assets[i].kind),
+            assets[i].path,
+            assets[i].decode_ms,
+            assets[i].upload_ms);
+        decode_ms += assets[i].decode_ms;
+        assets[i].loader = NULL;
+    }
+    log_info(
+        "Loaded %zu assets in %.3f ms (%.3f ms of decoding on %u workers)",
+        n,
+        (glfwGetTime() - start) * 1000.0,
+        decode_ms,
+        render->jobs->n_threads);
+
+    stbds_arrfree(loader.upload_queue);
+    pthread_cond_destroy(&loader.decoded);
+    pthread_mutex_destroy(&loader.lock);
+}
+
+/*
+ * Meshlet culling of the current frame, fills frame's cull_indices + cull_draw for the indirect
+ * draws. Submitted separately to the compute queue, wn_draw makes the draw wait for it.
+ */
+static VkCommandBuffer wn_record_cull(wn_render_t* render, const wn_frame_t* frame)
+{
+    uint32_t frame_in_flight = (uint32_t)render->current_frame;
+    // the mvp is the first allocation of every frame, see wn_draw
+    uint32_t mvp_offset = wn_uniform_arena_base(&render->uniforms, frame_in_flight);
+
+    // only the render thread records culling
+    VkCommandBuffer compute_cmd = wn_command_pools_get(
+        &render->compute_commands,
+        frame_in_flight,
+        0,
+        VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    WN_VK_CHECK(vkBeginCommandBuffer(compute_cmd, &begin_info));
+
+    vkCmdCopyBuffer(
+        compute_cmd,
+        render->cull_draw_reset.handle,
+        frame->cull_draw.handle,
+        1,
+        &(VkBufferCopy) {
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size = sizeof(VkDrawIndexedIndirectCommand) * render->mesh.n_submeshes,
+        });
+
+    vkCmdPipelineBarrier(
+        compute_cmd,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0,
+        NULL,
+        1,
+        &(VkBufferMemoryBarrier) {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = frame->cull_draw.handle,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+        },
+        0,
+        NULL);
+
+    vkCmdBindPipeline(compute_cmd, VK_PIPELINE_BIND_POINT_COMPUTE, render->cull_pipeline);
+    vkCmdBindDescriptorSets(
+        compute_cmd,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        render->cull_pipeline_layout,
+        0,
+        1,
+        &frame->cull_desc_set,
+        1,
+        &mvp_offset);
+
+    // sized for the largest lod, the shader drops whatever the current lod doesn't need
+    vkCmdDispatch(compute_cmd, (render->cull_max_meshlets + 63) / 64, 1, 1);
+
+    // the semaphore wait of the draw makes the outputs visible, no barrier needed here
+    WN_VK_CHECK(vkEndCommandBuffer(compute_cmd));
+
+    return compute_cmd;
+}
+
+/*
+ * The frame's draw list, every submesh at lod. Culling writes the indirect draws of the lod
+ * itself, only the draw without culling data uses the index ranges.
+ */
+void wn_draw_list_build(wn_render_t* render, uint32_t lod)
+{
+    const wn_vertex_layout_t* layout = &render->vertex_layout;
+
+    // keeps its storage from the last frame
+    stbds_arrsetlen(render->draws, 0);
+    for (size_t s = 0; s < render->mesh.n_submeshes; s++)
+    {
+        const wn_submesh_t* submesh = &render->mesh.submeshes[s];
+
+        wn_draw_item_t draw = {
+            .push = {
+                .transform = submesh->transform,
+                .pos_scale = { .x = layout->pos_scale.x,
+                               .y = layout->pos_scale.y,
+                               .z = layout->pos_scale.z },
+                .pos_bias = { .x = layout->pos_bias.x,
+                              .y = layout->pos_bias.y,
+                              .z = layout->pos_bias.z },
+            },
+            .submesh = (uint32_t)s,
+            .n_indices = submesh->lods[lod].n_indices,
+            .first_index = render->mesh.arena_index_offset + submesh->lods[lod].first_index,
+            .vertex_offset = (int32_t)(render->mesh.arena_vertex_offset + submesh->first_vertex),
+        };
+        stbds_arrput(render->draws, draw);
+    }
+}
+
+typedef struct wn_draw_chunk_t
+{
+    wn_render_t* render;
+    const wn_frame_t* frame;
+    uint32_t frame_in_flight;
+    const wn_draw_item_t* draws;
+    size_t n_draws;
+    VkCommandBuffer cmd; // recorded secondary
+} wn_draw_chunk_t;
+
+// job, records a range of the draw list from the pool of whichever thread runs it
+static void wn_record_draw_chunk(void* data)
+{
+    wn_draw_chunk_t* chunk = data;
+    wn_render_t* render = chunk->render;
+    const wn_frame_t* frame = chunk->frame;
+    bool cull_meshlets = render->mesh.n_meshlets > 0;
+    // the mvp is the first allocation of every frame, see wn_draw
+    uint32_t mvp_offset = wn_uniform_arena_base(&render->uniforms, chunk->frame_in_flight);
+
+    VkCommandBuffer cmd = wn_command_pools_get(
+        &render->commands,
+        chunk->frame_in_flight,
+        wn_job_thread_index(),
+        VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+            | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &(VkCommandBufferInheritanceInfo) {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .renderPass = render->render_pass,
+            .subpass = 0,
+            .framebuffer = frame->framebuffer,
+        },
+    };
+    WN_VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+    // nothing is inherited from the primary, every chunk binds the whole state again
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, render->graphics_pipeline);
+
+    VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = (float)render->surface.extent.width,
+        .height = (float)render->surface.extent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+
+    VkRect2D scissor = {
+        .extent = render->surface.extent,
+        .offset = { .x = 0, .y = 0 },
+    };
+
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    VkDeviceSize offsets = { 0 };
+    vkCmdBindVertexBuffers(cmd, 0, 1, &render->vertex_buffer.handle, &offsets);
+
+    vkCmdBindDescriptorSets(
+        cmd,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        render->graphics_pipeline_layout,
+        0,
+        1,
+        &frame->ubo_desc_set,
+        1,
+        &mvp_offset);
+
+    // every submesh draws from the same vertex/index buffer pair with its own base vertex
+    vkCmdBindIndexBuffer(
+        cmd,
+        cull_meshlets ? frame->cull_indices.handle : render->index_buffer.handle,
+        0,
+        render->index_type);
+
+    for (size_t i = 0; i < chunk->n_draws; i++)
+    {
+        const wn_draw_item_t* draw = &chunk->draws[i];
+
+        vkCmdPushConstants(
+            cmd,
+            render->graphics_pipeline_layout,
+            VK_SHADER_STAGE_VERTEX_BIT,
+            0,
+            sizeof(draw->push),
+            &draw->push);
+
+        if (cull_meshlets)
+        {
+            vkCmdDrawIndexedIndirect(
+                cmd,
+                frame->cull_draw.handle,
+                sizeof(VkDrawIndexedIndirectCommand) * draw->submesh,
+                1,
+                sizeof(VkDrawIndexedIndirectCommand));
+        }
+        else
+        {
+            vkCmdDrawIndexed(cmd, draw->n_indices, 1, draw->first_index, draw->vertex_offset, 0);
+        }
+    }
+
+    WN_VK_CHECK(vkEndCommandBuffer(cmd));
+    chunk->cmd = cmd;
+}
+
+/*
+ * Splits draws into at most max_chunks chunks of at least DRAWS_PER_CHUNK, records them into
+ * secondary command buffers on the job system and executes them from cmd in draw order. cmd has
+ * to be in a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+ */
+static void wn_record_draws(
+    wn_render_t* render,
+    VkCommandBuffer cmd,
+    const wn_frame_t* frame,
+    uint32_t frame_in_flight,
+    const wn_draw_item_t* draws,
+    size_t n_draws,
+    uint32_t max_chunks)
+{
+    if (n_draws == 0)
+    {
+        return;
+    }
+
+    size_t n_chunks = (n_draws + DRAWS_PER_CHUNK - 1) / DRAWS_PER_CHUNK;
+    if (n_chunks > max_chunks)
+    {
+        n_chunks = max_chunks;
+    }
+
+    wn_draw_chunk_t chunks[n_chunks];
+    wn_job_counter_t recording = { 0 };
+    for (size_t i = 0; i < n_chunks; i++)
+    {
+        size_t first = n_draws * i / n_chunks;
+        chunks[i] = (wn_draw_chunk_t) {
+            .render = render,
+            .frame = frame,
+            .frame_in_flight = frame_in_flight,
+            .draws = draws + first,
+            .n_draws = n_draws * (i + 1) / n_chunks - first,
+        };
+
+        // the last one is left to this thread, it would only wait otherwise
+        if (i + 1 < n_chunks)
+        {
+            wn_job_submit(render->jobs, wn_record_draw_chunk, &chunks[i], &recording);
+        }
+    }
+    wn_record_draw_chunk(&chunks[n_chunks - 1]);
+    wn_job_wait(render->jobs, &recording);
+
+    VkCommandBuffer secondaries[n_chunks];
+    for (size_t i = 0; i < n_chunks; i++)
+    {
+        secondaries[i] = chunks[i].cmd;
+    }
+    vkCmdExecuteCommands(cmd, (uint32_t)n_chunks, secondaries);
+}
+
+// a primary of the frame's pools, begun and inside the render pass on frame's framebuffer
+static VkCommandBuffer wn_begin_draw_commands(
+    wn_render_t* render,
+    const wn_frame_t* frame,
+    uint32_t frame_in_flight)
+{
+    VkCommandBuffer cmd = wn_command_pools_get(
+        &render->commands,
+        frame_in_flight,
+        wn_job_thread_index(),
+        VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    WN_VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+    VkClearValue clear_values[] = {
+        { .color = { { 0.0f, 0.0f, 0.0f, 1.0f } } },
+        { .depthStencil = { 1.0f, 0 } },
+    };
+
+    VkRenderPassBeginInfo render_pass_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = render->render_pass,
+        .framebuffer = frame->framebuffer,
+        .renderArea = {
+            .offset = { .x = 0, .y = 0 },
+            .extent = render->surface.extent,
+        },
+        .clearValueCount = 2,
+        .pClearValues = clear_values,
+    };
+
+    vkCmdBeginRenderPass(
+        cmd,
+        &render_pass_begin_info,
+        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    return cmd;
+}
+
+// records the draw of the current frame onto swapchain image image_index
+static VkCommandBuffer wn_record_frame(wn_render_t* render, uint32_t image_index)
+{
+    const wn_frame_t* frame = &render->swapchain.frames[image_index];
+    uint32_t frame_in_flight = (uint32_t)render->current_frame;
+
+    VkCommandBuffer cmd = wn_begin_draw_commands(render, frame, frame_in_flight);
+
+    wn_record_draws(
+        render,
+        cmd,
+        frame,
+        frame_in_flight,
+        render->draws,
+        stbds_arrlen(render->draws),
+        render->jobs->n_threads + 1);
+
+    vkCmdEndRenderPass(cmd);
+
+    // texture feedback is read on the host once the frame's timeline value is reached
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        1,
+        &(VkMemoryBarrier) {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        },
+        0,
+        NULL,
+        0,
+        NULL);
+
+    WN_VK_CHECK(vkEndCommandBuffer(cmd));
+
+    return cmd;
+}
+
+#ifdef WN_BENCH_OBJ
+// a textured grid of OBJ_BENCH_GRID^2 quads written as polygons, the way exporters write them
+static bool wn_obj_bench_write_grid(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        log_error("Could not create %s", path);
+        return false;
+    }
+
+    const uint32_t n = OBJ_BENCH_GRID + 1;
+    for (uint32_t y = 0; y < n; y++)
+    {
+        for (uint32_t x = 0; x < n; x++)
+        {
+            float u = (float)x / (float)OBJ_BENCH_GRID;
+            float v = (float)y / (float)OBJ_BENCH_GRID;
+            fprintf(file, "v %f %f %f\nvt %f %f\n", u, v, 0.1f * sinf(u * 20.0f), u, v);
+        }
+    }
+    for (uint32_t y = 0; y < OBJ_BENCH_GRID; y++)
+    {
+        for (uint32_t x = 0; x < OBJ_BENCH_GRID; x++)
+        {
+            uint32_t a = y * n + x + 1;
+            uint32_t b = a + n;
+            fprintf(file, "f %u/%u %u/%u %u/%u %u/%u\n", a, a, a + 1, a + 1, b + 1, b + 1, b, b);
+        }
+    }
+
+    return fclose(file) == 0;
+}
+
+// loads path with the native reader or assimp in a child process, so each gets its own peak RSS
+static void wn_obj_bench_load(const char* path, bool native)
+{
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        log_error("Could not fork the obj benchmark");
+        return;
+    }
+
+    if (pid == 0)
+    {
+        struct rusage before;
+        getrusage(RUSAGE_SELF, &before);
+        double start = glfwGetTime();
+
+        wn_mesh_t mesh = { 0 };
+        if (native)
+        {
+            if (wn_obj_load(path, &mesh) != WN_OK)
+            {
+                _exit(EXIT_FAILURE);
+            }
+        }
+        else
+        {
+            mesh = wn_load_obj(path);
+        }
+
+        double ms = (glfwGetTime() - start) * 1000.0;
+        struct rusage after;
+        getrusage(RUSAGE_SELF, &after);
+
+        // release builds only log errors, the numbers are the point here
+        printf(
+            "obj bench %-6s %s: %.3f ms, %zu vertices, %zu indices, peak RSS +%ld KiB\n",
+            native ? "native" : "assimp",
+            path,
+            ms,
+            mesh.n_vertices,
+            mesh.n_indices,
+            after.ru_maxrss - before.ru_maxrss);
+        fflush(stdout);
+        wn_mesh_destroy(&mesh);
+        _exit(EXIT_SUCCESS);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+    {
+        log_error("obj benchmark failed on %s", path);
+    }
+}
+
+// native reader vs assimp on the shipped model and a generated multi-million triangle one
+static void wn_obj_benchmark(void)
+{
+    wn_obj_bench_load(OBJ_BENCH_MODEL, true);
+    wn_obj_bench_load(OBJ_BENCH_MODEL, false);
+
+    char grid_path[] = "/tmp/wn_obj_bench_XXXXXX";
+    int fd = mkstemp(grid_path);
+    if (fd < 0)
+    {
+        log_error("Could not create the obj benchmark grid");
+        return;
+    }
+    close(fd);
+
+    if (wn_obj_bench_write_grid(grid_path))
+    {
+        wn_obj_bench_load(grid_path, true);
+        wn_obj_bench_load(grid_path, false);
+    }
+    unlink(grid_path);
+}
+#endif
+
+#ifdef WN_BENCH_RECORDING
+// records RECORD_BENCH_DRAWS draws on 1 up to every job thread, nothing is submitted
+static void wn_record_benchmark(wn_render_t* render)
+{
+    size_t n_scene_draws = stbds_arrlen(render->draws);
+    if (n_scene_draws == 0)
+    {
+        return;
+    }
+
+    wn_draw_item_t* draws = NULL;
+    stbds_arrsetlen(draws, RECORD_BENCH_DRAWS);
+    for (size_t i = 0; i < RECORD_BENCH_DRAWS; i++)
+    {
+        draws[i] = render->draws[i % n_scene_draws];
+    }
+
+    // no frame has been submitted yet, so the pools of frame 0 are free to use
+    const wn_frame_t* frame = &render->swapchain.frames[0];
+    double single_ms = 0.0;
+    for (uint32_t n_threads = 1; n_threads <= render->jobs->n_threads + 1; n_threads++)
+    {
+        // best of a few, the first run also pays for allocating the command buffers
+        double best_ms = 0.0;
+        for (uint32_t run = 0; run < RECORD_BENCH_RUNS; run++)
+        {
+            double start = glfwGetTime();
+
+            VkCommandBuffer cmd = wn_begin_draw_commands(render, frame, 0);
+            wn_record_draws(render, cmd, frame, 0, draws, RECORD_BENCH_DRAWS, n_threads);
+            vkCmdEndRenderPass(cmd);
+            WN_VK_CHECK(vkEndCommandBuffer(cmd));
+
+            double ms = (glfwGetTime() - start) * 1000.0;
+            if (run == 0 || ms < best_ms)
+            {
+                best_ms = ms;
+            }
+            wn_command_pools_reset(&render->commands, 0);
+        }
+
+        if (n_threads == 1)
+        {
+            single_ms = best_ms;
+        }
+        log_info(
+            "Recorded %u draws on %u threads in %.3f ms (%.2fx)",
+            RECORD_BENCH_DRAWS,
+            n_threads,
+            best_ms,
+            single_ms / best_ms);
     }
-    free(swapchain->frames);
-    vkDestroyDescriptorSetLayout(device, swapchain->desc_set_layout, NULL);
-    vkDestroyDescriptorPool(device, swapchain->descriptor_pool, NULL);
-    vkDestroySwapchainKHR(device, swapchain->swapchain, NULL);
+
+    stbds_arrfree(draws);
 }
+#endif
 
 wn_render_t wn_render_init(wn_window_t* window)
 {
@@ -1661,8 +4063,22 @@ wn_render_t wn_render_init(wn_window_t* window)
         exit(err);
     }
 
-    // FIXME: Just picking first device rn
-    VkPhysicalDevice gpu = gpus[0];
+    // FIXME: Just picking the first device that has the features wn_device_new requires
+    VkPhysicalDevice gpu = NULL;
+    for (uint32_t i = 0; i < n_gpus && !gpu; i++)
+    {
+        VkPhysicalDeviceFeatures features;
+        vkGetPhysicalDeviceFeatures(gpus[i], &features);
+        if (features.samplerAnisotropy && features.fragmentStoresAndAtomics)
+        {
+            gpu = gpus[i];
+        }
+    }
+    if (!gpu)
+    {
+        log_fatal("No gpu supports sampler anisotropy and fragment stores and atomics");
+        exit(EXIT_FAILURE);
+    }
 
     render.device = wn_device_new(gpu);
     wn_device_t* device = &render.device;
@@ -1685,88 +4101,170 @@ wn_render_t wn_render_init(wn_window_t* window)
     /*
      *  render pass
      */
-    VkAttachmentDescription color_attachment = {
-        .format = surface->format.format,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-    };
+    render.render_pass = wn_render_pass_new(device, surface->format.format);
 
-    VkAttachmentDescription depth_attachment = {
-        .format = VK_FORMAT_D32_SFLOAT, // FIXME: would need to access depth format on individual
-                                        // frame_t inside of swapchain, too much indirection
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-    };
+    /*
+     *  command pools
+     */
+    // the render thread is index 0 of the job threads
+    render.jobs = malloc(sizeof(wn_job_system_t));
+    assert(render.jobs);
+    wn_job_system_init(render.jobs, 0);
+    wn_command_pools_init(
+        &render.commands,
+        device->device,
+        device->qfi.graphics,
+        MAX_FRAMES_IN_FLIGHT,
+        render.jobs->n_threads + 1);
+    wn_command_pools_init(
+        &render.compute_commands,
+        device->device,
+        device->qfi.compute,
+        MAX_FRAMES_IN_FLIGHT,
+        1);
 
-    VkAttachmentReference color_attachment_ref = {
-        .attachment = 0,
-        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-    };
+    log_info(
+        "Meshlet culling on the %s queue",
+        device->qfi.compute != device->qfi.graphics ? "async compute" : "graphics");
 
-    VkAttachmentReference depth_attachment_ref = {
-        .attachment = 1,
-        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-    };
+    render.staging = wn_staging_new(device, STAGING_RING_SIZE);
+    render.uniforms = wn_uniform_arena_new(device, UNIFORM_ARENA_SIZE);
 
-    VkSubpassDescription subpass_desc = {
-        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-        .colorAttachmentCount = 1,
-        .pColorAttachments = &color_attachment_ref,
-        .pDepthStencilAttachment = &depth_attachment_ref,
-    };
+    /*
+     *  assets
+     */
+    render.mesh_arena = malloc(sizeof(wn_mesh_arena_t));
+    assert(render.mesh_arena);
+    *render.mesh_arena = wn_mesh_arena_new(MESH_ARENA_VERTICES, MESH_ARENA_INDICES);
 
-    VkSubpassDependency subpass_dependency = {
-        .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .dstSubpass = 0,
-        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-            | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-        .srcAccessMask = 0,
-        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-            | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-        .dstAccessMask
-        = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    enum
+    {
+        ASSET_COLOR_TEXTURE,
+        ASSET_MODEL,
+        ASSET_CULL_SHADER,
+        ASSET_VERT_SHADER,
+        ASSET_FRAG_SHADER,
+        N_ASSETS,
     };
-
-    VkRenderPassCreateInfo render_pass_info = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .attachmentCount = 2,
-        .pAttachments = (VkAttachmentDescription[]) { color_attachment, depth_attachment },
-        .subpassCount = 1,
-        .pSubpasses = &subpass_desc,
-        .dependencyCount = 1,
-        .pDependencies = &subpass_dependency,
+    wn_asset_t assets[N_ASSETS] = {
+        [ASSET_COLOR_TEXTURE] = {
+            .kind = WN_ASSET_TEXTURE,
+            .path = "../assets/textures/uv_test_1k.png",
+        },
+        [ASSET_MODEL] = {
+            .kind = WN_ASSET_MESH,
+            .path = "../assets/models/viking_room.obj",
+        },
+        [ASSET_CULL_SHADER] = {
+            .kind = WN_ASSET_SHADER,
+            .path = "../assets/shaders/meshlet_cull.comp",
+            .shader_stage = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+        [ASSET_VERT_SHADER] = {
+            .kind = WN_ASSET_SHADER,
+            .path = "../assets/shaders/triangle.vert",
+            .shader_stage = VK_SHADER_STAGE_VERTEX_BIT,
+        },
+        [ASSET_FRAG_SHADER] = {
+            .kind = WN_ASSET_SHADER,
+            .path = "../assets/shaders/triangle.frag",
+            .shader_stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
     };
+    wn_asset_load(&render, device, assets, N_ASSETS);
+
+    render.color_texture = assets[ASSET_COLOR_TEXTURE].texture;
+    if (assets[ASSET_COLOR_TEXTURE].baked.mapping)
+    {
+        render.color_stream = wn_texture_stream_new(&assets[ASSET_COLOR_TEXTURE].baked);
+    }
 
-    WN_VK_CHECK(vkCreateRenderPass(device->device, &render_pass_info, NULL, &render.render_pass));
 
     /*
-     *  command pool
+     *  meshlet culling pipeline
      */
-    VkCommandPoolCreateInfo command_pool_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .queueFamilyIndex = device->qfi.graphics,
-        .flags = 0,
-        .pNext = NULL,
-    };
+    VkDescriptorSetLayoutBinding cull_bindings[7];
+    for (uint32_t i = 0; i < 7; i++)
+    {
+        cull_bindings[i] = (VkDescriptorSetLayoutBinding) {
+            .binding = i,
+            .descriptorCount = 1,
+            .descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+                                     : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        };
+    }
 
-    WN_VK_CHECK(
-        vkCreateCommandPool(device->device, &command_pool_info, NULL, &render.command_pool));
+    WN_VK_CHECK(vkCreateDescriptorSetLayout(
+        device->device,
+        &(VkDescriptorSetLayoutCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = 7,
+            .pBindings = cull_bindings,
+            .flags = 0,
+            .pNext = NULL,
+        },
+        NULL,
+        &render.cull_desc_set_layout));
 
-    /*
-     * babby's first texture
-     */
-    render.color_texture
-        = wn_texture_new(device, render.command_pool, "../assets/textures/uv_test_1k.png");
+    WN_VK_CHECK(vkCreatePipelineLayout(
+        device->device,
+        &(VkPipelineLayoutCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &render.cull_desc_set_layout,
+            .pushConstantRangeCount = 0,
+            .pPushConstantRanges = NULL,
+            .flags = 0,
+            .pNext = NULL,
+        },
+        NULL,
+        &render.cull_pipeline_layout));
+
+    const wn_shader_t cull = assets[ASSET_CULL_SHADER].shader;
+
+    VkShaderModule cull_sm;
+    WN_VK_CHECK(vkCreateShaderModule(
+        device->device,
+        &(VkShaderModuleCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .codeSize = cull.size,
+            .pCode = cull.spirv,
+        },
+        NULL,
+        &cull_sm));
+
+    WN_VK_CHECK(vkCreateComputePipelines(
+        device->device,
+        NULL,
+        1,
+        &(VkComputePipelineCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = cull.shader_stage,
+                .module = cull_sm,
+                .pName = cull.entry,
+                .pSpecializationInfo = &(VkSpecializationInfo) {
+                    .mapEntryCount = 1,
+                    .pMapEntries = &(VkSpecializationMapEntry) {
+                        .constantID = 0,
+                        .offset = 0,
+                        .size = sizeof(VkBool32),
+                    },
+                    .dataSize = sizeof(VkBool32),
+                    .pData = &(VkBool32) { render.index_size == 2 },
+                },
+            },
+            .layout = render.cull_pipeline_layout,
+            .basePipelineHandle = NULL,
+            .basePipelineIndex = -1,
+        },
+        NULL,
+        &render.cull_pipeline));
+
+    vkDestroyShaderModule(device->device, cull_sm, NULL);
 
     /*
      *    swapchain
@@ -1780,16 +4278,8 @@ wn_render_t wn_render_init(wn_window_t* window)
      */
 
     // shaders
-    wn_shader_loader_t loader = wn_util_create_shader_loader();
-    wn_shader_t vert = wn_util_load_shader(
-        &loader,
-        "../assets/shaders/triangle.vert",
-        VK_SHADER_STAGE_VERTEX_BIT);
-    wn_shader_t frag = wn_util_load_shader(
-        &loader,
-        "../assets/shaders/triangle.frag",
-        VK_SHADER_STAGE_FRAGMENT_BIT);
-    wn_util_destroy_shader_loader(&loader);
+    const wn_shader_t vert = assets[ASSET_VERT_SHADER].shader;
+    const wn_shader_t frag = assets[ASSET_FRAG_SHADER].shader;
 
     VkShaderModuleCreateInfo vert_sm_info = {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
@@ -1825,8 +4315,10 @@ wn_render_t wn_render_init(wn_window_t* window)
         = { frag_shader_stage_info, vert_shader_stage_info };
 
     // vertex input
-    VkVertexInputBindingDescription binding_desc = wn_vertex_get_input_binding_desc();
-    VkVertexInputAttributeDescription* attrib_desc = wn_vertex_get_attribute_desc();
+    VkVertexInputBindingDescription binding_desc
+        = wn_vertex_get_input_binding_desc(&render.vertex_layout);
+    VkVertexInputAttributeDescription attrib_desc[2];
+    wn_vertex_get_attribute_desc(&render.vertex_layout, attrib_desc);
     VkPipelineVertexInputStateCreateInfo vert_input_state_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
         .vertexBindingDescriptionCount = 1,
@@ -1872,8 +4364,10 @@ wn_render_t wn_render_init(wn_window_t* window)
         .rasterizerDiscardEnable = VK_FALSE,
         .polygonMode = VK_POLYGON_MODE_FILL,
         .lineWidth = 1.0f,
-        .cullMode = VK_CULL_MODE_NONE,
-        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        // NOTE: must agree with the meshlet cone culling, obj triangles are counter clockwise and
+        // the projection flips y so they stay that way on screen
+        .cullMode = VK_CULL_MODE_BACK_BIT,
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
         .depthBiasEnable = VK_FALSE,
     };
 
@@ -1896,281 +4390,96 @@ wn_render_t wn_render_init(wn_window_t* window)
         .stencilTestEnable = false,
         .front = { 0 },
         .back = { 0 },
-        .flags = 0,
-        .pNext = NULL,
-    };
-
-    // color blending
-    VkPipelineColorBlendAttachmentState color_blend_attachment_state = {
-        .blendEnable = VK_FALSE,
-        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
-            | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-    };
-
-    VkPipelineColorBlendStateCreateInfo color_blend_state_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .logicOpEnable = VK_FALSE,
-        .attachmentCount = 1,
-        .pAttachments = &color_blend_attachment_state,
-    };
-
-    // TODO: dynamic state
-    VkPipelineDynamicStateCreateInfo dynamic_state_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-        .dynamicStateCount = 2,
-        .pDynamicStates
-        = (VkDynamicState[]) { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR },
-    };
-
-    // pipeline layout
-    VkPipelineLayoutCreateInfo pipeline_layout_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .setLayoutCount = 1,
-        .pSetLayouts = &render.swapchain.desc_set_layout,
-        .flags = 0,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges = NULL,
-        .pNext = NULL,
-    };
-
-    WN_VK_CHECK(vkCreatePipelineLayout(
-        device->device,
-        &pipeline_layout_info,
-        NULL,
-        &render.graphics_pipeline_layout));
-
-    // graphics pipeline
-    VkGraphicsPipelineCreateInfo graphics_pipeline_info = {
-        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .stageCount = 2,
-        .pStages = shader_stage_infos,
-        .pVertexInputState = &vert_input_state_info,
-        .pInputAssemblyState = &input_assembly_state_info,
-        .pViewportState = &viewport_state_info,
-        .pRasterizationState = &rasterization_state_info,
-        .pMultisampleState = &multisample_state_info,
-        .pDepthStencilState = &depth_stencil_state_info,
-        .pColorBlendState = &color_blend_state_info,
-        .pDynamicState = &dynamic_state_info,
-        .layout = render.graphics_pipeline_layout,
-        .renderPass = render.render_pass,
-        .subpass = 0,
-        .basePipelineHandle = NULL,
-        .basePipelineIndex = -1,
-    };
-
-    WN_VK_CHECK(vkCreateGraphicsPipelines(
-        device->device,
-        NULL,
-        1,
-        &graphics_pipeline_info,
-        NULL,
-        &render.graphics_pipeline));
-
-    vkDestroyShaderModule(device->device, vert_sm, NULL);
-    vkDestroyShaderModule(device->device, frag_sm, NULL);
-
-    render.mesh = wn_load_obj("../assets/models/viking_room.obj");
-
-    /*
-     *  vertex buffer
-     */
-    VkDeviceSize buffer_size = sizeof(render.mesh.vertices[0]) * render.mesh.n_vertices;
-
-    wn_buffer_t staging_buffer = wn_buffer_new(
-        device,
-        &(VkBufferCreateInfo) {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .size = buffer_size,
-            .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-            .flags = 0,
-            .queueFamilyIndexCount = 0,
-            .pQueueFamilyIndices = NULL,
-            .pNext = NULL,
-        },
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    void* data = NULL;
-    WN_VK_CHECK(vkMapMemory(device->device, staging_buffer.memory, 0, buffer_size, 0, &data));
-    memcpy(data, render.mesh.vertices, (size_t)buffer_size);
-    vkUnmapMemory(device->device, staging_buffer.memory);
-
-    render.vertex_buffer = wn_buffer_new(
-        device,
-        &(VkBufferCreateInfo) {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .size = buffer_size,
-            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-            .flags = 0,
-            .queueFamilyIndexCount = 0,
-            .pQueueFamilyIndices = NULL,
-            .pNext = NULL,
-        },
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    VkCommandBuffer transfer_cmd_buf = wn_begin_command_buffer(device->device, render.command_pool);
-
-    vkCmdCopyBuffer(
-        transfer_cmd_buf,
-        staging_buffer.handle,
-        render.vertex_buffer.handle,
-        1,
-        &(VkBufferCopy) { .srcOffset = 0, .dstOffset = 0, .size = buffer_size });
-
-    wn_end_command_buffer(
-        device->device,
-        render.command_pool,
-        transfer_cmd_buf,
-        device->transfer_queue);
-
-    wn_buffer_destroy(&staging_buffer, device->device);
-
-    /*
-     *  index buffer
-     */
-    buffer_size = sizeof(render.mesh.indices[0]) * render.mesh.n_indices;
-
-    staging_buffer = wn_buffer_new(
-        device,
-        &(VkBufferCreateInfo) {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .size = buffer_size,
-            .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-            .flags = 0,
-            .queueFamilyIndexCount = 0,
-            .pQueueFamilyIndices = NULL,
-            .pNext = NULL,
-        },
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    data = NULL;
-    WN_VK_CHECK(vkMapMemory(device->device, staging_buffer.memory, 0, buffer_size, 0, &data));
-    memcpy(data, render.mesh.indices, (size_t)buffer_size);
-    vkUnmapMemory(device->device, staging_buffer.memory);
-
-    render.index_buffer = wn_buffer_new(
-        device,
-        &(VkBufferCreateInfo) {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .size = buffer_size,
-            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-            .flags = 0,
-            .queueFamilyIndexCount = 0,
-            .pQueueFamilyIndices = NULL,
-            .pNext = NULL,
-        },
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    transfer_cmd_buf = wn_begin_command_buffer(device->device, render.command_pool);
-
-    vkCmdCopyBuffer(
-        transfer_cmd_buf,
-        staging_buffer.handle,
-        render.index_buffer.handle,
-        1,
-        &(VkBufferCopy) { .srcOffset = 0, .dstOffset = 0, .size = buffer_size });
-
-    wn_end_command_buffer(
-        device->device,
-        render.command_pool,
-        transfer_cmd_buf,
-        device->transfer_queue);
-
-    wn_buffer_destroy(&staging_buffer, device->device);
-
-    /*
-     *  command buffers // TODO: Pull out for per wn_frame_t draw buffer??
-     */
-    render.command_buffers = malloc(sizeof(VkCommandBuffer) * swapchain->n_frames);
-    assert(render.command_buffers);
-
-    VkCommandBufferAllocateInfo command_buffer_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = render.command_pool,
-        .commandBufferCount = swapchain->n_frames,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .flags = 0,
+        .pNext = NULL,
     };
-    WN_VK_CHECK(
-        vkAllocateCommandBuffers(device->device, &command_buffer_info, render.command_buffers));
-
-    for (uint32_t i = 0; i < swapchain->n_frames; i++)
-    {
-        VkCommandBufferBeginInfo command_buffer_begin_info = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        };
-
-        WN_VK_CHECK(vkBeginCommandBuffer(render.command_buffers[i], &command_buffer_begin_info));
 
-        VkRenderPassBeginInfo render_pass_begin_info = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .renderPass = render.render_pass,
-            .framebuffer = swapchain->frames[i].framebuffer,
-            .renderArea = {
-                .offset = { .x = 0, .y = 0 },
-                .extent = surface->extent,
-            },
-            .clearValueCount = 2,
-            .pClearValues = (VkClearValue[]) {  {.color = { 0.0f, 0.0f, 0.0f, 1.0f }}, {.depthStencil = {1.0f, 0.0f}}  },
-        };
+    // color blending
+    VkPipelineColorBlendAttachmentState color_blend_attachment_state = {
+        .blendEnable = VK_FALSE,
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+            | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
 
-        vkCmdBeginRenderPass(
-            render.command_buffers[i],
-            &render_pass_begin_info,
-            VK_SUBPASS_CONTENTS_INLINE);
+    VkPipelineColorBlendStateCreateInfo color_blend_state_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = 1,
+        .pAttachments = &color_blend_attachment_state,
+    };
 
-        vkCmdBindPipeline(
-            render.command_buffers[i],
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            render.graphics_pipeline);
+    // TODO: dynamic state
+    VkPipelineDynamicStateCreateInfo dynamic_state_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates
+        = (VkDynamicState[]) { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR },
+    };
 
-        vkCmdSetViewport(render.command_buffers[i], 0, 1, &viewport);
-        vkCmdSetScissor(render.command_buffers[i], 0, 1, &scissor);
+    // pipeline layout
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &render.swapchain.desc_set_layout,
+        .flags = 0,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &(VkPushConstantRange) {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(wn_draw_push_t),
+        },
+        .pNext = NULL,
+    };
 
-        VkDeviceSize offsets = { 0 };
-        vkCmdBindVertexBuffers(
-            render.command_buffers[i],
-            0,
-            1,
-            &render.vertex_buffer.handle,
-            &offsets);
-        vkCmdBindIndexBuffer(
-            render.command_buffers[i],
-            render.index_buffer.handle,
-            0,
-            VK_INDEX_TYPE_UINT32);
+    WN_VK_CHECK(vkCreatePipelineLayout(
+        device->device,
+        &pipeline_layout_info,
+        NULL,
+        &render.graphics_pipeline_layout));
 
-        vkCmdBindDescriptorSets(
-            render.command_buffers[i],
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            render.graphics_pipeline_layout,
-            0,
-            1,
-            &render.swapchain.frames[i].ubo_desc_set,
-            0,
-            NULL);
+    // graphics pipeline
+    VkGraphicsPipelineCreateInfo graphics_pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = 2,
+        .pStages = shader_stage_infos,
+        .pVertexInputState = &vert_input_state_info,
+        .pInputAssemblyState = &input_assembly_state_info,
+        .pViewportState = &viewport_state_info,
+        .pRasterizationState = &rasterization_state_info,
+        .pMultisampleState = &multisample_state_info,
+        .pDepthStencilState = &depth_stencil_state_info,
+        .pColorBlendState = &color_blend_state_info,
+        .pDynamicState = &dynamic_state_info,
+        .layout = render.graphics_pipeline_layout,
+        .renderPass = render.render_pass,
+        .subpass = 0,
+        .basePipelineHandle = NULL,
+        .basePipelineIndex = -1,
+    };
 
-        vkCmdDraw(render.command_buffers[i], render.mesh.n_vertices, 1, 0, 0);
-        // vkCmdDrawIndexed(render.command_buffers[i], render.mesh.n_indices, 1, 0, 0, 0);
+    WN_VK_CHECK(vkCreateGraphicsPipelines(
+        device->device,
+        NULL,
+        1,
+        &graphics_pipeline_info,
+        NULL,
+        &render.graphics_pipeline));
 
-        vkCmdEndRenderPass(render.command_buffers[i]);
+    vkDestroyShaderModule(device->device, vert_sm, NULL);
+    vkDestroyShaderModule(device->device, frag_sm, NULL);
 
-        WN_VK_CHECK(vkEndCommandBuffer(render.command_buffers[i]));
-    }
+    // command buffers are recorded every frame, see wn_draw
+#ifdef WN_BENCH_RECORDING
+    wn_draw_list_build(&render, 0);
+    wn_record_benchmark(&render);
+#endif
 
     /*
-     *  semaphores and fences
+     *  semaphores
      */
     VkSemaphoreCreateInfo semaphore_info = {
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
     };
-    VkFenceCreateInfo fence_info = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-    };
 
     render.image_available = (VkSemaphore*)malloc(sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
     assert(render.image_available);
@@ -2178,27 +4487,18 @@ wn_render_t wn_render_init(wn_window_t* window)
     render.render_finished = (VkSemaphore*)malloc(sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
     assert(render.render_finished);
 
-    render.in_flight = (VkFence*)malloc(sizeof(VkFence) * MAX_FRAMES_IN_FLIGHT);
-    assert(render.in_flight);
-
-    render.image_in_flight = (VkFence*)malloc(sizeof(VkFence) * swapchain->n_frames);
-    assert(render.image_in_flight);
-
-    for (uint32_t i = 0; i < swapchain->n_frames; i++)
-    {
-        render.image_in_flight[i] = NULL;
-    }
-
     for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
         WN_VK_CHECK(
             vkCreateSemaphore(device->device, &semaphore_info, NULL, &render.image_available[i]));
         WN_VK_CHECK(
             vkCreateSemaphore(device->device, &semaphore_info, NULL, &render.render_finished[i]));
-        WN_VK_CHECK(vkCreateFence(device->device, &fence_info, NULL, &render.in_flight[i]));
+        // nothing submitted yet, waiting on 0 returns right away
+        render.frame_values[i] = 0;
     }
 
     render.current_frame = 0;
+    render.frame_number = 0;
 
     return render;
 }
@@ -2211,11 +4511,6 @@ void wn_swapchain_recreate(wn_render_t* render, wn_window_t* window)
      */
     vkDeviceWaitIdle(device->device);
     wn_swapchain_destroy(device->device, &render->swapchain);
-    vkFreeCommandBuffers(
-        device->device,
-        render->command_pool,
-        render->swapchain.n_frames,
-        render->command_buffers);
     vkDestroyRenderPass(device->device, render->render_pass, NULL);
 
     free(render->surface.formats);
@@ -2226,160 +4521,165 @@ void wn_swapchain_recreate(wn_render_t* render, wn_window_t* window)
      */
     render->surface = wn_surface_new(render->surface.surface, device->gpu, window);
 
-    // TODO: renderpass recreation here is basically the same as in init
-
-    VkAttachmentDescription color_attachment = {
-        .format = render->surface.format.format,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-    };
-
-    VkAttachmentDescription depth_attachment = {
-        .format = VK_FORMAT_D32_SFLOAT, // FIXME: would need to access depth format on individual
-                                        // frame_t inside of swapchain, too much indirection
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-    };
+    render->render_pass = wn_render_pass_new(device, render->surface.format.format);
 
-    VkAttachmentReference color_attachment_ref = {
-        .attachment = 0,
-        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-    };
+    render->swapchain = wn_swapchain_new(render, device, &render->surface, render->render_pass);
+}
 
-    VkAttachmentReference depth_attachment_ref = {
-        .attachment = 1,
-        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-    };
+// starts building a texture holding mips [mip, n_mips) next to color_texture, rendering carries on
+static void wn_texture_stream_begin(wn_render_t* render, uint32_t mip)
+{
+    wn_device_t* device = &render->device;
+    wn_texture_stream_t* stream = &render->color_stream;
 
-    VkSubpassDescription subpass_desc = {
-        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-        .colorAttachmentCount = 1,
-        .pColorAttachments = &color_attachment_ref,
-        .pDepthStencilAttachment = &depth_attachment_ref,
-    };
+    stream->pending = wn_texture_new_baked(
+        device,
+        &render->staging,
+        &stream->file,
+        mip,
+        &render->color_texture);
+    stream->pending_mip = mip;
+    stream->pending_batch = wn_staging_flush(&render->staging, device->device);
+    stream->has_pending = true;
+}
 
-    VkSubpassDependency subpass_dependency = {
-        .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .dstSubpass = 0,
-        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-            | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-        .srcAccessMask = 0,
-        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-            | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-        .dstAccessMask
-        = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-    };
+// swaps the finished pending texture in for color_texture
+static void wn_texture_stream_swap(wn_render_t* render)
+{
+    wn_texture_stream_t* stream = &render->color_stream;
 
-    VkRenderPassCreateInfo render_pass_info = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .attachmentCount = 2,
-        .pAttachments = (VkAttachmentDescription[]) { color_attachment, depth_attachment },
-        .subpassCount = 1,
-        .pSubpasses = &subpass_desc,
-        .dependencyCount = 1,
-        .pDependencies = &subpass_dependency,
+    // frames already submitted may still sample the old texture, every later one rebinds first
+    wn_retired_texture_t retired = {
+        .texture = render->color_texture,
+        .graphics_value = render->device.graphics_timeline->value,
     };
+    stbds_arrput(stream->retired, retired);
 
-    WN_VK_CHECK(vkCreateRenderPass(device->device, &render_pass_info, NULL, &render->render_pass));
+    render->color_texture = stream->pending;
+    stream->resident_mip = stream->pending_mip;
+    stream->pending = (wn_texture_t) { 0 };
+    stream->has_pending = false;
+    stream->n_swaps++;
 
-    render->swapchain = wn_swapchain_new(render, device, &render->surface, render->render_pass);
+    log_info(
+        "Texture stream: mips %u-%u resident, %zu KiB",
+        stream->resident_mip,
+        stream->file.n_mips - 1,
+        (size_t)wn_texture_stream_size(stream, stream->resident_mip) / 1024);
+}
 
-    VkCommandBufferAllocateInfo command_buffer_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = render->command_pool,
-        .commandBufferCount = render->swapchain.n_frames,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-    };
-    WN_VK_CHECK(
-        vkAllocateCommandBuffers(device->device, &command_buffer_info, render->command_buffers));
+// destroys the swapped out textures no submitted frame can sample anymore
+static void wn_texture_stream_retire(wn_render_t* render)
+{
+    wn_texture_stream_t* stream = &render->color_stream;
+    if (stbds_arrlen(stream->retired) == 0)
+    {
+        return;
+    }
 
-    for (uint32_t i = 0; i < render->swapchain.n_frames; i++)
+    VkDevice device = render->device.device;
+    const wn_timeline_t* graphics = render->device.graphics_timeline;
+    for (ptrdiff_t i = stbds_arrlen(stream->retired) - 1; i >= 0; i--)
     {
-        VkCommandBufferBeginInfo command_buffer_begin_info = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        };
+        if (wn_timeline_reached(graphics, device, stream->retired[i].graphics_value))
+        {
+            wn_texture_destroy(&stream->retired[i].texture, device);
+            stbds_arrdelswap(stream->retired, i);
+        }
+    }
+}
 
-        WN_VK_CHECK(vkBeginCommandBuffer(render->command_buffers[i], &command_buffer_begin_info));
+// points frame's descriptor set at color_texture if it was swapped since, frame must be idle
+static void wn_frame_bind_texture(wn_render_t* render, wn_frame_t* frame)
+{
+    if (frame->texture_swaps == render->color_stream.n_swaps)
+    {
+        return;
+    }
 
-        VkRenderPassBeginInfo render_pass_begin_info = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .renderPass = render->render_pass,
-            .framebuffer = render->swapchain.frames[i].framebuffer,
-            .renderArea = {
-                .offset = { .x = 0, .y = 0 },
-                .extent = render->surface.extent,
-            },
-            .clearValueCount = 2,
-            .pClearValues = (VkClearValue[]) { {.color =  0.0f, 0.0f, 0.0f, 1.0f }, {.depthStencil = {1.0f, 0.0f}}  },
-        };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = frame->ubo_desc_set,
+        .dstBinding = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .pBufferInfo = NULL,
+        .pImageInfo = &(VkDescriptorImageInfo) {
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .imageView = render->color_texture.view,
+            .sampler = render->color_texture.sampler,
+        },
+        .pTexelBufferView = NULL,
+        .pNext = NULL,
+    };
+    vkUpdateDescriptorSets(render->device.device, 1, &write, 0, NULL);
+    frame->texture_swaps = render->color_stream.n_swaps;
+}
 
-        vkCmdBeginRenderPass(
-            render->command_buffers[i],
-            &render_pass_begin_info,
-            VK_SUBPASS_CONTENTS_INLINE);
-
-        vkCmdBindPipeline(
-            render->command_buffers[i],
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            render->graphics_pipeline);
-
-        // dynamic states
-        VkViewport viewport = {
-            .x = 0.0f,
-            .y = 0.0f,
-            .width = (float)render->surface.extent.width,
-            .height = (float)render->surface.extent.height,
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f,
-        };
+/*
+ * Reads the feedback the last frame on image_index left behind, which must be done on the gpu.
+ * At most one mip is streamed in at a time, the finest one is evicted once nothing sampled it for
+ * TEXTURE_STREAM_IDLE_FRAMES and then mips are dropped towards the tail until the budget fits.
+ * Residency is contiguous, so the least recently used mip is always the finest resident one.
+ * Changes upload on the transfer queue while frames keep rendering with the current texture.
+ */
+static void wn_texture_stream_update(wn_render_t* render, uint32_t image_index)
+{
+    wn_texture_stream_t* stream = &render->color_stream;
+    if (!stream->file.mapping)
+    {
+        return;
+    }
 
-        VkRect2D scissor = {
-            .extent = render->surface.extent,
-            .offset = { .x = 0, .y = 0 },
-        };
+    wn_texture_stream_retire(render);
 
-        vkCmdSetViewport(render->command_buffers[i], 0, 1, &viewport);
-        vkCmdSetScissor(render->command_buffers[i], 0, 1, &scissor);
+    wn_texture_feedback_t* feedback = render->swapchain.frames[image_index].texture_feedback_data;
+    uint32_t requested = feedback->min_mip;
+    feedback->min_mip = UINT32_MAX;
 
-        VkDeviceSize offsets = { 0 };
-        vkCmdBindVertexBuffers(
-            render->command_buffers[i],
-            0,
-            1,
-            &render->vertex_buffer.handle,
-            &offsets);
-        vkCmdBindIndexBuffer(
-            render->command_buffers[i],
-            render->index_buffer.handle,
-            0,
-            VK_INDEX_TYPE_UINT32);
+    stream->frame++;
+    for (uint32_t mip = requested; mip < stream->file.n_mips; mip++)
+    {
+        stream->last_used[mip] = stream->frame;
+    }
 
-        vkCmdBindDescriptorSets(
-            render->command_buffers[i],
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            render->graphics_pipeline_layout,
-            0,
-            1,
-            &render->swapchain.frames[i].ubo_desc_set,
-            0,
-            NULL);
+    if (stream->has_pending)
+    {
+        if (wn_staging_done(&render->staging, render->device.device, stream->pending_batch))
+        {
+            wn_texture_stream_swap(render);
+        }
+        return;
+    }
 
-        vkCmdDraw(render->command_buffers[i], render->mesh.n_vertices, 1, 0, 0);
-        // vkCmdDrawIndexed(render->command_buffers[i], render->mesh.n_indices, 1, 0, 0, 0);
+    // the old and the new texture coexist until the swap, both have to fit the heap's budget
+    const wn_device_t* device = &render->device;
+    uint32_t memory_type = render->color_texture.image.allocation.memory_type;
+    uint32_t heap = device->gpu_memory_properties.memoryTypes[memory_type].heapIndex;
+    VkDeviceSize headroom = wn_gpu_heap_headroom(device->allocator, heap);
 
-        vkCmdEndRenderPass(render->command_buffers[i]);
+    uint32_t mip = stream->resident_mip;
+    if (requested < mip && wn_texture_stream_size(stream, mip - 1) <= stream->budget
+        && wn_texture_stream_size(stream, mip - 1) <= headroom)
+    {
+        mip--;
+    }
+    else if (mip < stream->tail_mip
+             && (stream->frame - stream->last_used[mip] > TEXTURE_STREAM_IDLE_FRAMES
+                 || headroom == 0))
+    {
+        // idle, or the heap is over budget and dropping the finest mip frees the most
+        mip++;
+    }
+    while (mip < stream->tail_mip && wn_texture_stream_size(stream, mip) > stream->budget)
+    {
+        mip++;
+    }
 
-        WN_VK_CHECK(vkEndCommandBuffer(render->command_buffers[i]));
+    if (mip != stream->resident_mip)
+    {
+        wn_texture_stream_begin(render, mip);
     }
 }
 
@@ -2387,12 +4687,14 @@ void wn_draw(wn_render_t* render, wn_window_t* window)
 {
     wn_device_t* device = &render->device;
 
-    vkWaitForFences(
+    // the last draw of this frame in flight, culling of the frame is done too, the draw waited
+    // for it
+    wn_timeline_wait(
+        device->graphics_timeline,
         device->device,
-        1,
-        &render->in_flight[render->current_frame],
-        VK_TRUE,
-        UINT64_MAX);
+        render->frame_values[render->current_frame]);
+    wn_command_pools_reset(&render->commands, (uint32_t)render->current_frame);
+    wn_command_pools_reset(&render->compute_commands, (uint32_t)render->current_frame);
 
     uint32_t image_index;
     VkResult result = vkAcquireNextImageKHR(
@@ -2421,58 +4723,147 @@ void wn_draw(wn_render_t* render, wn_window_t* window)
     wn_mat4f_t m = wn_mat4f_from_rotation_z(glfwGetTime());
     m = wn_mat4f_transpose(&m);
 
+    float fov = M_PI_4;
     wn_mvp_t mvp = {
         .model = m,
         .view = wn_mat4f_look_at(&eye, &at, &up),
         .proj = wn_mat4f_perspective(
-            M_PI_4,
+            fov,
             (float)render->surface.extent.width / (float)render->surface.extent.height,
             0.1f,
             10.0f),
     };
 
-    void* data = NULL;
-    WN_VK_CHECK(vkMapMemory(
-        device->device,
-        render->swapchain.frames[image_index].ubo.memory,
-        0,
-        sizeof(mvp),
-        0,
-        &data));
-    memcpy(data, &mvp, sizeof(mvp));
-    vkUnmapMemory(device->device, render->swapchain.frames[image_index].ubo.memory);
+    // lod from the distance to the bounding sphere, model is a pure rotation about the origin so
+    // only the center needs transforming
+    const wn_mesh_t* mesh = &render->mesh;
+    wn_v3f_t center = {
+        .x = (mesh->bounds_min.x + mesh->bounds_max.x) * 0.5f,
+        .y = (mesh->bounds_min.y + mesh->bounds_max.y) * 0.5f,
+        .z = (mesh->bounds_min.z + mesh->bounds_max.z) * 0.5f,
+    };
+    wn_v3f_t half = {
+        .x = (mesh->bounds_max.x - mesh->bounds_min.x) * 0.5f,
+        .y = (mesh->bounds_max.y - mesh->bounds_min.y) * 0.5f,
+        .z = (mesh->bounds_max.z - mesh->bounds_min.z) * 0.5f,
+    };
+    wn_v3f_t world = {
+        .x = m.xx * center.x + m.yx * center.y + m.zx * center.z + m.wx,
+        .y = m.xy * center.x + m.yy * center.y + m.zy * center.z + m.wy,
+        .z = m.xz * center.x + m.yz * center.y + m.zz * center.z + m.wz,
+    };
+    wn_v3f_t to_eye = wn_v3f_minus(&eye, &world);
+    float distance = wn_v3f_magnitude(&to_eye) - wn_v3f_magnitude(&half);
+    float proj_scale = (float)render->surface.extent.height / (2.0f * tanf(fov * 0.5f));
+
+    render->mesh_lod
+        = wn_mesh_select_lod(mesh, render->mesh_lod, distance, proj_scale, LOD_THRESHOLD_PX);
+    mvp.first_meshlet = mesh->lods[render->mesh_lod].first_meshlet;
+    mvp.n_meshlets = mesh->lods[render->mesh_lod].n_meshlets;
+    wn_draw_list_build(render, render->mesh_lod);
+
+    wn_gpu_allocator_update_budget(device->allocator);
+    if (render->frame_number++ % MEMORY_STATS_LOG_FRAMES == 0)
+    {
+        wn_gpu_allocator_log_stats(device->allocator);
+    }
 
-    if (render->image_in_flight[image_index] != NULL)
+    // the wait above already covers everything that read this frame's uniforms
+    uint32_t mvp_offset = 0;
+    wn_uniform_arena_begin(&render->uniforms, (uint32_t)render->current_frame);
+    memcpy(
+        wn_uniform_arena_alloc(&render->uniforms, sizeof(mvp), &mvp_offset),
+        &mvp,
+        sizeof(mvp));
+    assert(mvp_offset == wn_uniform_arena_base(&render->uniforms, render->current_frame));
+    (void)mvp_offset;
+
+    // the image's descriptor set and feedback buffer, usually long done unless images are
+    // acquired out of order. 0 until something was drawn to the image, see wn_swapchain_new
+    wn_frame_t* frame = &render->swapchain.frames[image_index];
+    wn_timeline_wait(device->graphics_timeline, device->device, frame->graphics_value);
+
+    wn_texture_stream_update(render, image_index);
+
+    // nothing submitted on this image is pending anymore
+    wn_frame_bind_texture(render, frame);
+
+    VkCommandBuffer draw_cmd = wn_record_frame(render, image_index);
+
+    bool cull_meshlets = render->mesh.n_meshlets > 0;
+    if (cull_meshlets)
     {
-        vkWaitForFences(
-            device->device,
-            1,
-            &render->image_in_flight[image_index],
-            VK_TRUE,
-            UINT64_MAX);
+        VkCommandBuffer cull_cmd = wn_record_cull(render, frame);
+
+        // culling overwrites the outputs the last frame on this image drew from
+        uint64_t cull_wait_value = frame->graphics_value;
+        uint64_t cull_signal_value = ++device->compute_timeline->value;
+        VkTimelineSemaphoreSubmitInfo cull_timeline_info = {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = 1,
+            .pWaitSemaphoreValues = &cull_wait_value,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &cull_signal_value,
+        };
+        VkPipelineStageFlags cull_wait_stage
+            = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+        VkSubmitInfo cull_submit_info = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = &cull_timeline_info,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &device->graphics_timeline->semaphore,
+            .pWaitDstStageMask = &cull_wait_stage,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &cull_cmd,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &device->compute_timeline->semaphore,
+        };
+
+        WN_VK_CHECK(vkQueueSubmit(device->compute_queue, 1, &cull_submit_info, VK_NULL_HANDLE));
     }
-    render->image_in_flight[image_index] = render->in_flight[render->current_frame];
 
-    VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    // the draw waits on culling only once it needs its outputs, values of binary semaphores are
+    // ignored
+    VkSemaphore wait_semaphores[] = {
+        render->image_available[render->current_frame],
+        device->compute_timeline->semaphore,
+    };
+    VkPipelineStageFlags wait_stages[] = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+    };
+    uint64_t wait_values[] = { 0, device->compute_timeline->value };
+
+    VkSemaphore signal_semaphores[] = {
+        render->render_finished[render->current_frame],
+        device->graphics_timeline->semaphore,
+    };
+    uint64_t signal_values[] = { 0, ++device->graphics_timeline->value };
+    frame->graphics_value = signal_values[1];
+    render->frame_values[render->current_frame] = signal_values[1];
+
+    VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = cull_meshlets ? 2 : 1,
+        .pWaitSemaphoreValues = wait_values,
+        .signalSemaphoreValueCount = 2,
+        .pSignalSemaphoreValues = signal_values,
+    };
 
     VkSubmitInfo submit_info = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &render->image_available[render->current_frame],
+        .pNext = &timeline_info,
+        .waitSemaphoreCount = cull_meshlets ? 2 : 1,
+        .pWaitSemaphores = wait_semaphores,
         .pWaitDstStageMask = wait_stages,
         .commandBufferCount = 1,
-        .pCommandBuffers = &render->command_buffers[image_index],
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &render->render_finished[render->current_frame],
+        .pCommandBuffers = &draw_cmd,
+        .signalSemaphoreCount = 2,
+        .pSignalSemaphores = signal_semaphores,
     };
 
-    vkResetFences(device->device, 1, &render->in_flight[render->current_frame]);
-
-    WN_VK_CHECK(vkQueueSubmit(
-        device->graphics_queue,
-        1,
-        &submit_info,
-        render->in_flight[render->current_frame]));
+    WN_VK_CHECK(vkQueueSubmit(device->graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
 
     VkPresentInfoKHR present_info = {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -2523,15 +4914,37 @@ void wn_destroy(wn_render_t* render)
     {
         vkDestroySemaphore(device->device, render->image_available[i], NULL);
         vkDestroySemaphore(device->device, render->render_finished[i], NULL);
-        vkDestroyFence(device->device, render->in_flight[i], NULL);
     }
 
     wn_texture_destroy(&render->color_texture, device->device);
+    if (render->color_stream.has_pending)
+    {
+        wn_texture_destroy(&render->color_stream.pending, device->device);
+    }
+    for (ptrdiff_t i = 0; i < stbds_arrlen(render->color_stream.retired); i++)
+    {
+        wn_texture_destroy(&render->color_stream.retired[i].texture, device->device);
+    }
+    stbds_arrfree(render->color_stream.retired);
+    if (render->color_stream.file.mapping)
+    {
+        wn_texture_file_unmap(&render->color_stream.file);
+    }
 
     wn_buffer_destroy(&render->vertex_buffer, device->device);
     wn_buffer_destroy(&render->index_buffer, device->device);
+    if (render->mesh.n_meshlets > 0)
+    {
+        wn_buffer_destroy(&render->meshlet_buffer, device->device);
+        wn_buffer_destroy(&render->meshlet_vertex_buffer, device->device);
+        wn_buffer_destroy(&render->meshlet_triangle_buffer, device->device);
+        wn_buffer_destroy(&render->submesh_transform_buffer, device->device);
+        wn_buffer_destroy(&render->cull_draw_reset, device->device);
+    }
 
     wn_mesh_destroy(&render->mesh);
+    wn_mesh_arena_destroy(render->mesh_arena);
+    free(render->mesh_arena);
 
     // FIXME
     wn_surface_destroy(&render->surface);
@@ -2539,14 +4952,42 @@ void wn_destroy(wn_render_t* render)
 
     vkDestroyPipeline(device->device, render->graphics_pipeline, NULL);
     vkDestroyPipelineLayout(device->device, render->graphics_pipeline_layout, NULL);
+    vkDestroyPipeline(device->device, render->cull_pipeline, NULL);
+    vkDestroyPipelineLayout(device->device, render->cull_pipeline_layout, NULL);
+    vkDestroyDescriptorSetLayout(device->device, render->cull_desc_set_layout, NULL);
     vkDestroyRenderPass(device->device, render->render_pass, NULL);
-    vkDestroyCommandPool(device->device, render->command_pool, NULL);
-    vkDestroyDevice(device->device, NULL);
+    wn_staging_destroy(&render->staging, device->device);
+    wn_uniform_arena_destroy(&render->uniforms, device->device);
+    wn_command_pools_shutdown(&render->commands);
+    wn_command_pools_shutdown(&render->compute_commands);
+    wn_job_system_shutdown(render->jobs);
+    free(render->jobs);
+    stbds_arrfree(render->draws);
+    free(render->image_available);
+    free(render->render_finished);
+    wn_device_destroy(device);
     vkDestroyInstance(render->instance, NULL);
 }
 
+// assets are decoded on worker threads, keep their log lines whole
+static void wn_log_lock(bool lock, void* udata)
+{
+    pthread_mutex_t* mutex = udata;
+    if (lock)
+    {
+        pthread_mutex_lock(mutex);
+    }
+    else
+    {
+        pthread_mutex_unlock(mutex);
+    }
+}
+
 int main(void)
 {
+    static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+    log_set_lock(wn_log_lock, &log_mutex);
+
 #ifndef NDEBUG
     log_set_level(LOG_TRACE);
 #else
@@ -2555,6 +4996,10 @@ int main(void)
 
     wn_window_t window = wn_window_new(1280, 720, "");
 
+#ifdef WN_BENCH_OBJ
+    wn_obj_benchmark();
+#endif
+
     wn_render_t render = wn_render_init(&window);
 
     while (!wn_window_should_close(&window))
@@ -0,0 +1,112 @@
+/*
+===========================================================================
+
+whynot::render::command.c: per thread, per frame command pools
+
+===========================================================================
+*/
+
+#include "command.h"
+
+#include "util_vk.inl"
+
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+void wn_command_pools_init(
+    wn_command_pools_t* pools,
+    VkDevice device,
+    uint32_t queue_family,
+    uint32_t n_frames,
+    uint32_t n_threads)
+{
+    assert(n_frames > 0 && n_threads > 0);
+
+    *pools = (wn_command_pools_t) {
+        .device = device,
+        .queue_family = queue_family,
+        .n_frames = n_frames,
+        .n_threads = n_threads,
+    };
+
+    size_t n_pools = (size_t)n_frames * n_threads;
+    pools->pools = aligned_alloc(WN_COMMAND_POOL_ALIGN, n_pools * sizeof(wn_command_pool_t));
+    assert(pools->pools);
+
+    VkCommandPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = queue_family,
+        // only ever reset as a whole
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .pNext = NULL,
+    };
+
+    for (size_t i = 0; i < n_pools; i++)
+    {
+        pools->pools[i] = (wn_command_pool_t) { 0 };
+        WN_VK_CHECK(vkCreateCommandPool(device, &pool_info, NULL, &pools->pools[i].pool));
+    }
+}
+
+void wn_command_pools_shutdown(wn_command_pools_t* pools)
+{
+    for (size_t i = 0; i < (size_t)pools->n_frames * pools->n_threads; i++)
+    {
+        // destroying the pool frees its buffers
+        vkDestroyCommandPool(pools->device, pools->pools[i].pool, NULL);
+        stbds_arrfree(pools->pools[i].buffers[VK_COMMAND_BUFFER_LEVEL_PRIMARY]);
+        stbds_arrfree(pools->pools[i].buffers[VK_COMMAND_BUFFER_LEVEL_SECONDARY]);
+    }
+    free(pools->pools);
+    *pools = (wn_command_pools_t) { 0 };
+}
+
+void wn_command_pools_reset(wn_command_pools_t* pools, uint32_t frame)
+{
+    assert(frame < pools->n_frames);
+
+    for (uint32_t t = 0; t < pools->n_threads; t++)
+    {
+        wn_command_pool_t* pool = &pools->pools[frame * pools->n_threads + t];
+        if (pool->n_used[0] == 0 && pool->n_used[1] == 0)
+        {
+            continue;
+        }
+
+        WN_VK_CHECK(vkResetCommandPool(pools->device, pool->pool, 0));
+        pool->n_used[0] = 0;
+        pool->n_used[1] = 0;
+    }
+}
+
+VkCommandBuffer wn_command_pools_get(
+    wn_command_pools_t* pools,
+    uint32_t frame,
+    uint32_t thread,
+    VkCommandBufferLevel level)
+{
+    assert(frame < pools->n_frames && thread < pools->n_threads);
+    assert(level == VK_COMMAND_BUFFER_LEVEL_PRIMARY || level == VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+    wn_command_pool_t* pool = &pools->pools[frame * pools->n_threads + thread];
+
+    if (pool->n_used[level] == (uint32_t)stbds_arrlen(pool->buffers[level]))
+    {
+        VkCommandBufferAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pool->pool,
+            .commandBufferCount = 1,
+            .level = level,
+            .pNext = NULL,
+        };
+
+        VkCommandBuffer cmd = NULL;
+        WN_VK_CHECK(vkAllocateCommandBuffers(pools->device, &alloc_info, &cmd));
+        stbds_arrput(pool->buffers[level], cmd);
+    }
+
+    return pool->buffers[level][pool->n_used[level]++];
+}
@@ -0,0 +1,64 @@
+/*
+===========================================================================
+
+whynot::render::command.h: per thread, per frame command pools
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "render_types.h"
+
+#include <vulkan/vulkan.h>
+
+// pools of different threads never share a cache line
+#define WN_COMMAND_POOL_ALIGN 64u
+
+/*
+ * Command buffers handed out since the last reset, kept allocated across resets and handed out
+ * again in the same order so a steady frame never calls vkAllocateCommandBuffers.
+ */
+typedef struct wn_command_pool_t
+{
+    _Alignas(WN_COMMAND_POOL_ALIGN) VkCommandPool pool;
+    VkCommandBuffer* buffers[2]; // stbds arrays by VkCommandBufferLevel
+    uint32_t n_used[2];
+} wn_command_pool_t;
+
+/*
+ * One transient pool per thread per frame in flight on a single queue family. A thread only ever
+ * touches the pools at its own index, so handing out buffers takes no locks. Buffers live until
+ * their frame comes around again and the whole pool is reset at once.
+ */
+typedef struct wn_command_pools_t
+{
+    VkDevice device;
+    uint32_t queue_family;
+    uint32_t n_frames;
+    uint32_t n_threads;
+    wn_command_pool_t* pools; // [frame * n_threads + thread]
+} wn_command_pools_t;
+
+void wn_command_pools_init(
+    wn_command_pools_t* pools,
+    VkDevice device,
+    uint32_t queue_family,
+    uint32_t n_frames,
+    uint32_t n_threads);
+
+// the gpu has to be done with every frame
+void wn_command_pools_shutdown(wn_command_pools_t* pools);
+
+/*
+ * Recycles every buffer of frame on all threads, only once the gpu is done with the frame and
+ * while no thread records into it.
+ */
+void wn_command_pools_reset(wn_command_pools_t* pools, uint32_t frame);
+
+// a buffer in the initial state, only call it with the index of the calling thread
+VkCommandBuffer wn_command_pools_get(
+    wn_command_pools_t* pools,
+    uint32_t frame,
+    uint32_t thread,
+    VkCommandBufferLevel level);
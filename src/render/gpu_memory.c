@@ -0,0 +1,569 @@
+/*
+===========================================================================
+
+whynot::render::gpu_memory.c: device memory suballocation
+
+===========================================================================
+*/
+
+#include "gpu_memory.h"
+
+#include "log.h"
+#include "tlsf.h"
+
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// ranges are handed out by a TLSF allocator over the block, see tlsf.h
+struct wn_gpu_memory_block_t
+{
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    uint8_t* mapped;
+    uint32_t memory_type;
+    wn_gpu_memory_kind kind;
+    wn_tlsf_t tlsf;
+};
+
+static inline VkDeviceSize wn_gpu_align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// expects the lock to be held
+static wn_result wn_gpu_memory_new(
+    wn_gpu_allocator_t* allocator,
+    uint32_t memory_type,
+    VkDeviceSize size,
+    VkDeviceMemory* memory,
+    uint8_t** mapped)
+{
+    VkMemoryAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = memory_type,
+    };
+    VkResult res = vkAllocateMemory(allocator->device, &alloc_info, NULL, memory);
+    if (res != VK_SUCCESS)
+    {
+        return WN_ERR;
+    }
+
+    *mapped = NULL;
+    if (allocator->memory_properties.memoryTypes[memory_type].propertyFlags
+        & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        res = vkMapMemory(allocator->device, *memory, 0, VK_WHOLE_SIZE, 0, (void**)mapped);
+        if (res != VK_SUCCESS)
+        {
+            vkFreeMemory(allocator->device, *memory, NULL);
+            return WN_ERR;
+        }
+    }
+
+    uint32_t heap = allocator->memory_properties.memoryTypes[memory_type].heapIndex;
+    allocator->heap_stats[heap].n_blocks++;
+    allocator->heap_stats[heap].reserved += size;
+
+    return WN_OK;
+}
+
+// expects the lock to be held
+static void wn_gpu_memory_destroy(
+    wn_gpu_allocator_t* allocator,
+    uint32_t memory_type,
+    VkDeviceSize size,
+    VkDeviceMemory memory)
+{
+    // freeing implicitly unmaps
+    vkFreeMemory(allocator->device, memory, NULL);
+
+    uint32_t heap = allocator->memory_properties.memoryTypes[memory_type].heapIndex;
+    allocator->heap_stats[heap].n_blocks--;
+    allocator->heap_stats[heap].reserved -= size;
+}
+
+// expects the lock to be held
+static wn_gpu_memory_block_t* wn_gpu_block_new(
+    wn_gpu_allocator_t* allocator,
+    uint32_t memory_type,
+    wn_gpu_memory_kind kind)
+{
+    uint32_t heap = allocator->memory_properties.memoryTypes[memory_type].heapIndex;
+
+    wn_gpu_memory_block_t* block = calloc(1, sizeof(wn_gpu_memory_block_t));
+    assert(block);
+
+    block->size = allocator->block_sizes[heap];
+    block->memory_type = memory_type;
+    block->kind = kind;
+    if (wn_gpu_memory_new(allocator, memory_type, block->size, &block->memory, &block->mapped)
+        != WN_OK)
+    {
+        free(block);
+        return NULL;
+    }
+
+    wn_tlsf_init(&block->tlsf, block->size, WN_GPU_MEMORY_GRANULARITY);
+
+    stbds_arrput(allocator->blocks[memory_type][kind], block);
+
+    return block;
+}
+
+// expects the lock to be held
+static void wn_gpu_block_destroy(wn_gpu_allocator_t* allocator, wn_gpu_memory_block_t* block)
+{
+    wn_gpu_memory_block_t** blocks = allocator->blocks[block->memory_type][block->kind];
+    for (ptrdiff_t i = 0; i < stbds_arrlen(blocks); i++)
+    {
+        if (blocks[i] == block)
+        {
+            stbds_arrdelswap(allocator->blocks[block->memory_type][block->kind], i);
+            break;
+        }
+    }
+
+    wn_gpu_memory_destroy(allocator, block->memory_type, block->size, block->memory);
+    wn_tlsf_shutdown(&block->tlsf);
+    free(block);
+}
+
+static const char* wn_gpu_memory_category_name(wn_gpu_memory_category category)
+{
+    switch (category)
+    {
+    case WN_GPU_MEMORY_CATEGORY_MESH:
+        return "mesh";
+    case WN_GPU_MEMORY_CATEGORY_TEXTURE:
+        return "texture";
+    case WN_GPU_MEMORY_CATEGORY_ATTACHMENT:
+        return "attachment";
+    case WN_GPU_MEMORY_CATEGORY_UNIFORM:
+        return "uniform";
+    case WN_GPU_MEMORY_CATEGORY_STAGING:
+        return "staging";
+    default:
+        return "unknown";
+    }
+}
+
+// expects the lock to be held
+static VkDeviceSize wn_gpu_heap_usage(const wn_gpu_allocator_t* allocator, uint32_t heap)
+{
+    if (!allocator->has_memory_budget)
+    {
+        return allocator->heap_stats[heap].reserved;
+    }
+
+    // blocks reserved or released since the driver was asked
+    VkDeviceSize reserved = allocator->heap_stats[heap].reserved;
+    VkDeviceSize usage = allocator->budget_usage[heap] + reserved;
+    if (usage < allocator->budget_reserved[heap])
+    {
+        return 0;
+    }
+    return usage - allocator->budget_reserved[heap];
+}
+
+void wn_gpu_allocator_init(
+    wn_gpu_allocator_t* allocator,
+    VkDevice device,
+    VkPhysicalDevice gpu,
+    bool has_memory_budget)
+{
+    *allocator = (wn_gpu_allocator_t) { 0 };
+
+    allocator->device = device;
+    allocator->gpu = gpu;
+    allocator->has_memory_budget = has_memory_budget;
+    vkGetPhysicalDeviceMemoryProperties(gpu, &allocator->memory_properties);
+    pthread_mutex_init(&allocator->lock, NULL);
+
+    for (uint32_t i = 0; i < allocator->memory_properties.memoryHeapCount; i++)
+    {
+        VkDeviceSize block_size = allocator->memory_properties.memoryHeaps[i].size / 8;
+        if (block_size > WN_GPU_MEMORY_MAX_BLOCK_SIZE)
+        {
+            block_size = WN_GPU_MEMORY_MAX_BLOCK_SIZE;
+        }
+        block_size = block_size / WN_GPU_MEMORY_GRANULARITY * WN_GPU_MEMORY_GRANULARITY;
+        allocator->block_sizes[i] = block_size;
+
+        // what most drivers end up reporting as the budget of an otherwise idle system
+        allocator->budgets[i] = allocator->memory_properties.memoryHeaps[i].size / 10 * 8;
+    }
+    wn_gpu_allocator_update_budget(allocator);
+
+    // resizable BAR exposes (nearly) all of vram to the cpu instead of a 256 MiB window
+    for (uint32_t i = 0; i < allocator->memory_properties.memoryTypeCount; i++)
+    {
+        const VkMemoryType* type = &allocator->memory_properties.memoryTypes[i];
+        VkMemoryPropertyFlags bar
+            = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        if ((type->propertyFlags & bar) == bar)
+        {
+            log_info(
+                "host visible device local memory: %llu MiB in heap %u",
+                (unsigned long long)(allocator->memory_properties.memoryHeaps[type->heapIndex].size
+                                     >> 20),
+                type->heapIndex);
+            break;
+        }
+    }
+}
+
+void wn_gpu_allocator_shutdown(wn_gpu_allocator_t* allocator)
+{
+    wn_gpu_allocator_log_stats(allocator);
+
+    pthread_mutex_lock(&allocator->lock);
+    for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; type++)
+    {
+        for (uint32_t kind = 0; kind < WN_GPU_MEMORY_KIND_COUNT; kind++)
+        {
+            while (stbds_arrlen(allocator->blocks[type][kind]) > 0)
+            {
+                wn_gpu_memory_block_t* block = allocator->blocks[type][kind][0];
+                if (block->tlsf.n_allocations > 0)
+                {
+                    log_error(
+                        "%u allocations still alive in a block of memory type %u",
+                        block->tlsf.n_allocations,
+                        type);
+                }
+                wn_gpu_block_destroy(allocator, block);
+            }
+            stbds_arrfree(allocator->blocks[type][kind]);
+        }
+    }
+    stbds_hmfree(allocator->memory_type_cache);
+    pthread_mutex_unlock(&allocator->lock);
+
+    pthread_mutex_destroy(&allocator->lock);
+    *allocator = (wn_gpu_allocator_t) { 0 };
+}
+
+static wn_result wn_gpu_alloc_type(
+    wn_gpu_allocator_t* allocator,
+    const VkMemoryRequirements* reqs,
+    uint32_t memory_type,
+    wn_gpu_memory_kind kind,
+    wn_gpu_memory_category category,
+    wn_gpu_allocation_t* allocation)
+{
+    *allocation = (wn_gpu_allocation_t) {
+        .size = reqs->size,
+        .memory_type = memory_type,
+        .category = category,
+        .allocator = allocator,
+        .node = WN_TLSF_NO_NODE,
+    };
+
+    uint32_t heap = allocator->memory_properties.memoryTypes[memory_type].heapIndex;
+    VkDeviceSize size = wn_gpu_align_up(reqs->size, WN_GPU_MEMORY_GRANULARITY);
+    VkDeviceSize alignment = wn_gpu_align_up(reqs->alignment, WN_GPU_MEMORY_GRANULARITY);
+
+    pthread_mutex_lock(&allocator->lock);
+
+    // lazily allocated memory is only committed for the images bound to it, a shared block would
+    // commit all of it up front on drivers that back it at all
+    bool lazy = allocator->memory_properties.memoryTypes[memory_type].propertyFlags
+        & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+    wn_result res = WN_ERR;
+    if (!lazy && size + alignment <= allocator->block_sizes[heap] / 2)
+    {
+        wn_gpu_memory_block_t** blocks = allocator->blocks[memory_type][kind];
+        for (ptrdiff_t i = stbds_arrlen(blocks) - 1; i >= 0 && res != WN_OK; i--)
+        {
+            if (wn_tlsf_alloc(
+                    &blocks[i]->tlsf,
+                    size,
+                    alignment,
+                    &allocation->node,
+                    &allocation->offset))
+            {
+                allocation->block = blocks[i];
+                res = WN_OK;
+            }
+        }
+
+        if (res != WN_OK)
+        {
+            wn_gpu_memory_block_t* block = wn_gpu_block_new(allocator, memory_type, kind);
+            if (block
+                && wn_tlsf_alloc(
+                    &block->tlsf,
+                    size,
+                    alignment,
+                    &allocation->node,
+                    &allocation->offset))
+            {
+                allocation->block = block;
+                res = WN_OK;
+            }
+        }
+
+        if (res == WN_OK)
+        {
+            allocation->memory = allocation->block->memory;
+            if (allocation->block->mapped)
+            {
+                allocation->mapped = allocation->block->mapped + allocation->offset;
+            }
+        }
+    }
+
+    // too big to share a block, or no room for another block but maybe for just this
+    if (res != WN_OK)
+    {
+        res = wn_gpu_memory_new(
+            allocator,
+            memory_type,
+            reqs->size,
+            &allocation->memory,
+            &allocation->mapped);
+    }
+
+    if (res == WN_OK)
+    {
+        allocator->heap_stats[heap].n_allocations++;
+        allocator->heap_stats[heap].used += reqs->size;
+        allocator->category_stats[category].n_allocations++;
+        allocator->category_stats[category].used += reqs->size;
+    }
+
+    pthread_mutex_unlock(&allocator->lock);
+
+    return res;
+}
+
+uint32_t wn_gpu_find_memory_type(
+    wn_gpu_allocator_t* allocator,
+    uint32_t type_bits,
+    VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred)
+{
+    wn_gpu_memory_type_key_t key = {
+        .type_bits = type_bits,
+        .required = required,
+        .preferred = preferred,
+    };
+
+    pthread_mutex_lock(&allocator->lock);
+    ptrdiff_t cached = stbds_hmgeti(allocator->memory_type_cache, key);
+    if (cached >= 0)
+    {
+        uint32_t memory_type = allocator->memory_type_cache[cached].value;
+        pthread_mutex_unlock(&allocator->lock);
+        return memory_type;
+    }
+
+    uint32_t memory_type = UINT32_MAX;
+    int best_score = INT32_MIN;
+    for (uint32_t i = 0; i < allocator->memory_properties.memoryTypeCount; i++)
+    {
+        VkMemoryPropertyFlags flags = allocator->memory_properties.memoryTypes[i].propertyFlags;
+        if (!(type_bits & (1u << i)) || (flags & required) != required)
+        {
+            continue;
+        }
+        // protected memory can't be touched by regular submissions
+        if ((flags & VK_MEMORY_PROPERTY_PROTECTED_BIT)
+            && !(required & VK_MEMORY_PROPERTY_PROTECTED_BIT))
+        {
+            continue;
+        }
+
+        /*
+         * Every preferred flag outweighs every flag nobody asked for, the latter usually cost
+         * something (cached or device coherent memory, BAR space for a staging buffer). Ties keep
+         * the driver's order, which lists faster types first.
+         */
+        int score = 32 * __builtin_popcount(flags & preferred)
+                    - __builtin_popcount(flags & ~(required | preferred));
+        if (score > best_score)
+        {
+            best_score = score;
+            memory_type = i;
+        }
+    }
+
+    stbds_hmput(allocator->memory_type_cache, key, memory_type);
+    pthread_mutex_unlock(&allocator->lock);
+
+    return memory_type;
+}
+
+wn_result wn_gpu_alloc(
+    wn_gpu_allocator_t* allocator,
+    const VkMemoryRequirements* reqs,
+    VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred,
+    wn_gpu_memory_kind kind,
+    wn_gpu_memory_category category,
+    wn_gpu_allocation_t* allocation)
+{
+    // a full heap, e.g. a small BAR, falls back to the next best type
+    uint32_t type_bits = reqs->memoryTypeBits;
+    for (;;)
+    {
+        uint32_t memory_type = wn_gpu_find_memory_type(allocator, type_bits, required, preferred);
+        if (memory_type == UINT32_MAX)
+        {
+            break;
+        }
+        if (wn_gpu_alloc_type(allocator, reqs, memory_type, kind, category, allocation) == WN_OK)
+        {
+            return WN_OK;
+        }
+        type_bits &= ~(1u << memory_type);
+    }
+
+    log_error(
+        "Out of memory allocating %llu bytes of %s memory with properties 0x%x",
+        (unsigned long long)reqs->size,
+        wn_gpu_memory_category_name(category),
+        required);
+    *allocation = (wn_gpu_allocation_t) { 0 };
+    return WN_ERR;
+}
+
+void wn_gpu_free(wn_gpu_allocation_t* allocation)
+{
+    wn_gpu_allocator_t* allocator = allocation->allocator;
+    if (!allocator)
+    {
+        return;
+    }
+
+    uint32_t heap = allocator->memory_properties.memoryTypes[allocation->memory_type].heapIndex;
+
+    pthread_mutex_lock(&allocator->lock);
+
+    wn_gpu_memory_block_t* block = allocation->block;
+    if (block)
+    {
+        wn_tlsf_free(&block->tlsf, allocation->node);
+        if (block->tlsf.n_allocations == 0
+            && stbds_arrlen(allocator->blocks[block->memory_type][block->kind]) > 1)
+        {
+            wn_gpu_block_destroy(allocator, block);
+        }
+    }
+    else
+    {
+        wn_gpu_memory_destroy(
+            allocator,
+            allocation->memory_type,
+            allocation->size,
+            allocation->memory);
+    }
+
+    allocator->heap_stats[heap].n_allocations--;
+    allocator->heap_stats[heap].used -= allocation->size;
+    allocator->category_stats[allocation->category].n_allocations--;
+    allocator->category_stats[allocation->category].used -= allocation->size;
+
+    pthread_mutex_unlock(&allocator->lock);
+
+    *allocation = (wn_gpu_allocation_t) { 0 };
+}
+
+void wn_gpu_allocator_update_budget(wn_gpu_allocator_t* allocator)
+{
+    if (!allocator->has_memory_budget)
+    {
+        return;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+    };
+    VkPhysicalDeviceMemoryProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+        .pNext = &budget,
+    };
+    vkGetPhysicalDeviceMemoryProperties2(allocator->gpu, &properties);
+
+    pthread_mutex_lock(&allocator->lock);
+    for (uint32_t i = 0; i < allocator->memory_properties.memoryHeapCount; i++)
+    {
+        allocator->budget_usage[i] = budget.heapUsage[i];
+        allocator->budget_reserved[i] = allocator->heap_stats[i].reserved;
+        // some drivers leave heaps they don't track at 0
+        if (budget.heapBudget[i] > 0)
+        {
+            allocator->budgets[i] = budget.heapBudget[i];
+        }
+    }
+    pthread_mutex_unlock(&allocator->lock);
+}
+
+VkDeviceSize wn_gpu_heap_headroom(wn_gpu_allocator_t* allocator, uint32_t heap)
+{
+    pthread_mutex_lock(&allocator->lock);
+    VkDeviceSize usage = wn_gpu_heap_usage(allocator, heap);
+    VkDeviceSize budget = allocator->budgets[heap];
+    pthread_mutex_unlock(&allocator->lock);
+
+    return usage < budget ? budget - usage : 0;
+}
+
+void wn_gpu_allocator_stats(wn_gpu_allocator_t* allocator, wn_gpu_memory_stats_t* stats)
+{
+    pthread_mutex_lock(&allocator->lock);
+    stats->n_heaps = allocator->memory_properties.memoryHeapCount;
+    for (uint32_t i = 0; i < stats->n_heaps; i++)
+    {
+        stats->heaps[i] = allocator->heap_stats[i];
+        stats->heaps[i].usage = wn_gpu_heap_usage(allocator, i);
+        stats->heaps[i].budget = allocator->budgets[i];
+    }
+    for (uint32_t i = 0; i < WN_GPU_MEMORY_CATEGORY_COUNT; i++)
+    {
+        stats->categories[i] = allocator->category_stats[i];
+    }
+    pthread_mutex_unlock(&allocator->lock);
+}
+
+void wn_gpu_allocator_log_stats(wn_gpu_allocator_t* allocator)
+{
+    wn_gpu_memory_stats_t stats;
+    wn_gpu_allocator_stats(allocator, &stats);
+
+    for (uint32_t i = 0; i < stats.n_heaps; i++)
+    {
+        const wn_gpu_heap_stats_t* heap = &stats.heaps[i];
+        log_info(
+            "heap %u: %u allocations using %.1f MiB of %u blocks reserving %.1f MiB, process "
+            "usage %.1f of %.1f MiB budget",
+            i,
+            heap->n_allocations,
+            (double)heap->used / (1 << 20),
+            heap->n_blocks,
+            (double)heap->reserved / (1 << 20),
+            (double)heap->usage / (1 << 20),
+            (double)heap->budget / (1 << 20));
+    }
+
+    char line[256];
+    int length = 0;
+    for (uint32_t i = 0; i < WN_GPU_MEMORY_CATEGORY_COUNT && length < (int)sizeof(line); i++)
+    {
+        length += snprintf(
+            line + length,
+            sizeof(line) - (size_t)length,
+            "%s%s %.1f MiB (%u)",
+            i > 0 ? ", " : "",
+            wn_gpu_memory_category_name(i),
+            (double)stats.categories[i].used / (1 << 20),
+            stats.categories[i].n_allocations);
+    }
+    log_info("by category: %s", line);
+}
@@ -0,0 +1,169 @@
+/*
+===========================================================================
+
+whynot::render::gpu_memory.h: device memory suballocation
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "render_types.h"
+
+#include <pthread.h>
+#include <vulkan/vulkan.h>
+
+// offsets and sizes handed out are multiples of this
+#define WN_GPU_MEMORY_GRANULARITY 256u
+
+// never lets a block get bigger than this, heaps smaller than 8 blocks get smaller ones
+#define WN_GPU_MEMORY_MAX_BLOCK_SIZE ((VkDeviceSize)256u << 20)
+
+/*
+ * Buffers and linear images never share a block with optimal images, which keeps neighbours
+ * bufferImageGranularity apart without padding every allocation to it.
+ */
+typedef enum wn_gpu_memory_kind
+{
+    WN_GPU_MEMORY_LINEAR,
+    WN_GPU_MEMORY_OPTIMAL,
+    WN_GPU_MEMORY_KIND_COUNT,
+} wn_gpu_memory_kind;
+
+// what an allocation is for, only used for statistics
+typedef enum wn_gpu_memory_category
+{
+    WN_GPU_MEMORY_CATEGORY_MESH,
+    WN_GPU_MEMORY_CATEGORY_TEXTURE,
+    WN_GPU_MEMORY_CATEGORY_ATTACHMENT,
+    WN_GPU_MEMORY_CATEGORY_UNIFORM,
+    WN_GPU_MEMORY_CATEGORY_STAGING,
+    WN_GPU_MEMORY_CATEGORY_COUNT,
+} wn_gpu_memory_category;
+
+typedef struct wn_gpu_allocator_t wn_gpu_allocator_t;
+typedef struct wn_gpu_memory_block_t wn_gpu_memory_block_t;
+
+typedef struct wn_gpu_allocation_t
+{
+    VkDeviceMemory memory;
+    VkDeviceSize offset; // to bind at
+    VkDeviceSize size;
+    uint32_t memory_type;
+    wn_gpu_memory_category category;
+    uint8_t* mapped; // already offset, NULL unless the memory type is host visible
+
+    wn_gpu_allocator_t* allocator;
+    wn_gpu_memory_block_t* block; // NULL for a dedicated VkDeviceMemory
+    uint32_t node;
+} wn_gpu_allocation_t;
+
+typedef struct wn_gpu_heap_stats_t
+{
+    uint32_t n_blocks; // live VkDeviceMemory objects, dedicated ones included
+    uint32_t n_allocations;
+    VkDeviceSize reserved; // bytes allocated from the driver
+    VkDeviceSize used; // bytes handed out, alignment padding not included
+
+    // the whole process as the driver sees it, estimated from our blocks without
+    // VK_EXT_memory_budget
+    VkDeviceSize usage;
+    // what the process may use before the driver starts evicting or failing allocations
+    VkDeviceSize budget;
+} wn_gpu_heap_stats_t;
+
+typedef struct wn_gpu_category_stats_t
+{
+    uint32_t n_allocations;
+    VkDeviceSize used;
+} wn_gpu_category_stats_t;
+
+typedef struct wn_gpu_memory_stats_t
+{
+    uint32_t n_heaps;
+    wn_gpu_heap_stats_t heaps[VK_MAX_MEMORY_HEAPS];
+    wn_gpu_category_stats_t categories[WN_GPU_MEMORY_CATEGORY_COUNT];
+} wn_gpu_memory_stats_t;
+
+typedef struct wn_gpu_memory_type_key_t
+{
+    uint32_t type_bits;
+    VkMemoryPropertyFlags required;
+    VkMemoryPropertyFlags preferred;
+} wn_gpu_memory_type_key_t;
+
+typedef struct wn_gpu_memory_type_entry_t
+{
+    wn_gpu_memory_type_key_t key;
+    uint32_t value;
+} wn_gpu_memory_type_entry_t;
+
+struct wn_gpu_allocator_t
+{
+    VkDevice device;
+    VkPhysicalDevice gpu;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkDeviceSize block_sizes[VK_MAX_MEMORY_HEAPS];
+
+    // blocks are shared by the upload thread and the render thread
+    pthread_mutex_t lock;
+    wn_gpu_memory_block_t** blocks[VK_MAX_MEMORY_TYPES][WN_GPU_MEMORY_KIND_COUNT]; // stbds arrays
+    wn_gpu_heap_stats_t heap_stats[VK_MAX_MEMORY_HEAPS];
+    wn_gpu_category_stats_t category_stats[WN_GPU_MEMORY_CATEGORY_COUNT];
+    wn_gpu_memory_type_entry_t* memory_type_cache; // stbds hashmap
+
+    // last driver reported numbers, our own allocations since are added on top
+    bool has_memory_budget;
+    VkDeviceSize budget_usage[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize budget_reserved[VK_MAX_MEMORY_HEAPS]; // heap_stats reserved at the query
+    VkDeviceSize budgets[VK_MAX_MEMORY_HEAPS];
+};
+
+// has_memory_budget if the device was created with VK_EXT_memory_budget
+void wn_gpu_allocator_init(
+    wn_gpu_allocator_t* allocator,
+    VkDevice device,
+    VkPhysicalDevice gpu,
+    bool has_memory_budget);
+
+// every allocation has to be freed by now
+void wn_gpu_allocator_shutdown(wn_gpu_allocator_t* allocator);
+
+/*
+ * Best memory type in type_bits having every required flag, UINT32_MAX if there is none. Types
+ * with more of the preferred flags win, then the ones with fewer flags nobody asked for. Results
+ * are cached per argument triple.
+ */
+uint32_t wn_gpu_find_memory_type(
+    wn_gpu_allocator_t* allocator,
+    uint32_t type_bits,
+    VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred);
+
+/*
+ * Suballocates reqs from a block of the best matching memory type, reserving a new block when none
+ * has room and moving on to the next best type when its heap is full. Allocations above half a
+ * block and lazily allocated ones get a VkDeviceMemory of their own. Host visible blocks stay
+ * mapped for their whole lifetime, so never vkMapMemory allocation->memory yourself.
+ */
+wn_result wn_gpu_alloc(
+    wn_gpu_allocator_t* allocator,
+    const VkMemoryRequirements* reqs,
+    VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred,
+    wn_gpu_memory_kind kind,
+    wn_gpu_memory_category category,
+    wn_gpu_allocation_t* allocation);
+
+// empty blocks go back to the driver except the last one of each memory type and kind
+void wn_gpu_free(wn_gpu_allocation_t* allocation);
+
+// queries VK_EXT_memory_budget, cheap enough for once a frame
+void wn_gpu_allocator_update_budget(wn_gpu_allocator_t* allocator);
+
+// bytes heap can still grow by before going over budget, 0 once it is over
+VkDeviceSize wn_gpu_heap_headroom(wn_gpu_allocator_t* allocator, uint32_t heap);
+
+void wn_gpu_allocator_stats(wn_gpu_allocator_t* allocator, wn_gpu_memory_stats_t* stats);
+
+void wn_gpu_allocator_log_stats(wn_gpu_allocator_t* allocator);
@@ -0,0 +1,260 @@
+/*
+===========================================================================
+
+whynot::render::tlsf.c: two level segregated fit range allocator
+
+===========================================================================
+*/
+
+#include "tlsf.h"
+
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+
+#include <assert.h>
+
+static inline uint64_t wn_tlsf_align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static inline uint32_t wn_tlsf_top_bit(uint64_t value)
+{
+    return 63u - (uint32_t)__builtin_clzll(value);
+}
+
+static void wn_tlsf_bin(uint64_t size, uint32_t* fl, uint32_t* sl)
+{
+    // sizes are multiples of the granularity so the top bit is always at or above SL_BITS
+    *fl = wn_tlsf_top_bit(size);
+    *sl = (uint32_t)(size >> (*fl - WN_TLSF_SL_BITS)) ^ WN_TLSF_SL_COUNT;
+}
+
+// first bin whose every range is at least size
+static void wn_tlsf_bin_round_up(uint64_t size, uint32_t* fl, uint32_t* sl)
+{
+    size += ((uint64_t)1 << (wn_tlsf_top_bit(size) - WN_TLSF_SL_BITS)) - 1;
+    wn_tlsf_bin(size, fl, sl);
+}
+
+static uint32_t wn_tlsf_node_new(wn_tlsf_t* tlsf, uint64_t offset, uint64_t size)
+{
+    wn_tlsf_node_t node = {
+        .offset = offset,
+        .size = size,
+        .prev_phys = WN_TLSF_NO_NODE,
+        .next_phys = WN_TLSF_NO_NODE,
+        .prev_free = WN_TLSF_NO_NODE,
+        .next_free = WN_TLSF_NO_NODE,
+    };
+
+    if (stbds_arrlen(tlsf->unused_nodes) > 0)
+    {
+        uint32_t index = stbds_arrpop(tlsf->unused_nodes);
+        tlsf->nodes[index] = node;
+        return index;
+    }
+    stbds_arrput(tlsf->nodes, node);
+    return (uint32_t)stbds_arrlen(tlsf->nodes) - 1;
+}
+
+static void wn_tlsf_free_list_insert(wn_tlsf_t* tlsf, uint32_t index)
+{
+    wn_tlsf_node_t* node = &tlsf->nodes[index];
+
+    uint32_t fl, sl;
+    wn_tlsf_bin(node->size, &fl, &sl);
+
+    node->free = true;
+    node->prev_free = WN_TLSF_NO_NODE;
+    node->next_free = tlsf->free_heads[fl][sl];
+    if (node->next_free != WN_TLSF_NO_NODE)
+    {
+        tlsf->nodes[node->next_free].prev_free = index;
+    }
+    tlsf->free_heads[fl][sl] = index;
+    tlsf->fl_bitmap |= (uint64_t)1 << fl;
+    tlsf->sl_bitmaps[fl] |= 1u << sl;
+}
+
+static void wn_tlsf_free_list_remove(wn_tlsf_t* tlsf, uint32_t index)
+{
+    wn_tlsf_node_t* node = &tlsf->nodes[index];
+
+    uint32_t fl, sl;
+    wn_tlsf_bin(node->size, &fl, &sl);
+
+    if (node->prev_free != WN_TLSF_NO_NODE)
+    {
+        tlsf->nodes[node->prev_free].next_free = node->next_free;
+    }
+    else
+    {
+        tlsf->free_heads[fl][sl] = node->next_free;
+    }
+    if (node->next_free != WN_TLSF_NO_NODE)
+    {
+        tlsf->nodes[node->next_free].prev_free = node->prev_free;
+    }
+
+    if (tlsf->free_heads[fl][sl] == WN_TLSF_NO_NODE)
+    {
+        tlsf->sl_bitmaps[fl] &= ~(1u << sl);
+        if (tlsf->sl_bitmaps[fl] == 0)
+        {
+            tlsf->fl_bitmap &= ~((uint64_t)1 << fl);
+        }
+    }
+    node->free = false;
+}
+
+static uint32_t wn_tlsf_free_list_find(const wn_tlsf_t* tlsf, uint64_t size)
+{
+    uint32_t fl, sl;
+    wn_tlsf_bin_round_up(size, &fl, &sl);
+    if (fl >= WN_TLSF_FL_COUNT)
+    {
+        return WN_TLSF_NO_NODE;
+    }
+
+    uint32_t sl_map = tlsf->sl_bitmaps[fl] & (~0u << sl);
+    if (sl_map == 0)
+    {
+        uint64_t fl_map = tlsf->fl_bitmap & (~(uint64_t)0 << (fl + 1));
+        if (fl_map == 0)
+        {
+            return WN_TLSF_NO_NODE;
+        }
+        fl = (uint32_t)__builtin_ctzll(fl_map);
+        sl_map = tlsf->sl_bitmaps[fl];
+    }
+    sl = (uint32_t)__builtin_ctz(sl_map);
+
+    return tlsf->free_heads[fl][sl];
+}
+
+// splits [offset, offset + size) of node index off the front, the rest stays in a new node after
+static uint32_t wn_tlsf_node_split(wn_tlsf_t* tlsf, uint32_t index, uint64_t size)
+{
+    wn_tlsf_node_t node = tlsf->nodes[index];
+    uint32_t rest = wn_tlsf_node_new(tlsf, node.offset + size, node.size - size);
+
+    // node_new may have moved the nodes
+    tlsf->nodes[rest].prev_phys = index;
+    tlsf->nodes[rest].next_phys = node.next_phys;
+    if (node.next_phys != WN_TLSF_NO_NODE)
+    {
+        tlsf->nodes[node.next_phys].prev_phys = rest;
+    }
+    tlsf->nodes[index].next_phys = rest;
+    tlsf->nodes[index].size = size;
+
+    return rest;
+}
+
+// absorbs next into index, both already off the free lists
+static void wn_tlsf_node_merge(wn_tlsf_t* tlsf, uint32_t index, uint32_t next)
+{
+    wn_tlsf_node_t* node = &tlsf->nodes[index];
+    const wn_tlsf_node_t* absorbed = &tlsf->nodes[next];
+
+    node->size += absorbed->size;
+    node->next_phys = absorbed->next_phys;
+    if (node->next_phys != WN_TLSF_NO_NODE)
+    {
+        tlsf->nodes[node->next_phys].prev_phys = index;
+    }
+    stbds_arrput(tlsf->unused_nodes, next);
+}
+
+void wn_tlsf_init(wn_tlsf_t* tlsf, uint64_t size, uint64_t granularity)
+{
+    assert(granularity >= WN_TLSF_SL_COUNT && (granularity & (granularity - 1)) == 0);
+    assert(size > 0 && size % granularity == 0);
+
+    *tlsf = (wn_tlsf_t) {
+        .size = size,
+        .granularity = granularity,
+    };
+    for (uint32_t fl = 0; fl < WN_TLSF_FL_COUNT; fl++)
+    {
+        for (uint32_t sl = 0; sl < WN_TLSF_SL_COUNT; sl++)
+        {
+            tlsf->free_heads[fl][sl] = WN_TLSF_NO_NODE;
+        }
+    }
+    wn_tlsf_free_list_insert(tlsf, wn_tlsf_node_new(tlsf, 0, size));
+}
+
+void wn_tlsf_shutdown(wn_tlsf_t* tlsf)
+{
+    stbds_arrfree(tlsf->nodes);
+    stbds_arrfree(tlsf->unused_nodes);
+    *tlsf = (wn_tlsf_t) { 0 };
+}
+
+bool wn_tlsf_alloc(
+    wn_tlsf_t* tlsf,
+    uint64_t size,
+    uint64_t alignment,
+    uint32_t* node_out,
+    uint64_t* offset_out)
+{
+    assert(size > 0 && size % tlsf->granularity == 0);
+    assert(alignment > 0 && alignment % tlsf->granularity == 0);
+
+    // worst case padding to the alignment, every range already starts on the granularity
+    uint64_t search_size = size + alignment - tlsf->granularity;
+    if (search_size > tlsf->size)
+    {
+        return false;
+    }
+
+    uint32_t index = wn_tlsf_free_list_find(tlsf, search_size);
+    if (index == WN_TLSF_NO_NODE)
+    {
+        return false;
+    }
+    wn_tlsf_free_list_remove(tlsf, index);
+
+    uint64_t padding
+        = wn_tlsf_align_up(tlsf->nodes[index].offset, alignment) - tlsf->nodes[index].offset;
+    if (padding > 0)
+    {
+        uint32_t aligned = wn_tlsf_node_split(tlsf, index, padding);
+        wn_tlsf_free_list_insert(tlsf, index);
+        index = aligned;
+    }
+    if (tlsf->nodes[index].size > size)
+    {
+        uint32_t rest = wn_tlsf_node_split(tlsf, index, size);
+        wn_tlsf_free_list_insert(tlsf, rest);
+    }
+
+    tlsf->n_allocations++;
+    *node_out = index;
+    *offset_out = tlsf->nodes[index].offset;
+    return true;
+}
+
+void wn_tlsf_free(wn_tlsf_t* tlsf, uint32_t index)
+{
+    assert(!tlsf->nodes[index].free);
+
+    uint32_t prev = tlsf->nodes[index].prev_phys;
+    if (prev != WN_TLSF_NO_NODE && tlsf->nodes[prev].free)
+    {
+        wn_tlsf_free_list_remove(tlsf, prev);
+        wn_tlsf_node_merge(tlsf, prev, index);
+        index = prev;
+    }
+    uint32_t next = tlsf->nodes[index].next_phys;
+    if (next != WN_TLSF_NO_NODE && tlsf->nodes[next].free)
+    {
+        wn_tlsf_free_list_remove(tlsf, next);
+        wn_tlsf_node_merge(tlsf, index, next);
+    }
+    wn_tlsf_free_list_insert(tlsf, index);
+
+    tlsf->n_allocations--;
+}
@@ -0,0 +1,64 @@
+/*
+===========================================================================
+
+whynot::render::tlsf.h: two level segregated fit range allocator
+
+===========================================================================
+*/
+
+#pragma once
+
+#include "core_types.h"
+
+/*
+ * Hands out ranges of [0, size) without touching the memory behind them, gpu_memory.c runs one per
+ * device memory block. Free ranges are binned by the position of their top bit and the SL_BITS
+ * bits below it, a bitmap per level finds the smallest non empty bin that fits in constant time.
+ * Ranges keep links to their physical neighbours so freeing merges with free neighbours right
+ * away.
+ */
+#define WN_TLSF_SL_BITS 4u
+#define WN_TLSF_SL_COUNT (1u << WN_TLSF_SL_BITS)
+#define WN_TLSF_FL_COUNT 48u
+#define WN_TLSF_NO_NODE UINT32_MAX
+
+typedef struct wn_tlsf_node_t
+{
+    uint64_t offset;
+    uint64_t size;
+    uint32_t prev_phys;
+    uint32_t next_phys;
+    uint32_t prev_free;
+    uint32_t next_free;
+    bool free;
+} wn_tlsf_node_t;
+
+typedef struct wn_tlsf_t
+{
+    uint64_t size;
+    uint64_t granularity;
+    uint32_t n_allocations;
+
+    // merging always keeps the lower node, so node 0 is the range at offset 0 for good
+    wn_tlsf_node_t* nodes; // stbds array
+    uint32_t* unused_nodes; // stbds array, holes in nodes
+
+    uint64_t fl_bitmap;
+    uint32_t sl_bitmaps[WN_TLSF_FL_COUNT];
+    uint32_t free_heads[WN_TLSF_FL_COUNT][WN_TLSF_SL_COUNT];
+} wn_tlsf_t;
+
+// granularity is a power of two of at least WN_TLSF_SL_COUNT and size a multiple of it
+void wn_tlsf_init(wn_tlsf_t* tlsf, uint64_t size, uint64_t granularity);
+
+void wn_tlsf_shutdown(wn_tlsf_t* tlsf);
+
+// size and alignment are multiples of the granularity, false if no free range fits
+bool wn_tlsf_alloc(
+    wn_tlsf_t* tlsf,
+    uint64_t size,
+    uint64_t alignment,
+    uint32_t* node_out,
+    uint64_t* offset_out);
+
+void wn_tlsf_free(wn_tlsf_t* tlsf, uint32_t node);
@@ -0,0 +1,187 @@
+/*
+===========================================================================
+
+whynot::tools::bake.c: offline asset baker (wn_bake)
+
+===========================================================================
+*/
+
+#include "bc_encode.h"
+#include "image.h"
+#include "mesh.h"
+#include "mesh_file.h"
+#include "mesh_lod.h"
+#include "mesh_opt.h"
+#include "meshlet.h"
+#include "obj.h"
+#include "texture_file.h"
+
+#include "log.h"
+#define STB_DS_IMPLEMENTATION
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static void wn_bake_usage(void)
+{
+    fprintf(stderr, "usage: wn_bake <model.obj | image.png/.jpg/.tga> [out.wnmesh | out.ktx2]\n");
+}
+
+static bool wn_bake_is_image(const char* path)
+{
+    static const char* image_exts[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+
+    const char* ext = strrchr(path, '.');
+    for (size_t i = 0; ext && i < sizeof(image_exts) / sizeof(image_exts[0]); i++)
+    {
+        if (strcasecmp(ext, image_exts[i]) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int wn_bake_mesh(const char* src_path, const char* dst_path)
+{
+    wn_mesh_t mesh = { 0 };
+    if (wn_obj_load(src_path, &mesh) != WN_OK)
+    {
+        log_fatal("Could not load %s", src_path);
+        return EXIT_FAILURE;
+    }
+
+    wn_mesh_optimize(&mesh);
+    wn_mesh_build_lods(&mesh);
+    wn_mesh_build_meshlets(&mesh);
+
+    if (wn_mesh_file_write(dst_path, src_path, &mesh) != WN_OK)
+    {
+        wn_mesh_destroy(&mesh);
+        return EXIT_FAILURE;
+    }
+
+    log_info(
+        "Baked %s -> %s (%zu vertices, %zu indices, %u LODs)",
+        src_path,
+        dst_path,
+        mesh.n_vertices,
+        mesh.n_indices,
+        mesh.n_lods);
+
+    wn_mesh_destroy(&mesh);
+
+    return EXIT_SUCCESS;
+}
+
+// srgb color, BC1 if the image is opaque and BC3 otherwise, full mip chain
+static int wn_bake_texture(const char* src_path, const char* dst_path)
+{
+    int w, h, channels;
+    uint8_t* pixels = stbi_load(src_path, &w, &h, &channels, STBI_rgb_alpha);
+    if (!pixels)
+    {
+        log_fatal("Could not load %s: %s", src_path, stbi_failure_reason());
+        return EXIT_FAILURE;
+    }
+
+    uint32_t width = (uint32_t)w;
+    uint32_t height = (uint32_t)h;
+    uint32_t n_mips = wn_image_mip_count(width, height);
+    n_mips = n_mips < WN_TEXTURE_MAX_MIPS ? n_mips : WN_TEXTURE_MAX_MIPS;
+
+    bool alpha = false;
+    for (size_t i = 0; i < (size_t)width * height && !alpha; i++)
+    {
+        alpha = pixels[i * 4 + 3] < 255;
+    }
+    uint32_t vk_format = alpha ? WN_VK_FORMAT_BC3_SRGB : WN_VK_FORMAT_BC1_RGBA_SRGB;
+    uint32_t block_size = wn_texture_format_block_size(vk_format);
+
+    uint8_t* chain = malloc(wn_image_mip_chain_size(width, height, n_mips));
+    assert(chain);
+    memcpy(chain, pixels, (size_t)width * height * 4);
+    stbi_image_free(pixels);
+    wn_image_build_mips_srgb(chain, width, height, n_mips);
+
+    size_t blocks_size = 0;
+    for (uint32_t mip = 0; mip < n_mips; mip++)
+    {
+        blocks_size += wn_texture_level_size(
+            wn_image_mip_extent(width, mip),
+            wn_image_mip_extent(height, mip),
+            block_size);
+    }
+    uint8_t* blocks = malloc(blocks_size);
+    assert(blocks);
+
+    const uint8_t* levels[WN_TEXTURE_MAX_MIPS];
+    const uint8_t* src = chain;
+    uint8_t* dst = blocks;
+    for (uint32_t mip = 0; mip < n_mips; mip++)
+    {
+        uint32_t mip_width = wn_image_mip_extent(width, mip);
+        uint32_t mip_height = wn_image_mip_extent(height, mip);
+
+        wn_bc_encode_image(src, mip_width, mip_height, alpha, dst);
+        levels[mip] = dst;
+
+        src += (size_t)mip_width * mip_height * 4;
+        dst += wn_texture_level_size(mip_width, mip_height, block_size);
+    }
+
+    wn_result result = wn_texture_file_write(dst_path, vk_format, width, height, n_mips, levels);
+    free(blocks);
+    free(chain);
+    if (result != WN_OK)
+    {
+        return EXIT_FAILURE;
+    }
+
+    log_info(
+        "Baked %s -> %s (%ux%u %s, %u mips, %zu KiB, rgba8 %zu KiB)",
+        src_path,
+        dst_path,
+        width,
+        height,
+        wn_texture_format_name(vk_format),
+        n_mips,
+        blocks_size / 1024,
+        wn_image_mip_chain_size(width, height, n_mips) / 1024);
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        wn_bake_usage();
+        return EXIT_FAILURE;
+    }
+
+    const char* src_path = argv[1];
+    bool image = wn_bake_is_image(src_path);
+
+    char dst_path[512];
+    if (argc == 3)
+    {
+        snprintf(dst_path, sizeof(dst_path), "%s", argv[2]);
+    }
+    else if (
+        image ? !wn_texture_file_baked_path(src_path, dst_path, sizeof(dst_path))
+              : !wn_mesh_file_baked_path(src_path, dst_path, sizeof(dst_path)))
+    {
+        log_fatal("Output path for %s is too long", src_path);
+        return EXIT_FAILURE;
+    }
+
+    return image ? wn_bake_texture(src_path, dst_path) : wn_bake_mesh(src_path, dst_path);
+}
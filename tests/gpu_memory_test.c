@@ -0,0 +1,534 @@
+/*
+===========================================================================
+
+whynot::tests::gpu_memory_test.c: device memory suballocation against stubbed Vulkan
+
+===========================================================================
+*/
+
+#include "test.h"
+
+#include "gpu_memory.h"
+
+#include "log.h"
+#define STB_DS_IMPLEMENTATION
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+
+#include <string.h>
+
+#define TEST_MiB ((VkDeviceSize)1u << 20)
+#define TEST_BUFFERS 100000u
+#define TEST_MAX_LIVE 8192u
+// the overlap check sorts every live allocation, not every op needs one
+#define TEST_CHECK_EVERY 10007u
+
+/*
+ * A discrete card: plenty of vram, a 256 MiB BAR window into it, system memory and a lazily
+ * allocated type sharing the vram heap.
+ */
+enum
+{
+    TEST_TYPE_DEVICE,
+    TEST_TYPE_BAR,
+    TEST_TYPE_HOST,
+    TEST_TYPE_LAZY,
+    TEST_TYPE_COUNT,
+};
+
+#define TEST_HOST (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+
+static const VkMemoryType wn_test_memory_types[TEST_TYPE_COUNT] = {
+    [TEST_TYPE_DEVICE] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 },
+    [TEST_TYPE_BAR] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | TEST_HOST, 1 },
+    [TEST_TYPE_HOST] = { TEST_HOST, 2 },
+    [TEST_TYPE_LAZY]
+    = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, 0 },
+};
+
+static const VkDeviceSize wn_test_heap_sizes[] = {
+    8192 * TEST_MiB,
+    256 * TEST_MiB,
+    2048 * TEST_MiB,
+};
+#define TEST_HEAP_COUNT (sizeof(wn_test_heap_sizes) / sizeof(wn_test_heap_sizes[0]))
+
+// what the stubbed driver knows about a VkDeviceMemory
+struct VkDeviceMemory_T
+{
+    uint32_t memory_type;
+    VkDeviceSize size;
+    uintptr_t address; // made up, never dereferenced
+    bool mapped;
+};
+
+static struct
+{
+    uint32_t n_memories[TEST_HEAP_COUNT];
+    VkDeviceSize reserved[TEST_HEAP_COUNT];
+    uint32_t n_allocate_calls;
+    uintptr_t next_address;
+} wn_test_driver;
+
+void vkGetPhysicalDeviceMemoryProperties(
+    VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceMemoryProperties* pMemoryProperties)
+{
+    (void)physicalDevice;
+
+    *pMemoryProperties = (VkPhysicalDeviceMemoryProperties) {
+        .memoryTypeCount = TEST_TYPE_COUNT,
+        .memoryHeapCount = TEST_HEAP_COUNT,
+    };
+    memcpy(pMemoryProperties->memoryTypes, wn_test_memory_types, sizeof(wn_test_memory_types));
+    for (uint32_t i = 0; i < TEST_HEAP_COUNT; i++)
+    {
+        pMemoryProperties->memoryHeaps[i].size = wn_test_heap_sizes[i];
+    }
+}
+
+// the process is alone on the gpu, so usage is exactly what it reserved
+void vkGetPhysicalDeviceMemoryProperties2(
+    VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceMemoryProperties2* pMemoryProperties)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &pMemoryProperties->memoryProperties);
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT* budget = pMemoryProperties->pNext;
+    WN_TEST_CHECK(
+        budget && budget->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT);
+    for (uint32_t i = 0; i < TEST_HEAP_COUNT; i++)
+    {
+        budget->heapBudget[i] = wn_test_heap_sizes[i] / 10 * 9;
+        budget->heapUsage[i] = wn_test_driver.reserved[i];
+    }
+}
+
+// fails like a driver would once the heap is full
+VkResult vkAllocateMemory(
+    VkDevice device,
+    const VkMemoryAllocateInfo* pAllocateInfo,
+    const VkAllocationCallbacks* pAllocator,
+    VkDeviceMemory* pMemory)
+{
+    (void)device;
+    (void)pAllocator;
+
+    WN_TEST_CHECK(pAllocateInfo->sType == VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
+    WN_TEST_CHECK(pAllocateInfo->memoryTypeIndex < TEST_TYPE_COUNT);
+    WN_TEST_CHECK(pAllocateInfo->allocationSize > 0);
+
+    uint32_t heap = wn_test_memory_types[pAllocateInfo->memoryTypeIndex].heapIndex;
+    wn_test_driver.n_allocate_calls++;
+    if (wn_test_driver.reserved[heap] + pAllocateInfo->allocationSize > wn_test_heap_sizes[heap])
+    {
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    struct VkDeviceMemory_T* memory = calloc(1, sizeof(struct VkDeviceMemory_T));
+    WN_TEST_CHECK(memory);
+    memory->memory_type = pAllocateInfo->memoryTypeIndex;
+    memory->size = pAllocateInfo->allocationSize;
+    // 1 TiB apart, a stray offset can't land in a neighbour
+    wn_test_driver.next_address += (uintptr_t)1 << 40;
+    memory->address = wn_test_driver.next_address;
+
+    wn_test_driver.n_memories[heap]++;
+    wn_test_driver.reserved[heap] += memory->size;
+
+    *pMemory = memory;
+    return VK_SUCCESS;
+}
+
+void vkFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator)
+{
+    (void)device;
+    (void)pAllocator;
+
+    uint32_t heap = wn_test_memory_types[memory->memory_type].heapIndex;
+    WN_TEST_CHECK(wn_test_driver.n_memories[heap] > 0);
+    WN_TEST_CHECK(wn_test_driver.reserved[heap] >= memory->size);
+    wn_test_driver.n_memories[heap]--;
+    wn_test_driver.reserved[heap] -= memory->size;
+
+    free(memory);
+}
+
+VkResult vkMapMemory(
+    VkDevice device,
+    VkDeviceMemory memory,
+    VkDeviceSize offset,
+    VkDeviceSize size,
+    VkMemoryMapFlags flags,
+    void** ppData)
+{
+    (void)device;
+    (void)flags;
+
+    WN_TEST_CHECK(
+        wn_test_memory_types[memory->memory_type].propertyFlags
+        & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    WN_TEST_CHECK(!memory->mapped && offset == 0 && size == VK_WHOLE_SIZE);
+    memory->mapped = true;
+
+    *ppData = (void*)memory->address;
+    return VK_SUCCESS;
+}
+
+// xorshift64, fixed seed so failures reproduce
+static uint64_t wn_test_random(void)
+{
+    static uint64_t state = 0x9e3779b97f4a7c15ull;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static VkDeviceSize wn_test_align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// what has to hold for any allocation, wherever it came from
+static void wn_test_check_allocation(
+    const wn_gpu_allocator_t* allocator,
+    const VkMemoryRequirements* reqs,
+    const wn_gpu_allocation_t* allocation)
+{
+    const struct VkDeviceMemory_T* memory = allocation->memory;
+    WN_TEST_CHECK(memory && memory->memory_type == allocation->memory_type);
+    WN_TEST_CHECK(reqs->memoryTypeBits & (1u << allocation->memory_type));
+    WN_TEST_CHECK(allocation->size == reqs->size);
+    WN_TEST_CHECK(allocation->offset % reqs->alignment == 0);
+    WN_TEST_CHECK(allocation->offset % WN_GPU_MEMORY_GRANULARITY == 0);
+    WN_TEST_CHECK(allocation->offset + allocation->size <= memory->size);
+
+    if (!allocation->block)
+    {
+        WN_TEST_CHECK(allocation->offset == 0 && memory->size == reqs->size);
+    }
+
+    bool host_visible = allocator->memory_properties.memoryTypes[allocation->memory_type]
+                            .propertyFlags
+                        & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    if (host_visible)
+    {
+        WN_TEST_CHECK(memory->mapped);
+        WN_TEST_CHECK((uintptr_t)allocation->mapped == memory->address + allocation->offset);
+    }
+    else
+    {
+        WN_TEST_CHECK(!memory->mapped && !allocation->mapped);
+    }
+}
+
+static int wn_test_allocation_cmp(const void* a, const void* b)
+{
+    const wn_gpu_allocation_t* x = a;
+    const wn_gpu_allocation_t* y = b;
+    if (x->memory != y->memory)
+    {
+        return (uintptr_t)x->memory < (uintptr_t)y->memory ? -1 : 1;
+    }
+    return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+// no two live allocations may share a byte, and our numbers have to match the driver's
+static void wn_test_check_live(wn_gpu_allocator_t* allocator, const wn_gpu_allocation_t* live)
+{
+    wn_gpu_allocation_t* sorted = malloc(TEST_MAX_LIVE * sizeof(wn_gpu_allocation_t));
+    WN_TEST_CHECK(sorted);
+    uint32_t n_sorted = 0;
+    for (uint32_t i = 0; i < TEST_MAX_LIVE; i++)
+    {
+        if (live[i].allocator)
+        {
+            sorted[n_sorted++] = live[i];
+        }
+    }
+    qsort(sorted, n_sorted, sizeof(wn_gpu_allocation_t), wn_test_allocation_cmp);
+    for (uint32_t i = 1; i < n_sorted; i++)
+    {
+        if (sorted[i].memory == sorted[i - 1].memory)
+        {
+            WN_TEST_CHECK(sorted[i - 1].offset + sorted[i - 1].size <= sorted[i].offset);
+        }
+    }
+    free(sorted);
+
+    wn_gpu_allocator_update_budget(allocator);
+    wn_gpu_memory_stats_t stats;
+    wn_gpu_allocator_stats(allocator, &stats);
+    WN_TEST_CHECK(stats.n_heaps == TEST_HEAP_COUNT);
+    uint32_t n_allocations = 0;
+    for (uint32_t i = 0; i < TEST_HEAP_COUNT; i++)
+    {
+        WN_TEST_CHECK(stats.heaps[i].n_blocks == wn_test_driver.n_memories[i]);
+        WN_TEST_CHECK(stats.heaps[i].reserved == wn_test_driver.reserved[i]);
+        WN_TEST_CHECK(stats.heaps[i].usage == wn_test_driver.reserved[i]);
+        WN_TEST_CHECK(stats.heaps[i].used <= stats.heaps[i].reserved);
+        n_allocations += stats.heaps[i].n_allocations;
+    }
+    WN_TEST_CHECK(n_allocations == n_sorted);
+}
+
+static void wn_test_memory_types_picked(void)
+{
+    wn_gpu_allocator_t allocator;
+    wn_gpu_allocator_init(&allocator, NULL, NULL, false);
+
+    const uint32_t all = (1u << TEST_TYPE_COUNT) - 1;
+
+    // the lazy type has a flag nobody asked for
+    WN_TEST_CHECK(
+        wn_gpu_find_memory_type(&allocator, all, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0)
+        == TEST_TYPE_DEVICE);
+    WN_TEST_CHECK(
+        wn_gpu_find_memory_type(&allocator, all, TEST_HOST, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+        == TEST_TYPE_BAR);
+    // staging stays out of the BAR
+    WN_TEST_CHECK(wn_gpu_find_memory_type(&allocator, all, TEST_HOST, 0) == TEST_TYPE_HOST);
+    WN_TEST_CHECK(
+        wn_gpu_find_memory_type(&allocator, all, 0, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+        == TEST_TYPE_LAZY);
+    WN_TEST_CHECK(
+        wn_gpu_find_memory_type(&allocator, 1u << TEST_TYPE_DEVICE, TEST_HOST, 0) == UINT32_MAX);
+    // cached answers agree
+    WN_TEST_CHECK(wn_gpu_find_memory_type(&allocator, all, TEST_HOST, 0) == TEST_TYPE_HOST);
+
+    wn_gpu_allocator_shutdown(&allocator);
+}
+
+/*
+ * Fills the BAR with uploads: a dedicated one for being over half a block, then as many blocks as
+ * fit, dedicated ones in what's left, then system memory. Freeing it all hands back every block
+ * but one.
+ */
+static void wn_test_heap_fallback(void)
+{
+    wn_gpu_allocator_t allocator;
+    wn_gpu_allocator_init(&allocator, NULL, NULL, false);
+
+    VkDeviceSize block_size = allocator.block_sizes[1];
+    WN_TEST_CHECK(block_size == 32 * TEST_MiB);
+
+    wn_gpu_allocation_t* uploads = NULL; // stbds array
+
+    VkMemoryRequirements big = {
+        .size = block_size / 2 + TEST_MiB,
+        .alignment = 256,
+        .memoryTypeBits = (1u << TEST_TYPE_COUNT) - 1,
+    };
+    wn_gpu_allocation_t allocation;
+    WN_TEST_CHECK(
+        wn_gpu_alloc(
+            &allocator,
+            &big,
+            TEST_HOST,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            WN_GPU_MEMORY_LINEAR,
+            WN_GPU_MEMORY_CATEGORY_MESH,
+            &allocation)
+        == WN_OK);
+    wn_test_check_allocation(&allocator, &big, &allocation);
+    WN_TEST_CHECK(allocation.memory_type == TEST_TYPE_BAR && !allocation.block);
+    stbds_arrput(uploads, allocation);
+
+    VkMemoryRequirements small = big;
+    small.size = TEST_MiB;
+    uint32_t n_shared = 0;
+    uint32_t n_dedicated = 0;
+    for (;;)
+    {
+        WN_TEST_CHECK(
+            wn_gpu_alloc(
+                &allocator,
+                &small,
+                TEST_HOST,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                WN_GPU_MEMORY_LINEAR,
+                WN_GPU_MEMORY_CATEGORY_MESH,
+                &allocation)
+            == WN_OK);
+        wn_test_check_allocation(&allocator, &small, &allocation);
+        stbds_arrput(uploads, allocation);
+        if (allocation.memory_type != TEST_TYPE_BAR)
+        {
+            break;
+        }
+        n_shared += allocation.block != NULL;
+        n_dedicated += allocation.block == NULL;
+    }
+    WN_TEST_CHECK(allocation.memory_type == TEST_TYPE_HOST && allocation.block);
+
+    // 17 MiB leaves room for 7 blocks and 15 MiB of dedicated ones
+    VkDeviceSize left = wn_test_heap_sizes[1] - big.size;
+    uint32_t n_blocks = (uint32_t)(left / block_size);
+    WN_TEST_CHECK(n_shared == n_blocks * (block_size / TEST_MiB));
+    WN_TEST_CHECK(n_dedicated == (left - n_blocks * block_size) / TEST_MiB);
+    WN_TEST_CHECK(wn_test_driver.reserved[1] == wn_test_heap_sizes[1]);
+    WN_TEST_CHECK(wn_test_driver.n_memories[1] == 1 + n_blocks + n_dedicated);
+
+    // lazily allocated memory never shares a block, however small
+    VkMemoryRequirements transient = {
+        .size = 4096,
+        .alignment = 4096,
+        .memoryTypeBits = 1u << TEST_TYPE_LAZY,
+    };
+    WN_TEST_CHECK(
+        wn_gpu_alloc(
+            &allocator,
+            &transient,
+            VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+            0,
+            WN_GPU_MEMORY_OPTIMAL,
+            WN_GPU_MEMORY_CATEGORY_ATTACHMENT,
+            &allocation)
+        == WN_OK);
+    wn_test_check_allocation(&allocator, &transient, &allocation);
+    WN_TEST_CHECK(allocation.memory_type == TEST_TYPE_LAZY && !allocation.block);
+    wn_gpu_free(&allocation);
+    WN_TEST_CHECK(!allocation.allocator);
+
+    for (ptrdiff_t i = 0; i < stbds_arrlen(uploads); i++)
+    {
+        wn_gpu_free(&uploads[i]);
+    }
+    stbds_arrfree(uploads);
+
+    WN_TEST_CHECK(stbds_arrlen(allocator.blocks[TEST_TYPE_BAR][WN_GPU_MEMORY_LINEAR]) == 1);
+    WN_TEST_CHECK(wn_test_driver.n_memories[1] == 1);
+    WN_TEST_CHECK(wn_test_driver.reserved[1] == block_size);
+    WN_TEST_CHECK(wn_test_driver.n_memories[0] == 0);
+
+    wn_gpu_allocator_shutdown(&allocator);
+}
+
+// creates and frees TEST_BUFFERS allocations of every sort, at most TEST_MAX_LIVE at a time
+static void wn_test_stress(void)
+{
+    wn_gpu_allocator_t allocator;
+    wn_gpu_allocator_init(&allocator, NULL, NULL, true);
+
+    wn_gpu_allocation_t* live = calloc(TEST_MAX_LIVE, sizeof(wn_gpu_allocation_t));
+    WN_TEST_CHECK(live);
+
+    uint32_t n_calls_before = wn_test_driver.n_allocate_calls;
+    uint32_t n_dedicated = 0;
+    for (uint32_t i = 0; i < TEST_BUFFERS; i++)
+    {
+        wn_gpu_allocation_t* allocation = &live[wn_test_random() % TEST_MAX_LIVE];
+        wn_gpu_free(allocation);
+
+        VkMemoryPropertyFlags required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        VkMemoryPropertyFlags preferred = 0;
+        uint32_t expected_type = TEST_TYPE_DEVICE;
+        switch (wn_test_random() % 16)
+        {
+        case 0:
+            required = TEST_HOST;
+            preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            expected_type = TEST_TYPE_BAR;
+            break;
+        case 1:
+            required = TEST_HOST;
+            expected_type = TEST_TYPE_HOST;
+            break;
+        }
+
+        // mostly small, the odd big one lands on either side of half a block
+        VkMemoryRequirements reqs = {
+            .size = 1 + wn_test_random() % (256u << 10),
+            .alignment = (VkDeviceSize)1 << (wn_test_random() % 17),
+            .memoryTypeBits = (1u << TEST_TYPE_COUNT) - 1,
+        };
+        if (expected_type == TEST_TYPE_DEVICE && wn_test_random() % 512 == 0)
+        {
+            reqs.size = 64 * TEST_MiB + wn_test_random() % (128 * TEST_MiB);
+        }
+
+        wn_gpu_memory_kind kind = wn_test_random() % WN_GPU_MEMORY_KIND_COUNT;
+        wn_gpu_memory_category category = wn_test_random() % WN_GPU_MEMORY_CATEGORY_COUNT;
+        WN_TEST_CHECK(
+            wn_gpu_alloc(&allocator, &reqs, required, preferred, kind, category, allocation)
+            == WN_OK);
+        wn_test_check_allocation(&allocator, &reqs, allocation);
+        WN_TEST_CHECK(allocation->memory_type == expected_type);
+
+        // nothing here comes close to filling a heap, only size decides
+        uint32_t heap = wn_test_memory_types[expected_type].heapIndex;
+        bool shared = wn_test_align_up(reqs.size, WN_GPU_MEMORY_GRANULARITY)
+                          + wn_test_align_up(reqs.alignment, WN_GPU_MEMORY_GRANULARITY)
+                      <= allocator.block_sizes[heap] / 2;
+        WN_TEST_CHECK(shared == (allocation->block != NULL));
+        n_dedicated += !shared;
+
+        if (i % TEST_CHECK_EVERY == 0)
+        {
+            wn_test_check_live(&allocator, live);
+        }
+    }
+    wn_test_check_live(&allocator, live);
+
+    // blocks get reused rather than reserved per allocation
+    uint32_t n_blocks_created = wn_test_driver.n_allocate_calls - n_calls_before - n_dedicated;
+    printf(
+        "%u allocations, %u dedicated, %u blocks created\n",
+        TEST_BUFFERS,
+        n_dedicated,
+        n_blocks_created);
+    WN_TEST_CHECK(n_dedicated > 0);
+    WN_TEST_CHECK(n_blocks_created < 64);
+
+    for (uint32_t i = 0; i < TEST_MAX_LIVE; i++)
+    {
+        wn_gpu_free(&live[i]);
+    }
+    free(live);
+
+    // every empty block but the last of each memory type and kind went back to the driver
+    uint32_t n_blocks[TEST_HEAP_COUNT] = { 0 };
+    for (uint32_t type = 0; type < TEST_TYPE_COUNT; type++)
+    {
+        for (uint32_t kind = 0; kind < WN_GPU_MEMORY_KIND_COUNT; kind++)
+        {
+            ptrdiff_t n = stbds_arrlen(allocator.blocks[type][kind]);
+            WN_TEST_CHECK(n == (type == TEST_TYPE_LAZY ? 0 : 1));
+            n_blocks[wn_test_memory_types[type].heapIndex] += (uint32_t)n;
+        }
+    }
+
+    wn_gpu_memory_stats_t stats;
+    wn_gpu_allocator_stats(&allocator, &stats);
+    for (uint32_t i = 0; i < TEST_HEAP_COUNT; i++)
+    {
+        WN_TEST_CHECK(stats.heaps[i].n_allocations == 0 && stats.heaps[i].used == 0);
+        WN_TEST_CHECK(stats.heaps[i].n_blocks == n_blocks[i]);
+        WN_TEST_CHECK(wn_test_driver.n_memories[i] == n_blocks[i]);
+        WN_TEST_CHECK(stats.heaps[i].reserved == n_blocks[i] * allocator.block_sizes[i]);
+    }
+    for (uint32_t i = 0; i < WN_GPU_MEMORY_CATEGORY_COUNT; i++)
+    {
+        WN_TEST_CHECK(stats.categories[i].n_allocations == 0 && stats.categories[i].used == 0);
+    }
+
+    wn_gpu_allocator_shutdown(&allocator);
+}
+
+int main(void)
+{
+    log_set_level(LOG_ERROR);
+
+    wn_test_memory_types_picked();
+    wn_test_heap_fallback();
+    wn_test_stress();
+
+    // shutdown hands back what was kept around
+    for (uint32_t i = 0; i < TEST_HEAP_COUNT; i++)
+    {
+        WN_TEST_CHECK(wn_test_driver.n_memories[i] == 0 && wn_test_driver.reserved[i] == 0);
+    }
+
+    return EXIT_SUCCESS;
+}
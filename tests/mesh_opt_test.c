@@ -0,0 +1,209 @@
+/*
+===========================================================================
+
+whynot::tests::mesh_opt_test.c: vertex cache, overdraw and vertex fetch passes
+
+===========================================================================
+*/
+
+#include "test.h"
+
+#include "mesh.h"
+#include "mesh_opt.h"
+#include "obj.h"
+
+#include "log.h"
+#define STB_DS_IMPLEMENTATION
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <string.h>
+
+// a triangle by value, vertex fetch renumbers vertices so indices can't be compared
+typedef struct wn_test_triangle_t
+{
+    wn_vertex_t corners[3];
+} wn_test_triangle_t;
+
+static int wn_test_vertex_cmp(const wn_vertex_t* a, const wn_vertex_t* b)
+{
+    return memcmp(a, b, sizeof(wn_vertex_t));
+}
+
+static int wn_test_triangle_cmp(const void* a, const void* b)
+{
+    return memcmp(a, b, sizeof(wn_test_triangle_t));
+}
+
+// rotated to start at the smallest corner, which keeps the winding
+static wn_test_triangle_t* wn_test_triangles(const wn_mesh_t* mesh)
+{
+    size_t n_triangles = mesh->n_indices / 3;
+    wn_test_triangle_t* triangles = malloc(sizeof(wn_test_triangle_t) * n_triangles);
+    WN_TEST_CHECK(triangles);
+
+    for (size_t t = 0; t < n_triangles; t++)
+    {
+        const uint32_t* idx = &mesh->indices[t * 3];
+        size_t first = 0;
+        for (size_t c = 1; c < 3; c++)
+        {
+            if (wn_test_vertex_cmp(&mesh->vertices[idx[c]], &mesh->vertices[idx[first]]) < 0)
+            {
+                first = c;
+            }
+        }
+        for (size_t c = 0; c < 3; c++)
+        {
+            triangles[t].corners[c] = mesh->vertices[idx[(first + c) % 3]];
+        }
+    }
+
+    qsort(triangles, n_triangles, sizeof(wn_test_triangle_t), wn_test_triangle_cmp);
+    return triangles;
+}
+
+// row by row quad grid, the order the cache passes have the most to gain on
+#define TEST_GRID_SIZE 256u
+
+static wn_mesh_t wn_test_grid(void)
+{
+    const uint32_t n = TEST_GRID_SIZE;
+    wn_mesh_t mesh = wn_mesh_new((size_t)(n + 1) * (n + 1), (size_t)n * n * 6);
+
+    for (uint32_t y = 0; y <= n; y++)
+    {
+        for (uint32_t x = 0; x <= n; x++)
+        {
+            mesh.vertices[y * (n + 1) + x] = (wn_vertex_t) {
+                .pos = { .x = (float)x, .y = 0.0f, .z = (float)y },
+                .tex_coord0 = { .u = (float)x / (float)n, .v = (float)y / (float)n },
+            };
+        }
+    }
+
+    uint32_t* idx = mesh.indices;
+    for (uint32_t y = 0; y < n; y++)
+    {
+        for (uint32_t x = 0; x < n; x++)
+        {
+            uint32_t v0 = y * (n + 1) + x;
+            uint32_t v1 = v0 + 1;
+            uint32_t v2 = v0 + n + 1;
+            uint32_t v3 = v2 + 1;
+            const uint32_t quad[6] = { v0, v2, v1, v1, v2, v3 };
+            memcpy(idx, quad, sizeof(quad));
+            idx += 6;
+        }
+    }
+
+    wn_mesh_compute_bounds(&mesh);
+    return mesh;
+}
+
+static wn_mesh_cache_stats_t wn_test_stats(const wn_mesh_t* mesh)
+{
+    return wn_mesh_analyze_vertex_cache(
+        mesh->indices,
+        mesh->n_indices,
+        mesh->n_vertices,
+        WN_MESH_VERTEX_CACHE_SIZE);
+}
+
+/*
+ * Runs the three passes one at a time on mesh: none may make ACMR or ATVR worse than the source
+ * order, vertex fetch only renumbers and every triangle survives with its winding. Returns the
+ * stats before and after all of them.
+ */
+static void wn_test_passes(
+    wn_mesh_t* mesh,
+    const char* name,
+    wn_mesh_cache_stats_t* before,
+    wn_mesh_cache_stats_t* after)
+{
+    WN_TEST_CHECK(mesh->n_submeshes == 1 && mesh->n_indices > 0 && mesh->n_indices % 3 == 0);
+
+    size_t n_indices = mesh->n_indices;
+    wn_test_triangle_t* triangles_before = wn_test_triangles(mesh);
+    *before = wn_test_stats(mesh);
+    // every vertex is referenced, so it is transformed at least once
+    WN_TEST_CHECK(before->atvr >= 1.0f);
+
+    size_t* clusters = NULL;
+    wn_mesh_optimize_vertex_cache(
+        mesh->indices,
+        mesh->n_indices,
+        mesh->n_vertices,
+        WN_MESH_VERTEX_CACHE_SIZE,
+        &clusters);
+    WN_TEST_CHECK(stbds_arrlen(clusters) > 0 && clusters[0] == 0);
+    wn_mesh_cache_stats_t cache = wn_test_stats(mesh);
+    WN_TEST_CHECK(cache.acmr <= before->acmr && cache.atvr <= before->atvr);
+
+    wn_mesh_optimize_overdraw(
+        mesh->indices,
+        mesh->n_indices,
+        mesh->vertices,
+        mesh->n_vertices,
+        clusters,
+        stbds_arrlen(clusters),
+        WN_MESH_VERTEX_CACHE_SIZE,
+        WN_MESH_OVERDRAW_THRESHOLD);
+    stbds_arrfree(clusters);
+    // overdraw trades some reuse for ordering but must not end up worse than the source order
+    wn_mesh_cache_stats_t overdraw = wn_test_stats(mesh);
+    WN_TEST_CHECK(overdraw.acmr <= before->acmr && overdraw.atvr <= before->atvr);
+
+    wn_mesh_optimize_vertex_fetch(mesh);
+    for (size_t i = 0; i < mesh->n_indices; i++)
+    {
+        WN_TEST_CHECK(mesh->indices[i] < mesh->n_vertices);
+    }
+    // only renumbers vertices, which a FIFO cache doesn't care about
+    *after = wn_test_stats(mesh);
+    WN_TEST_CHECK(after->acmr == overdraw.acmr && after->atvr == overdraw.atvr);
+
+    WN_TEST_CHECK(mesh->n_indices == n_indices);
+    wn_test_triangle_t* triangles_after = wn_test_triangles(mesh);
+    WN_TEST_CHECK(
+        memcmp(triangles_before, triangles_after, sizeof(wn_test_triangle_t) * (n_indices / 3))
+        == 0);
+
+    printf(
+        "%s: ACMR %.3f -> %.3f (vertex cache) -> %.3f (overdraw), ATVR %.3f -> %.3f\n",
+        name,
+        before->acmr,
+        cache.acmr,
+        overdraw.acmr,
+        before->atvr,
+        after->atvr);
+
+    free(triangles_before);
+    free(triangles_after);
+}
+
+int main(int argc, char** argv)
+{
+    WN_TEST_CHECK(argc == 2);
+    log_set_level(LOG_ERROR);
+
+    wn_mesh_cache_stats_t before, after;
+
+    // per face uvs leave the teapot almost no reuse to find, it mostly checks the passes are safe
+    wn_mesh_t teapot = { 0 };
+    WN_TEST_CHECK(wn_obj_load(argv[1], &teapot) == WN_OK);
+    wn_test_passes(&teapot, "teapot", &before, &after);
+    wn_mesh_destroy(&teapot);
+
+    // a row by row grid only reuses the previous row's vertices while they're still in the cache,
+    // the passes have to find the strip order that keeps them there
+    wn_mesh_t grid = wn_test_grid();
+    wn_test_passes(&grid, "grid", &before, &after);
+    WN_TEST_CHECK(after.acmr < before.acmr * 0.8f);
+    WN_TEST_CHECK(after.atvr < before.atvr * 0.8f);
+    wn_mesh_destroy(&grid);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,23 @@
+/*
+===========================================================================
+
+whynot::tests::test.h: minimal checks for the ctest executables
+
+===========================================================================
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// unlike assert this stays on in release builds and says where it failed
+#define WN_TEST_CHECK(cond)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(cond))                                                                               \
+        {                                                                                          \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);               \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
@@ -0,0 +1,176 @@
+/*
+===========================================================================
+
+whynot::tests::tlsf_test.c: randomized alloc/free against the TLSF range allocator
+
+===========================================================================
+*/
+
+#include "test.h"
+
+#include "tlsf.h"
+
+#define STB_DS_IMPLEMENTATION
+#define STBDS_NO_SHORT_NAMES
+#include "stb_ds.h"
+
+#define TEST_SIZE ((uint64_t)256u << 20)
+#define TEST_GRANULARITY 256u
+#define TEST_OPS 100000u
+#define TEST_MAX_LIVE 4096u
+// full consistency walks are linear in the node count, not every op needs one
+#define TEST_CHECK_EVERY 97u
+
+typedef struct wn_test_range_t
+{
+    uint32_t node;
+    uint64_t offset;
+    uint64_t size;
+} wn_test_range_t;
+
+// xorshift64, fixed seed so failures reproduce
+static uint64_t wn_test_random(void)
+{
+    static uint64_t state = 0x9e3779b97f4a7c15ull;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// marks every node reachable from the free lists, which have to agree with the bitmaps
+static bool* wn_test_free_list_nodes(const wn_tlsf_t* tlsf)
+{
+    bool* listed = calloc(stbds_arrlen(tlsf->nodes), sizeof(bool));
+    WN_TEST_CHECK(listed);
+
+    for (uint32_t fl = 0; fl < WN_TLSF_FL_COUNT; fl++)
+    {
+        for (uint32_t sl = 0; sl < WN_TLSF_SL_COUNT; sl++)
+        {
+            bool has_bit = (tlsf->fl_bitmap >> fl & 1) && (tlsf->sl_bitmaps[fl] >> sl & 1);
+            WN_TEST_CHECK(has_bit == (tlsf->free_heads[fl][sl] != WN_TLSF_NO_NODE));
+
+            uint32_t prev = WN_TLSF_NO_NODE;
+            for (uint32_t i = tlsf->free_heads[fl][sl]; i != WN_TLSF_NO_NODE;
+                 i = tlsf->nodes[i].next_free)
+            {
+                WN_TEST_CHECK(!listed[i] && tlsf->nodes[i].prev_free == prev);
+                listed[i] = true;
+                prev = i;
+            }
+        }
+    }
+    return listed;
+}
+
+// walks the physical chain from offset 0, it has to tile the whole range with no free neighbours
+static void wn_test_check_tlsf(const wn_tlsf_t* tlsf, const wn_test_range_t* live, size_t n_live)
+{
+    bool* listed = wn_test_free_list_nodes(tlsf);
+
+    uint64_t offset = 0;
+    uint32_t n_used = 0;
+    uint32_t prev = WN_TLSF_NO_NODE;
+    for (uint32_t i = 0; i != WN_TLSF_NO_NODE; i = tlsf->nodes[i].next_phys)
+    {
+        const wn_tlsf_node_t* node = &tlsf->nodes[i];
+        WN_TEST_CHECK(node->offset == offset && node->size > 0);
+        WN_TEST_CHECK(node->prev_phys == prev);
+        WN_TEST_CHECK(node->free == listed[i]);
+        if (prev != WN_TLSF_NO_NODE)
+        {
+            WN_TEST_CHECK(!(node->free && tlsf->nodes[prev].free));
+        }
+        n_used += !node->free;
+        offset += node->size;
+        prev = i;
+    }
+    free(listed);
+    WN_TEST_CHECK(offset == tlsf->size);
+    WN_TEST_CHECK(n_used == tlsf->n_allocations && n_used == n_live);
+
+    for (size_t i = 0; i < n_live; i++)
+    {
+        const wn_tlsf_node_t* node = &tlsf->nodes[live[i].node];
+        WN_TEST_CHECK(!node->free);
+        WN_TEST_CHECK(node->offset == live[i].offset && node->size == live[i].size);
+    }
+}
+
+int main(void)
+{
+    wn_tlsf_t tlsf;
+    wn_tlsf_init(&tlsf, TEST_SIZE, TEST_GRANULARITY);
+
+    wn_test_range_t* live = NULL; // stbds array
+    uint32_t n_failed = 0;
+
+    for (uint32_t op = 0; op < TEST_OPS; op++)
+    {
+        bool alloc = stbds_arrlen(live) == 0
+                     || (stbds_arrlen(live) < TEST_MAX_LIVE && wn_test_random() % 100 < 55);
+        if (alloc)
+        {
+            // mostly small, the odd large one forces splits across first level bins
+            uint64_t granules = wn_test_random() % 32 == 0 ? 1 + wn_test_random() % 16384
+                                                           : 1 + wn_test_random() % 256;
+            uint64_t size = granules * TEST_GRANULARITY;
+            uint64_t alignment = (uint64_t)TEST_GRANULARITY << (wn_test_random() % 9);
+
+            wn_test_range_t range = { .size = size };
+            if (wn_tlsf_alloc(&tlsf, size, alignment, &range.node, &range.offset))
+            {
+                WN_TEST_CHECK(range.offset % alignment == 0);
+                WN_TEST_CHECK(range.offset + size <= TEST_SIZE);
+                stbds_arrput(live, range);
+            }
+            else
+            {
+                n_failed++;
+            }
+        }
+        else
+        {
+            size_t i = wn_test_random() % stbds_arrlen(live);
+            wn_tlsf_free(&tlsf, live[i].node);
+            stbds_arrdelswap(live, i);
+        }
+
+        if (op % TEST_CHECK_EVERY == 0)
+        {
+            wn_test_check_tlsf(&tlsf, live, stbds_arrlen(live));
+        }
+    }
+    wn_test_check_tlsf(&tlsf, live, stbds_arrlen(live));
+
+    // freeing everything in random order has to coalesce back into the initial free range
+    while (stbds_arrlen(live) > 0)
+    {
+        size_t i = wn_test_random() % stbds_arrlen(live);
+        wn_tlsf_free(&tlsf, live[i].node);
+        stbds_arrdelswap(live, i);
+    }
+    wn_test_check_tlsf(&tlsf, live, 0);
+    WN_TEST_CHECK(tlsf.nodes[0].free && tlsf.nodes[0].size == TEST_SIZE);
+    WN_TEST_CHECK(tlsf.nodes[0].next_phys == WN_TLSF_NO_NODE);
+    WN_TEST_CHECK(tlsf.n_allocations == 0);
+
+    // and hand out the whole range again
+    uint32_t node = WN_TLSF_NO_NODE;
+    uint64_t offset = 1;
+    WN_TEST_CHECK(wn_tlsf_alloc(&tlsf, TEST_SIZE, TEST_GRANULARITY, &node, &offset));
+    WN_TEST_CHECK(node == 0 && offset == 0);
+    wn_tlsf_free(&tlsf, node);
+
+    printf(
+        "%u ops, %u allocations didn't fit, %zu nodes\n",
+        TEST_OPS,
+        n_failed,
+        (size_t)stbds_arrlen(tlsf.nodes));
+
+    stbds_arrfree(live);
+    wn_tlsf_shutdown(&tlsf);
+
+    return EXIT_SUCCESS;
+}
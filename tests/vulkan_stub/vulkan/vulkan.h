@@ -0,0 +1,129 @@
+/*
+===========================================================================
+
+whynot::tests::vulkan_stub/vulkan/vulkan.h: just enough of vulkan.h for gpu_memory.c
+
+===========================================================================
+*/
+
+#pragma once
+
+/*
+ * Shadows the real header for tests that link renderer code against stubbed entry points, the
+ * test defines every function declared here. Layouts only have to agree with the test, not the
+ * driver.
+ */
+
+#include <stdint.h>
+
+#define VK_MAX_MEMORY_TYPES 32u
+#define VK_MAX_MEMORY_HEAPS 16u
+#define VK_WHOLE_SIZE (~0ull)
+
+typedef uint32_t VkFlags;
+typedef uint64_t VkDeviceSize;
+
+typedef struct VkDevice_T* VkDevice;
+typedef struct VkPhysicalDevice_T* VkPhysicalDevice;
+typedef struct VkDeviceMemory_T* VkDeviceMemory;
+typedef struct VkAllocationCallbacks VkAllocationCallbacks;
+
+typedef enum VkResult
+{
+    VK_SUCCESS = 0,
+    VK_ERROR_OUT_OF_DEVICE_MEMORY = -2,
+} VkResult;
+
+typedef enum VkStructureType
+{
+    VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO = 5,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2 = 1000059006,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT = 1000237000,
+} VkStructureType;
+
+typedef enum VkMemoryPropertyFlagBits
+{
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT = 0x1,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT = 0x2,
+    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT = 0x4,
+    VK_MEMORY_PROPERTY_HOST_CACHED_BIT = 0x8,
+    VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT = 0x10,
+    VK_MEMORY_PROPERTY_PROTECTED_BIT = 0x20,
+} VkMemoryPropertyFlagBits;
+typedef VkFlags VkMemoryPropertyFlags;
+typedef VkFlags VkMemoryHeapFlags;
+typedef VkFlags VkMemoryMapFlags;
+
+typedef struct VkMemoryType
+{
+    VkMemoryPropertyFlags propertyFlags;
+    uint32_t heapIndex;
+} VkMemoryType;
+
+typedef struct VkMemoryHeap
+{
+    VkDeviceSize size;
+    VkMemoryHeapFlags flags;
+} VkMemoryHeap;
+
+typedef struct VkPhysicalDeviceMemoryProperties
+{
+    uint32_t memoryTypeCount;
+    VkMemoryType memoryTypes[VK_MAX_MEMORY_TYPES];
+    uint32_t memoryHeapCount;
+    VkMemoryHeap memoryHeaps[VK_MAX_MEMORY_HEAPS];
+} VkPhysicalDeviceMemoryProperties;
+
+typedef struct VkPhysicalDeviceMemoryProperties2
+{
+    VkStructureType sType;
+    void* pNext;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+} VkPhysicalDeviceMemoryProperties2;
+
+typedef struct VkPhysicalDeviceMemoryBudgetPropertiesEXT
+{
+    VkStructureType sType;
+    void* pNext;
+    VkDeviceSize heapBudget[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS];
+} VkPhysicalDeviceMemoryBudgetPropertiesEXT;
+
+typedef struct VkMemoryRequirements
+{
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+    uint32_t memoryTypeBits;
+} VkMemoryRequirements;
+
+typedef struct VkMemoryAllocateInfo
+{
+    VkStructureType sType;
+    const void* pNext;
+    VkDeviceSize allocationSize;
+    uint32_t memoryTypeIndex;
+} VkMemoryAllocateInfo;
+
+void vkGetPhysicalDeviceMemoryProperties(
+    VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceMemoryProperties* pMemoryProperties);
+
+void vkGetPhysicalDeviceMemoryProperties2(
+    VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceMemoryProperties2* pMemoryProperties);
+
+VkResult vkAllocateMemory(
+    VkDevice device,
+    const VkMemoryAllocateInfo* pAllocateInfo,
+    const VkAllocationCallbacks* pAllocator,
+    VkDeviceMemory* pMemory);
+
+void vkFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator);
+
+VkResult vkMapMemory(
+    VkDevice device,
+    VkDeviceMemory memory,
+    VkDeviceSize offset,
+    VkDeviceSize size,
+    VkMemoryMapFlags flags,
+    void** ppData);